@@ -28,6 +28,8 @@
 #include "File.h"
 #include "QueueManager.h"
 #include "SimpleXML.h"
+#include "StringTokenizer.h"
+#include "concurrency.h"
 
 #define CONFIG_NAME "ADLSearch.xml"
 #define CONFIG_DIR Util::PATH_USER_CONFIG
@@ -125,10 +127,6 @@ int64_t ADLSearch::GetSizeBase() {
 	}
 }
 
-bool ADLSearch::searchAll(const string& s) {
-	return match.match(s);
-}
-
 bool ADLSearch::isRegEx() const {
 	return match.getMethod() == StringMatch::REGEX;
 }
@@ -149,46 +147,6 @@ void ADLSearch::setPattern(const string& aPattern) {
 	match.pattern = aPattern;
 }
 
-bool ADLSearch::matchesFile(const string& f, const string& fp, int64_t size) {
-	// Check status
-	if(!isActive) {
-		return false;
-	}
-
-	// Check size for files
-	if(size >= 0 && (sourceType == OnlyFile || sourceType == FullPath)) {
-		if(minFileSize >= 0 && size < minFileSize * GetSizeBase()) {
-			// Too small
-			return false;
-		}
-		if(maxFileSize >= 0 && size > maxFileSize * GetSizeBase()) {
-			// Too large
-			return false;
-		}
-	}
-
-	// Do search
-	switch(sourceType) {
-	default:
-	case OnlyDirectory:	return false;
-	case OnlyFile:		return searchAll(f);
-	case FullPath:		return searchAll(fp);
-	}
-}
-
-bool ADLSearch::matchesDirectory(const string& d) {
-	// Check status
-	if(!isActive) {
-		return false;
-	}
-	if(sourceType != OnlyDirectory) {
-		return false;
-	}
-
-	// Do search
-	return searchAll(d);
-}
-
 // Constructor/destructor
 ADLSearchManager::ADLSearchManager() : running(0), user(HintedUser()), dirty(false) {
 	load();
@@ -426,7 +384,7 @@ void ADLSearchManager::save(bool force /*false*/) {
 	SettingsManager::saveSettingFile(xml, CONFIG_DIR, CONFIG_NAME);
 }
 
-void ADLSearchManager::MatchesFile(DestDirList& destDirVector, const DirectoryListing::File *currentFile, string& fullPath) {
+void ADLSearchManager::MatchesFile(DestDirList& destDirVector, const DirectoryListing::File *currentFile, const MatchList* aMatches) {
 	// Add to any substructure being stored
 	for(auto& id: destDirVector) {
 		if(id.subdir != NULL) {
@@ -438,38 +396,36 @@ void ADLSearchManager::MatchesFile(DestDirList& destDirVector, const DirectoryLi
 		id.fileAdded = false;	// Prepare for next stage
 	}
 
-	// Prepare to match searches
-	if(currentFile->getName().size() < 1) {
+	if(!aMatches) {
 		return;
 	}
 
-	string filePath = fullPath + "\\" + currentFile->getName();
-	// Match searches
-	for(auto& is: collection) {
+	// Add the matches
+	for(auto i: *aMatches) {
+		auto& is = collection[i];
 		if(destDirVector[is.ddIndex].fileAdded) {
 			continue;
 		}
-		if(is.matchesFile(currentFile->getName(), filePath, currentFile->getSize())) {
-			DirectoryListing::File *copyFile = new DirectoryListing::File(*currentFile, true);
-			destDirVector[is.ddIndex].dir->files.push_back(copyFile);
-			destDirVector[is.ddIndex].fileAdded = true;
-
-			if(is.isAutoQueue){
-				try {
-					QueueManager::getInstance()->createFileBundle(SETTING(DOWNLOAD_DIRECTORY) + currentFile->getName(),
-						currentFile->getSize(), currentFile->getTTH(), getUser(), currentFile->getRemoteDate());
-				} catch(const Exception&) { }
-			}
 
-			if(breakOnFirst) {
-				// Found a match, search no more
-				break;
-			}
+		DirectoryListing::File *copyFile = new DirectoryListing::File(*currentFile, true);
+		destDirVector[is.ddIndex].dir->files.push_back(copyFile);
+		destDirVector[is.ddIndex].fileAdded = true;
+
+		if(is.isAutoQueue){
+			try {
+				QueueManager::getInstance()->createFileBundle(SETTING(DOWNLOAD_DIRECTORY) + currentFile->getName(),
+					currentFile->getSize(), currentFile->getTTH(), getUser(), currentFile->getRemoteDate());
+			} catch(const Exception&) { }
+		}
+
+		if(breakOnFirst) {
+			// Found a match, search no more
+			break;
 		}
 	}
 }
 
-void ADLSearchManager::MatchesDirectory(DestDirList& destDirVector, const DirectoryListing::Directory::Ptr& currentDir, string& fullPath) {
+void ADLSearchManager::MatchesDirectory(DestDirList& destDirVector, const DirectoryListing::Directory::Ptr& currentDir, string& fullPath, const MatchList* aMatches) {
 	// Add to any substructure being stored
 	for(auto& id: destDirVector) {
 		if(id.subdir) {
@@ -480,23 +436,23 @@ void ADLSearchManager::MatchesDirectory(DestDirList& destDirVector, const Direct
 		}
 	}
 
-	// Prepare to match searches
-	if(currentDir->getName().size() < 1) {
+	if(!aMatches) {
 		return;
 	}
 
-	for(auto& is: collection) {
+	// Add the matches
+	for(auto i: *aMatches) {
+		auto& is = collection[i];
 		if(destDirVector[is.ddIndex].subdir) {
 			continue;
 		}
-		if(is.matchesDirectory(currentDir->getName())) {
-			destDirVector[is.ddIndex].subdir =
-				new DirectoryListing::AdlDirectory(fullPath.substr(1) + "\\", destDirVector[is.ddIndex].dir, currentDir->getName());
-			destDirVector[is.ddIndex].dir->directories.push_back(destDirVector[is.ddIndex].subdir);
-			if(breakOnFirst) {
-				// Found a match, search no more
-				break;
-			}
+
+		destDirVector[is.ddIndex].subdir =
+			new DirectoryListing::AdlDirectory(fullPath.substr(1) + "\\", destDirVector[is.ddIndex].dir, currentDir->getName());
+		destDirVector[is.ddIndex].dir->directories.push_back(destDirVector[is.ddIndex].subdir);
+		if(breakOnFirst) {
+			// Found a match, search no more
+			break;
 		}
 	}
 }
@@ -586,25 +542,298 @@ void ADLSearchManager::matchListing(DirectoryListing& aDirList) noexcept {
 	setBreakOnFirst(SETTING(ADLS_BREAK_ON_FIRST));
 
 	string path(aDirList.getRoot()->getName());
-	matchRecurse(destDirs, aDirList.getRoot(), path, aDirList);
+
+	// match the items first, the destination directories must be built in the listing order
+	ListingMatches matches;
+	{
+		SearchMatcher matcher(collection);
+		findMatches(matcher, root, path, matches, aDirList);
+	}
+
+	matchRecurse(destDirs, aDirList.getRoot(), path, aDirList, matches);
 
 	running--;
 	FinalizeDestinationDirectories(destDirs, root);
 }
 
-void ADLSearchManager::matchRecurse(DestDirList &aDestList, const DirectoryListing::Directory::Ptr& aDir, string &aPath, DirectoryListing& aDirList) {
+void ADLSearchManager::matchRecurse(DestDirList &aDestList, const DirectoryListing::Directory::Ptr& aDir, string &aPath, DirectoryListing& aDirList, const ListingMatches& aMatches) {
 	if(aDirList.getClosing())
 		throw AbortException();
 
 	for(auto dirIt = aDir->directories.begin(); dirIt != aDir->directories.end(); ++dirIt) {
 		string tmpPath = aPath + "\\" + (*dirIt)->getName();
-		MatchesDirectory(aDestList, *dirIt, tmpPath);
-		matchRecurse(aDestList, *dirIt, tmpPath, aDirList);
+		auto m = aMatches.directories.find(dirIt->get());
+		MatchesDirectory(aDestList, *dirIt, tmpPath, m != aMatches.directories.end() ? &m->second : nullptr);
+		matchRecurse(aDestList, *dirIt, tmpPath, aDirList, aMatches);
 	}
 	for(auto fileIt = aDir->files.begin(); fileIt != aDir->files.end(); ++fileIt) {
-		MatchesFile(aDestList, *fileIt, aPath);
+		auto m = aMatches.files.find(*fileIt);
+		MatchesFile(aDestList, *fileIt, m != aMatches.files.end() ? &m->second : nullptr);
 	}
 	stepUpDirectory(aDestList);
 }
 
+void ADLSearchManager::findMatches(const SearchMatcher& aMatcher, const DirectoryListing::Directory::Ptr& aRoot, const string& aPath, ListingMatches& matches_, const DirectoryListing& aDirList) {
+	struct MatchTask {
+		MatchTask(const DirectoryListing::Directory::Ptr& aDir, const string& aPath, bool aRecursive) : dir(aDir), path(aPath), recursive(aRecursive) { }
+
+		DirectoryListing::Directory::Ptr dir;
+		string path;
+		bool recursive;
+		ListingMatches matches;
+	};
+
+	// split the listing into subtrees, the upper levels are matched without recursion
+	vector<MatchTask> tasks;
+	vector<pair<DirectoryListing::Directory::Ptr, string>> level;
+	level.emplace_back(aRoot, aPath);
+	while (!level.empty() && tasks.size() + level.size() < MIN_MATCH_TASKS) {
+		vector<pair<DirectoryListing::Directory::Ptr, string>> nextLevel;
+		for (const auto& d: level) {
+			tasks.emplace_back(d.first, d.second, false);
+			for (const auto& sub: d.first->directories)
+				nextLevel.emplace_back(sub, d.second + "\\" + sub->getName());
+		}
+
+		level.swap(nextLevel);
+	}
+
+	for (const auto& d: level)
+		tasks.emplace_back(d.first, d.second, true);
+
+	parallel_for_each(tasks.begin(), tasks.end(), [&](MatchTask& t) {
+		findDirectoryMatches(aMatcher, t.dir, t.path, t.recursive, t.matches, aDirList);
+	});
+
+	for (auto& t: tasks) {
+		matches_.files.insert(make_move_iterator(t.matches.files.begin()), make_move_iterator(t.matches.files.end()));
+		matches_.directories.insert(make_move_iterator(t.matches.directories.begin()), make_move_iterator(t.matches.directories.end()));
+	}
+}
+
+void ADLSearchManager::findDirectoryMatches(const SearchMatcher& aMatcher, const DirectoryListing::Directory::Ptr& aDir, const string& aPath, bool aRecursive, ListingMatches& matches_, const DirectoryListing& aDirList) {
+	if(aDirList.getClosing())
+		throw AbortException();
+
+	MatchList results;
+	for(const auto& d: aDir->directories) {
+		if(!d->getName().empty()) {
+			aMatcher.matchDirectory(d->getName(), results);
+			if(!results.empty()) {
+				matches_.directories.emplace(d.get(), move(results));
+				results.clear();
+			}
+		}
+
+		if(aRecursive)
+			findDirectoryMatches(aMatcher, d, aPath + "\\" + d->getName(), true, matches_, aDirList);
+	}
+
+	for(const auto f: aDir->files) {
+		if(f->getName().empty())
+			continue;
+
+		aMatcher.matchFile(f->getName(), aPath, f->getSize(), results);
+		if(!results.empty()) {
+			matches_.files.emplace(f, move(results));
+			results.clear();
+		}
+	}
+}
+
+/**
+* Searches of a single source type
+*
+* The patterns of all partial searches are matched with shared multi-pattern automatons so each
+* string is only scanned once per 64 patterns. Regular expressions are checked against a merged
+* expression first, they only need to be matched one by one if it matches.
+*/
+class ADLSearchManager::SearchMatcher::RuleSet {
+public:
+	RuleSet() { }
+
+	void add(ADLSearch& aSearch, size_t aIndex, bool aCheckSize) {
+		Rule r;
+		r.index = aIndex;
+		if (aCheckSize) {
+			r.minSize = aSearch.minFileSize >= 0 ? aSearch.minFileSize * aSearch.GetSizeBase() : -1;
+			r.maxSize = aSearch.maxFileSize >= 0 ? aSearch.maxFileSize * aSearch.GetSizeBase() : -1;
+		}
+
+		if (aSearch.isRegEx()) {
+			r.regex = &aSearch.match;
+			regexPatterns.push_back(aSearch.getPattern());
+		} else {
+			// all patterns (separated with spaces) must be found
+			map<size_t, uint64_t> masks;
+			StringTokenizer<string> st(aSearch.getPattern(), ' ');
+			for (const auto& t: st.getTokens()) {
+				if (t.empty())
+					continue;
+
+				auto bit = getPatternBit(Text::toLower(t));
+				masks[bit.first] |= bit.second;
+			}
+
+			r.required.assign(masks.begin(), masks.end());
+		}
+
+		rules.push_back(move(r));
+	}
+
+	void prepare() {
+		for (const auto& l: chunkPatterns) {
+			chunks.emplace_back();
+			chunks.back().addStrings(l);
+		}
+
+		chunkPatterns.clear();
+		patternBits.clear();
+
+		if (regexPatterns.size() > 1 && none_of(regexPatterns.begin(), regexPatterns.end(), hasBackReferences)) {
+			string merged;
+			for (const auto& p: regexPatterns) {
+				if (!merged.empty())
+					merged += '|';
+				merged += "(?:" + p + ")";
+			}
+
+			try {
+				mergedRegex.assign(merged);
+			} catch(const std::runtime_error&) {
+				// some of the patterns are invalid, match them one by one
+			}
+		}
+	}
+
+	bool empty() const { return rules.empty(); }
+
+	void match(const string& aText, int64_t aSize, MatchList& ret) const {
+		string lower;
+		vector<uint64_t> found;
+		int regexMatch = -1;
+
+		for (const auto& r: rules) {
+			if (aSize >= 0 && ((r.minSize >= 0 && aSize < r.minSize) || (r.maxSize >= 0 && aSize > r.maxSize)))
+				continue;
+
+			if (r.regex) {
+				if (regexMatch == -1)
+					regexMatch = matchMerged(aText) ? 1 : 0;
+
+				if (regexMatch == 0 || !r.regex->match(aText))
+					continue;
+			} else {
+				if (found.empty() && !chunks.empty()) {
+					lower = Text::toLower(aText);
+					for (const auto& c: chunks)
+						found.push_back(c.matchMaskLower(lower));
+				}
+
+				if (!all_of(r.required.begin(), r.required.end(), [&](const pair<size_t, uint64_t>& m) { return (found[m.first] & m.second) == m.second; }))
+					continue;
+			}
+
+			ret.push_back(r.index);
+		}
+	}
+private:
+	struct Rule {
+		size_t index = 0;
+		int64_t minSize = -1;
+		int64_t maxSize = -1;
+
+		// set for regular expressions
+		const StringMatch* regex = nullptr;
+
+		// masks of the required partial patterns in each chunk
+		vector<pair<size_t, uint64_t>> required;
+	};
+
+	pair<size_t, uint64_t> getPatternBit(const string& aPattern) {
+		auto p = patternBits.find(aPattern);
+		if (p != patternBits.end())
+			return p->second;
+
+		if (chunkPatterns.empty() || chunkPatterns.back().size() == StringSearch::MAX_MASK_PATTERNS)
+			chunkPatterns.emplace_back();
+
+		chunkPatterns.back().push_back(aPattern);
+		auto bit = make_pair(chunkPatterns.size() - 1, static_cast<uint64_t>(1) << (chunkPatterns.back().size() - 1));
+		patternBits.emplace(aPattern, bit);
+		return bit;
+	}
+
+	// the group numbers would change when the expressions are merged
+	static bool hasBackReferences(const string& aPattern) {
+		for (size_t i = 0; i + 1 < aPattern.size(); ++i) {
+			if (aPattern[i] == '\\') {
+				auto c = aPattern[++i];
+				if ((c >= '1' && c <= '9') || c == 'g' || c == 'k')
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool matchMerged(const string& aText) const {
+		if (mergedRegex.empty())
+			return true;
+
+		try {
+			return boost::regex_search(aText, mergedRegex);
+		} catch(const std::runtime_error&) {
+			// most likely a stack overflow, check the expressions separately
+			return true;
+		}
+	}
+
+	vector<Rule> rules;
+
+	vector<StringSearch> chunks;
+	vector<StringList> chunkPatterns;
+	unordered_map<string, pair<size_t, uint64_t>> patternBits;
+
+	StringList regexPatterns;
+	boost::regex mergedRegex;
+};
+
+ADLSearchManager::SearchMatcher::SearchMatcher(SearchCollection& aCollection) : names(new RuleSet), paths(new RuleSet), directories(new RuleSet) {
+	for (size_t i = 0; i < aCollection.size(); ++i) {
+		auto& is = aCollection[i];
+		if (!is.isActive)
+			continue;
+
+		switch(is.sourceType) {
+			case ADLSearch::OnlyFile: names->add(is, i, true); break;
+			case ADLSearch::FullPath: paths->add(is, i, true); break;
+			case ADLSearch::OnlyDirectory: directories->add(is, i, false); break;
+			default: break;
+		}
+	}
+
+	names->prepare();
+	paths->prepare();
+	directories->prepare();
+}
+
+ADLSearchManager::SearchMatcher::~SearchMatcher() { }
+
+void ADLSearchManager::SearchMatcher::matchFile(const string& aName, const string& aDirPath, int64_t aSize, MatchList& ret) const {
+	names->match(aName, aSize, ret);
+	if (paths->empty())
+		return;
+
+	auto pathStart = ret.size();
+	paths->match(aDirPath + "\\" + aName, aSize, ret);
+
+	// keep the collection order
+	inplace_merge(ret.begin(), ret.begin() + pathStart, ret.end());
+}
+
+void ADLSearchManager::SearchMatcher::matchDirectory(const string& aName, MatchList& ret) const {
+	directories->match(aName, -1, ret);
+}
+
 } // namespace dcpp
\ No newline at end of file
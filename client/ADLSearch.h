@@ -98,13 +98,6 @@ private:
 
 	/// Prepare search
 	void prepare();
-
-	/// Search for file match
-	bool matchesFile(const string& f, const string& fp, int64_t size);
-	/// Search for directory match
-	bool matchesDirectory(const string& d);
-
-	bool searchAll(const string& s);
 };
 
 
@@ -148,12 +141,43 @@ private:
 	ADLSearch::SourceType StringToSourceType(const string& s);
 	bool dirty;
 
+	// Indexes of the matching searches in collection order
+	typedef vector<size_t> MatchList;
+
+	/// Active searches compiled for matching each item of a listing with a single pass
+	class SearchMatcher {
+	public:
+		explicit SearchMatcher(SearchCollection& aCollection);
+		~SearchMatcher();
+
+		void matchFile(const string& aName, const string& aDirPath, int64_t aSize, MatchList& ret) const;
+		void matchDirectory(const string& aName, MatchList& ret) const;
+	private:
+		class RuleSet;
+		unique_ptr<RuleSet> names;
+		unique_ptr<RuleSet> paths;
+		unique_ptr<RuleSet> directories;
+	};
+
+	/// Matching searches for the listing items (only items with matches are included)
+	struct ListingMatches {
+		unordered_map<const DirectoryListing::File*, MatchList> files;
+		unordered_map<const DirectoryListing::Directory*, MatchList> directories;
+	};
+
+	// Minimum number of subtrees to split the listing into when matching it
+	enum { MIN_MATCH_TASKS = 64 };
+
+	// Match all items of the listing (subtrees are matched concurrently)
+	void findMatches(const SearchMatcher& aMatcher, const DirectoryListing::Directory::Ptr& aRoot, const string& aPath, ListingMatches& matches_, const DirectoryListing& aDirList);
+	static void findDirectoryMatches(const SearchMatcher& aMatcher, const DirectoryListing::Directory::Ptr& aDir, const string& aPath, bool aRecursive, ListingMatches& matches_, const DirectoryListing& aDirList);
+
 	// @internal
-	void matchRecurse(DestDirList& /*aDestList*/, const DirectoryListing::Directory::Ptr& /*aDir*/, string& /*aPath*/, DirectoryListing& /*aDirList*/);
+	void matchRecurse(DestDirList& /*aDestList*/, const DirectoryListing::Directory::Ptr& /*aDir*/, string& /*aPath*/, DirectoryListing& /*aDirList*/, const ListingMatches& /*aMatches*/);
 	// Search for file match
-	void MatchesFile(DestDirList& destDirVector, const DirectoryListing::File *currentFile, string& fullPath);
+	void MatchesFile(DestDirList& destDirVector, const DirectoryListing::File *currentFile, const MatchList* aMatches);
 	// Search for directory match
-	void MatchesDirectory(DestDirList& destDirVector, const DirectoryListing::Directory::Ptr& currentDir, string& fullPath);
+	void MatchesDirectory(DestDirList& destDirVector, const DirectoryListing::Directory::Ptr& currentDir, string& fullPath, const MatchList* aMatches);
 	// Step up directory
 	void stepUpDirectory(DestDirList& destDirVector);
 
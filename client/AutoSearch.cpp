@@ -34,6 +34,8 @@ using boost::max_element;
 using namespace boost::posix_time;
 using namespace boost::gregorian;
 
+atomic<uint32_t> AutoSearch::patternRevision { 0 };
+
 AutoSearch::AutoSearch() noexcept : token(Util::randInt(10)) {
 
 }
@@ -163,6 +165,7 @@ void AutoSearch::updatePattern() noexcept {
 		pattern = matcherString;
 	}
 	prepare();
+	patternRevision++;
 }
 
 string AutoSearch::getDisplayType() const noexcept {
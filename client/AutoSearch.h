@@ -128,6 +128,9 @@ public:
 	SearchTime endTime = SearchTime(true);
 	bitset<7> searchDays = bitset<7>("1111111");
 
+	/* Increased whenever the matcher of any item is updated */
+	static atomic<uint32_t> patternRevision;
+
 	bool matchNick(const string& aStr) { return userMatcher.match(aStr); }
 	const string& getNickPattern() const noexcept { return userMatcher.pattern; }
 	string getDisplayName() noexcept;
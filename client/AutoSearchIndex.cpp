@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "stdinc.h"
+#include "AutoSearchIndex.h"
+
+#include "AutoSearch.h"
+#include "SearchManager.h"
+#include "SearchResult.h"
+#include "StringTokenizer.h"
+#include "Text.h"
+
+namespace dcpp {
+
+void AutoSearchIndex::getCandidates(const AutoSearchList& aItems, const SearchResult& aResult, PositionList& ret) noexcept {
+	Lock l(cs);
+	if (!valid || revision != AutoSearch::patternRevision) {
+		rebuild(aItems);
+	}
+
+	ret = unindexed;
+
+	auto tth = tthItems.find(Text::toLower(aResult.getTTH().toBase32()));
+	if (tth != tthItems.end()) {
+		ret.insert(ret.end(), tth->second.begin(), tth->second.end());
+	}
+
+	if (!postings.empty()) {
+		forEachGram(Text::toLower(aResult.getPath()), [&](uint32_t aGram) {
+			auto p = postings.find(aGram);
+			if (p != postings.end()) {
+				ret.insert(ret.end(), p->second.begin(), p->second.end());
+			}
+		});
+	}
+
+	// keep the original order of the items
+	sort(ret.begin(), ret.end());
+	ret.erase(unique(ret.begin(), ret.end()), ret.end());
+}
+
+void AutoSearchIndex::rebuild(const AutoSearchList& aItems) noexcept {
+	// read the revision first so that changes made during the rebuild will cause a new one
+	revision = AutoSearch::patternRevision;
+	valid = true;
+
+	postings.clear();
+	tthItems.clear();
+	unindexed.clear();
+	indexedCount = 0;
+
+	for (size_t i = 0; i < aItems.size(); ++i) {
+		const auto& as = aItems[i];
+		auto method = as->getMethod();
+		if (as->getFileType() == SEARCH_TYPE_TTH) {
+			// a partial pattern can only be looked up when it's a complete TTH
+			if (method == StringMatch::EXACT || (method == StringMatch::PARTIAL && as->pattern.length() == 39 && as->pattern.find(' ') == string::npos)) {
+				tthItems[Text::toLower(as->pattern)].push_back(i);
+				indexedCount++;
+				continue;
+			}
+		} else if (method == StringMatch::PARTIAL) {
+			addPartial(as->pattern, i);
+			continue;
+		}
+
+		unindexed.push_back(i);
+	}
+}
+
+void AutoSearchIndex::addPartial(const string& aPattern, size_t aPos) noexcept {
+	// the longest pattern is most likely to have rare trigrams
+	string longest;
+	StringTokenizer<string> st(aPattern, ' ');
+	for (const auto& t: st.getTokens()) {
+		if (t.length() > longest.length())
+			longest = t;
+	}
+
+	longest = Text::toLower(longest);
+	if (longest.length() < GRAM_LENGTH) {
+		unindexed.push_back(aPos);
+		return;
+	}
+
+	uint32_t best = 0;
+	size_t bestCount = numeric_limits<size_t>::max();
+	forEachGram(longest, [&](uint32_t aGram) {
+		auto p = postings.find(aGram);
+		auto count = p == postings.end() ? 0 : p->second.size();
+		if (count < bestCount) {
+			best = aGram;
+			bestCount = count;
+		}
+	});
+
+	postings[best].push_back(aPos);
+	indexedCount++;
+}
+
+} // namespace dcpp
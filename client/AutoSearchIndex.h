@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef DCPLUSPLUS_DCPP_AUTO_SEARCH_INDEX_H
+#define DCPLUSPLUS_DCPP_AUTO_SEARCH_INDEX_H
+
+#include "typedefs.h"
+#include "forward.h"
+
+#include "atomic.h"
+#include "CriticalSection.h"
+
+namespace dcpp {
+
+/**
+* Index for finding the auto search items that may match an incoming search result.
+*
+* Each item with partial matching is added in the posting list of a single trigram from its
+* longest pattern (the one with the shortest list at the time). All patterns must be found from
+* the matched string so a result can only match items that are listed under one of the trigrams
+* of its path. Items that are matched with a complete TTH are kept in a hash map and the remaining
+* items (regular expressions, wildcards, very short patterns and partial TTHs) are always returned.
+*
+* The index is rebuilt lazily when the list has been changed or the pattern of any item has been
+* updated. The caller must prevent the list from being modified while the index is being used.
+*/
+class AutoSearchIndex {
+public:
+	typedef vector<size_t> PositionList;
+
+	AutoSearchIndex() { }
+
+	/* Marks the index for rebuilding after the item list has been modified */
+	void invalidate() noexcept { valid = false; }
+
+	/* Returns the positions of the items that may match the result in ascending order */
+	void getCandidates(const AutoSearchList& aItems, const SearchResult& aResult, PositionList& ret) noexcept;
+
+	size_t getIndexedCount() const noexcept { return indexedCount; }
+	size_t getUnindexedCount() const noexcept { return unindexed.size(); }
+private:
+	enum { GRAM_LENGTH = 3 };
+
+	void rebuild(const AutoSearchList& aItems) noexcept;
+	void addPartial(const string& aPattern, size_t aPos) noexcept;
+
+	template<class F>
+	static void forEachGram(const string& s, F aF) noexcept {
+		uint32_t gram = 0;
+		for (size_t i = 0; i < s.length(); ++i) {
+			gram = ((gram << 8) | static_cast<uint8_t>(s[i])) & 0xFFFFFF;
+			if (i + 1 >= GRAM_LENGTH) {
+				aF(gram);
+			}
+		}
+	}
+
+	CriticalSection cs;
+
+	unordered_map<uint32_t, PositionList> postings;
+	unordered_map<string, PositionList> tthItems;
+	PositionList unindexed;
+	size_t indexedCount = 0;
+
+	atomic<bool> valid { false };
+	uint32_t revision = 0;
+};
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_DCPP_AUTO_SEARCH_INDEX_H)
@@ -90,6 +90,7 @@ void AutoSearchManager::addAutoSearch(AutoSearchPtr aAutoSearch, bool search) no
 	{
 		WLock l(cs);
 		searchItems.push_back(aAutoSearch);
+		searchIndex.invalidate();
 	}
 
 	dirty = true;
@@ -159,6 +160,7 @@ void AutoSearchManager::removeAutoSearch(AutoSearchPtr& aItem) noexcept {
 
 		fire(AutoSearchManagerListener::RemoveItem(), aItem);
 		searchItems.erase(i);
+		searchIndex.invalidate();
 		dirty = true;
 	}
 }
@@ -604,14 +606,15 @@ void AutoSearchManager::on(SearchManagerListener::SR, const SearchResultPtr& sr)
 
 	{
 		RLock l (cs);
-		for(auto& as: searchItems) {
+
+		// only check the items that may match
+		AutoSearchIndex::PositionList candidates;
+		searchIndex.getCandidates(searchItems, *sr, candidates);
+
+		for(auto pos: candidates) {
+			auto& as = searchItems[pos];
 			if (!as->allowNewItems() && !as->getManualSearch())
 				continue;
-			
-			if (as->getManualSearch()) {
-				as->setManualSearch(false);
-				as->updateStatus();
-			}
 
 			//match
 			if (as->getFileType() == SEARCH_TYPE_TTH) {
@@ -649,6 +652,14 @@ void AutoSearchManager::on(SearchManagerListener::SR, const SearchResultPtr& sr)
 			//we have a valid result
 			matches.push_back(as);
 		}
+
+		// manual searches are finished when any results are received, including the ones that don't match
+		for(const auto& as: searchItems) {
+			if (as->getManualSearch()) {
+				as->setManualSearch(false);
+				as->updateStatus();
+			}
+		}
 	}
 
 	//extra checks outside the lock
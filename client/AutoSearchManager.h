@@ -22,6 +22,7 @@
 #include "forward.h"
 
 #include "AutoSearch.h"
+#include "AutoSearchIndex.h"
 #include "AutoSearchManagerListener.h"
 #include "SearchManagerListener.h"
 #include "QueueManagerListener.h"
@@ -79,6 +80,7 @@ public:
 		//hack =]
 		if(searchItems.size() > id) {
 			swap(searchItems[id], searchItems[id-1]);
+			searchIndex.invalidate();
 			dirty = true;
 		}
 	}
@@ -88,6 +90,7 @@ public:
 		//hack =]
 		if(searchItems.size() > id) {
 			swap(searchItems[id], searchItems[id+1]);
+			searchIndex.invalidate();
 			dirty = true;
 		}
 	}
@@ -112,6 +115,7 @@ private:
 	//count minutes to be more accurate than comparing ticks every minute.
 	bool checkItems() noexcept;
 	AutoSearchList searchItems;
+	AutoSearchIndex searchIndex;
 
 	void loadAutoSearch(SimpleXML& aXml);
 
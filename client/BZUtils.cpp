@@ -21,6 +21,7 @@
 
 #include "Exception.h"
 #include "ResourceManager.h"
+#include "Streams.h"
 
 namespace dcpp {
 	
@@ -101,4 +102,121 @@ bool UnBZFilter::operator()(const void* in, size_t& insize, void* out, size_t& o
 	return err == BZ_OK;
 }
 
+#define BZ_HEADER_BITS 32
+#define BZ_MAGIC_BITS 48
+#define BZ_BLOCK_MAGIC 0x314159265359ULL
+#define BZ_EOS_MAGIC 0x177245385090ULL
+
+static inline uint64_t readBits(const string& aData, uint64_t aPos, int aCount) {
+	uint64_t ret = 0;
+	for (int i = 0; i < aCount; ++i, ++aPos) {
+		ret = (ret << 1) | ((static_cast<uint8_t>(aData[aPos / 8]) >> (7 - (aPos % 8))) & 1);
+	}
+	return ret;
+}
+
+static inline uint32_t combineCRC(uint32_t aCRC, uint32_t aBlockCRC) {
+	return ((aCRC << 1) | (aCRC >> 31)) ^ aBlockCRC;
+}
+
+bool BZStreamJoiner::getStreamInfo(const string& aStream, StreamInfo& info_) noexcept {
+	if (aStream.size() < 14 || aStream.compare(0, 3, "BZh") != 0 || aStream[3] < '1' || aStream[3] > '9')
+		return false;
+
+	// the end of stream marker is followed by the stream CRC and padding to a full byte
+	const uint64_t totalBits = static_cast<uint64_t>(aStream.size()) * 8;
+	uint64_t eosPos = 0;
+	for (int pad = 0; pad < 8; ++pad) {
+		auto pos = totalBits - pad - BZ_MAGIC_BITS - 32;
+		if (pos >= BZ_HEADER_BITS && readBits(aStream, pos, BZ_MAGIC_BITS) == BZ_EOS_MAGIC && readBits(aStream, totalBits - pad, pad) == 0) {
+			eosPos = pos;
+			break;
+		}
+	}
+
+	if (eosPos == 0)
+		return false;
+
+	// count the blocks and check that their CRCs add up (the magic could also appear inside the compressed data)
+	const uint64_t mask = (1ULL << BZ_MAGIC_BITS) - 1;
+	uint64_t window = 0;
+	uint32_t blocks = 0, crc = 0;
+	for (uint64_t pos = BZ_HEADER_BITS; pos + 32 <= eosPos; ++pos) {
+		window = ((window << 1) | ((static_cast<uint8_t>(aStream[pos / 8]) >> (7 - (pos % 8))) & 1)) & mask;
+		if (window == BZ_BLOCK_MAGIC && pos + 1 >= BZ_HEADER_BITS + BZ_MAGIC_BITS) {
+			if (blocks == 0 && pos + 1 != BZ_HEADER_BITS + BZ_MAGIC_BITS)
+				return false;
+
+			crc = combineCRC(crc, static_cast<uint32_t>(readBits(aStream, pos + 1, 32)));
+			blocks++;
+		}
+	}
+
+	if (crc != static_cast<uint32_t>(readBits(aStream, eosPos + BZ_MAGIC_BITS, 32)))
+		return false;
+
+	info_.dataBits = eosPos - BZ_HEADER_BITS;
+	info_.crc = crc;
+	info_.blocks = blocks;
+	info_.blockSize = aStream[3];
+	return true;
+}
+
+BZStreamJoiner::BZStreamJoiner(OutputStream* aStream, char aBlockSize) : os(aStream), blockSize(aBlockSize) {
+	buf.reserve(64 * 1024);
+	buf += "BZh";
+	buf += aBlockSize;
+}
+
+void BZStreamJoiner::append(const string& aStream, const StreamInfo& aInfo) {
+	if (aInfo.blockSize != blockSize)
+		throw Exception(STRING(COMPRESSION_ERROR));
+
+	// the blocks start from a byte boundary
+	const auto bytes = aInfo.dataBits / 8;
+	const auto data = reinterpret_cast<const uint8_t*>(aStream.data()) + BZ_HEADER_BITS / 8;
+	for (uint64_t i = 0; i < bytes; ++i) {
+		writeBits(data[i], 8);
+	}
+
+	const int rest = aInfo.dataBits % 8;
+	if (rest > 0)
+		writeBits(data[bytes] >> (8 - rest), rest);
+
+	for (uint32_t i = 0; i < aInfo.blocks % 32; ++i) {
+		crc = combineCRC(crc, 0);
+	}
+	crc ^= aInfo.crc;
+}
+
+void BZStreamJoiner::finish() {
+	writeBits(BZ_EOS_MAGIC, BZ_MAGIC_BITS);
+	writeBits(crc, 32);
+	if (bitCount > 0)
+		writeBits(0, 8 - bitCount);
+
+	flushBuffer();
+	os->flush();
+}
+
+void BZStreamJoiner::writeBits(uint64_t aBits, int aCount) {
+	dcassert(aCount <= 48);
+	bits = (bits << aCount) | (aBits & ((1ULL << aCount) - 1));
+	bitCount += aCount;
+	while (bitCount >= 8) {
+		bitCount -= 8;
+		buf += static_cast<char>((bits >> bitCount) & 0xFF);
+	}
+
+	if (buf.size() >= 64 * 1024)
+		flushBuffer();
+}
+
+void BZStreamJoiner::flushBuffer() {
+	if (!buf.empty()) {
+		os->write(buf);
+		buf.clear();
+	}
+}
+
 } // namespace dcpp
\ No newline at end of file
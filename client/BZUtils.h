@@ -21,6 +21,8 @@
 
 #include <bzlib.h>
 
+#include "forward.h"
+
 namespace dcpp {
 
 class BZFilter {
@@ -57,6 +59,45 @@ private:
 	bz_stream zs;
 };
 
+/**
+* Joins separately compressed bzip2 streams into a single stream. The compressed blocks are
+* copied as they are (bit-aligned) so only the stream header and trailer need to be written.
+*/
+class BZStreamJoiner {
+public:
+	struct StreamInfo {
+		// Bits from the start of the first block to the end of the last block
+		uint64_t dataBits = 0;
+		uint32_t crc = 0;
+		uint32_t blocks = 0;
+		char blockSize = 0;
+	};
+
+	/**
+	* Parses the information needed for joining a complete stream.
+	* @return False if the stream couldn't be parsed
+	*/
+	static bool getStreamInfo(const string& aStream, StreamInfo& info_) noexcept;
+
+	BZStreamJoiner(OutputStream* aStream, char aBlockSize = '9');
+
+	/** Append the blocks of a stream that was compressed with the same block size */
+	void append(const string& aStream, const StreamInfo& aInfo);
+
+	/** Write the end of stream marker */
+	void finish();
+private:
+	void writeBits(uint64_t aBits, int aCount);
+	void flushBuffer();
+
+	OutputStream* os;
+	string buf;
+	uint64_t bits = 0;
+	int bitCount = 0;
+	uint32_t crc = 0;
+	const char blockSize;
+};
+
 } // namespace dcpp
 
 #endif // !defined(DCPLUSPLUS_DCPP_BZUTILS_H)
\ No newline at end of file
@@ -21,71 +21,113 @@
 
 #include "typedefs.h"
 
+#include <atomic>
+
 namespace dcpp {
 
-template<size_t N>
-class BloomFilter {
+/**
+* Blocked bloom filter for the N-grams of strings.
+*
+* All K probes of an N-gram are located in the same 512-bit block so that each lookup touches
+* a single cache line. The N-grams are packed in an integer that is rolled forward one character
+* at a time, and mixed to get the block and the bit positions.
+*
+* Adding is thread-safe.
+*/
+template<size_t N, size_t K = 2>
+class BloomFilter : boost::noncopyable {
 public:
-	BloomFilter(size_t tableSize) { table.resize(tableSize); }
+	BloomFilter(size_t tableSize) : blocks(max<size_t>(1, (tableSize + BLOCK_BITS - 1) / BLOCK_BITS)), table(new atomic<uint64_t>[blocks * BLOCK_WORDS]) {
+		static_assert(N > 0 && N <= sizeof(uint64_t), "N-grams must fit in 64 bits");
+		static_assert(K > 0 && K * 9 <= 32, "Too many probes");
+		clear();
+	}
 	~BloomFilter() { }
 
-	void add(const string& s) { xadd(s, N); }
+	void add(const string& s) {
+		forEachGram(s, [this](uint64_t h) {
+			auto block = getBlock(h);
+			for (size_t k = 0; k < K; ++k, h >>= 9) {
+				block[(h >> 6) & (BLOCK_WORDS - 1)].fetch_or(1ULL << (h & 63), memory_order_relaxed);
+			}
+			return true;
+		});
+	}
+
 	bool match(const string& s) const {
-		if(s.length() >= N) {
-			string::size_type l = s.length() - N;
-			for(string::size_type i = 0; i <= l; ++i) {
-				if(!table[getPos(s, i, N)]) {
+		return forEachGram(s, [this](uint64_t h) {
+			auto block = getBlock(h);
+			for (size_t k = 0; k < K; ++k, h >>= 9) {
+				if ((block[(h >> 6) & (BLOCK_WORDS - 1)].load(memory_order_relaxed) & (1ULL << (h & 63))) == 0)
 					return false;
-				}
 			}
-		}
-		return true;
+			return true;
+		});
 	}
+
 	void clear() {
-		size_t s = table.size();
-		table.clear();
-		table.resize(s);
+		for (size_t i = 0; i < blocks * BLOCK_WORDS; ++i) {
+			table[i].store(0, memory_order_relaxed);
+		}
 	}
 
-	void merge(BloomFilter<N>& aBloom) {
-		for (unsigned int i = 0; i < table.size(); ++i) {
-			if (aBloom.table[i] == true) {
-				table[i] = true;
-			}
+	void merge(BloomFilter<N, K>& aBloom) {
+		dcassert(aBloom.blocks == blocks);
+		if (&aBloom == this)
+			return;
+
+		for (size_t i = 0; i < blocks * BLOCK_WORDS; ++i) {
+			table[i].fetch_or(aBloom.table[i].load(memory_order_relaxed), memory_order_relaxed);
 		}
 	}
 #ifdef TESTER
 	void print_table_status() {
 		int tot = 0;
-		for (unsigned int i = 0; i < table.size(); ++i) if (table[i] == true) ++tot;
+		for (size_t i = 0; i < blocks * BLOCK_WORDS; ++i) tot += bitset<64>(table[i].load()).count();
 
-		std::cout << "table status: " << tot << " of " << table.size()
-			<< " filled, for an occupancy percentage of " << (100.*tot)/table.size()
+		std::cout << "table status: " << tot << " of " << blocks * BLOCK_BITS
+			<< " filled, for an occupancy percentage of " << (100.*tot)/(blocks * BLOCK_BITS)
 			<< "%" << std::endl;
 	}
 #endif
 private:
-	void xadd(const string& s, size_t n) {
-		if(s.length() >= n) {
-			string::size_type l = s.length() - n;
-			for(string::size_type i = 0; i <= l; ++i) {
-				table[getPos(s, i, n)] = true;
+	enum {
+		BLOCK_WORDS = 8,
+		BLOCK_BITS = BLOCK_WORDS * 64
+	};
+
+	/* Calls aF with the hash of each N-gram until it returns false */
+	template<class F>
+	static bool forEachGram(const string& s, F aF) {
+		const uint64_t mask = N == sizeof(uint64_t) ? ~0ULL : (1ULL << (8 * N)) - 1;
+
+		uint64_t gram = 0;
+		for (size_t i = 0; i < s.length(); ++i) {
+			gram = ((gram << 8) | static_cast<uint8_t>(s[i])) & mask;
+			if (i + 1 >= N && !aF(mix(gram))) {
+				return false;
 			}
-		} 
+		}
+		return true;
 	}
 
-	/* This is roughly how boost::hash does it */
-	size_t getPos(const string& s, size_t i, size_t l) const {
-		size_t h = 0;
-		const char* c = s.data() + i;
-		const char* end = s.data() + i + l;
-		for(; c < end; ++c) {
-			h ^= *c + 0x9e3779b9 + (h<<6) + (h>>2);
-		}
-		return (h % table.size());
+	/* Finalizer of MurmurHash3 */
+	static uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	/* The upper half of the hash selects the block, the lower half the bits */
+	atomic<uint64_t>* getBlock(uint64_t h) const {
+		return &table[((h >> 32) * blocks >> 32) * BLOCK_WORDS];
 	}
-	
-	vector<bool> table;
+
+	const size_t blocks;
+	unique_ptr<atomic<uint64_t>[]> table;
 };
 
 } // namespace dcpp
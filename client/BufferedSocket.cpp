@@ -25,6 +25,7 @@
 
 #include "ConnectivityManager.h"
 #include "CryptoManager.h"
+#include "File.h"
 #include "SettingsManager.h"
 #include "SSLSocket.h"
 #include "Streams.h"
@@ -39,12 +40,18 @@ using std::max;
 
 // Polling is used for tasks...should be fixed...
 #define POLL_TIMEOUT 250
+// How often to check whether a connection attempt has completed
+#define CONNECT_POLL_INTERVAL 10
 
 BufferedSocket::BufferedSocket(char aSeparator, bool v4only) :
-separator(aSeparator), useLimiter(false), mode(MODE_LINE), dataBytes(0), rollback(0), state(STARTING),
+separator(aSeparator), mode(MODE_LINE), dataBytes(0), rollback(0), state(STARTING),
 disconnecting(false), v4only(v4only)
 {
+#ifdef HAVE_SOCKET_REACTOR
+	SocketReactor::getInstance()->add(this);
+#else
 	start();
+#endif
 
 	++sockets;
 }
@@ -126,48 +133,95 @@ void BufferedSocket::connect(const string& aAddress, const string& aPort, const
 
 #define LONG_TIMEOUT 30000
 #define SHORT_TIMEOUT 1000
-void BufferedSocket::threadConnect(const string& aAddr, const string& aPort, const string& localPort, NatRoles natRole, bool proxy) {
+void BufferedSocket::threadConnect(unique_ptr<ConnectInfo>&& aInfo) {
 	dcassert(state == STARTING);
 
 	fire(BufferedSocketListener::Connecting());
 
-	const uint64_t endTime = GET_TICK() + LONG_TIMEOUT;
-	state = RUNNING;
+	connectInfo = move(aInfo);
+	connectEnd = GET_TICK() + LONG_TIMEOUT;
+	connectRetry = 0;
+	state = CONNECTING;
 
-	while (GET_TICK() < endTime) {
-		//dcdebug("threadConnect attempt %s %s:%s\n", localPort.c_str(), aAddr.c_str(), aPort.c_str());
-		try {
+	startConnect();
+}
 
-			if(proxy) {
-				sock->socksConnect(aAddr, aPort, LONG_TIMEOUT);
-			} else {
-				sock->connect(aAddr, aPort, localPort);
-			}
+/**
+ * Starts a connection attempt, only the name lookup and SOCKS5 negotiation may block
+ */
+void BufferedSocket::startConnect() {
+	//dcdebug("threadConnect attempt %s %s:%s\n", connectInfo->localPort.c_str(), connectInfo->addr.c_str(), connectInfo->port.c_str());
+	try {
+		if(connectInfo->proxy) {
+			sock->socksConnect(connectInfo->addr, connectInfo->port, LONG_TIMEOUT);
+		} else {
+			sock->connect(connectInfo->addr, connectInfo->port, connectInfo->localPort);
+		}
+
+		setOptions();
+	} catch(const SSLSocketException&) {
+		throw;
+	} catch(const SocketException&) {
+		if(connectInfo->natRole == NAT_NONE)
+			throw;
 
-			setOptions();
+		connectRetry = GET_TICK() + SHORT_TIMEOUT;
+	}
+}
 
-			bool connSucceeded;
-			while(!(connSucceeded = sock->waitConnected(POLL_TIMEOUT)) && endTime >= GET_TICK()) {
-				if(disconnecting) return;
-			}
+/**
+ * Checks whether the connection attempt has completed without waiting for the socket
+ */
+bool BufferedSocket::checkConnect() {
+	dcassert(state == CONNECTING);
 
-			if (connSucceeded) {
-				inbuf.resize(sock->getSocketOptInt(SO_RCVBUF));
+	if(disconnecting) {
+		state = RUNNING;
+		return true;
+	}
 
-				fire(BufferedSocketListener::Connected());
-				return;
-			}
+	auto tick = GET_TICK();
+	if(tick >= connectEnd) {
+		throw SocketException(STRING(CONNECTION_TIMEOUT));
+	}
+
+	if(connectRetry > 0) {
+		if(tick < connectRetry) {
+			wakeAt(connectRetry);
+			return false;
 		}
-		catch (const SSLSocketException&) {
-			throw;
-		} catch (const SocketException&) {
-			if (natRole == NAT_NONE)
-				throw;
-			Thread::sleep(SHORT_TIMEOUT);
+
+		connectRetry = 0;
+		startConnect();
+		if(connectRetry > 0) {
+			wakeAt(connectRetry);
+			return false;
+		}
+	}
+
+	try {
+		if(!sock->waitConnected(0)) {
+			// the connecting socket may be either IPv4 or IPv6 so it can't be polled
+			wakeAt(min(tick + CONNECT_POLL_INTERVAL, connectEnd));
+			return false;
 		}
+	} catch(const SSLSocketException&) {
+		throw;
+	} catch(const SocketException&) {
+		if(connectInfo->natRole == NAT_NONE)
+			throw;
+
+		connectRetry = tick + SHORT_TIMEOUT;
+		wakeAt(connectRetry);
+		return false;
 	}
 
-	throw SocketException(STRING(CONNECTION_TIMEOUT));
+	connectInfo.reset();
+	state = RUNNING;
+	inbuf.resize(sock->getSocketOptInt(SO_RCVBUF));
+
+	fire(BufferedSocketListener::Connected());
+	return true;
 }
 
 void BufferedSocket::threadAccept() {
@@ -175,27 +229,50 @@ void BufferedSocket::threadAccept() {
 
 	//dcdebug("threadAccept\n");
 
-	state = RUNNING;
+	state = ACCEPTING;
 
 	inbuf.resize(sock->getSocketOptInt(SO_RCVBUF));
 
-	uint64_t startTime = GET_TICK();
-	while(!sock->waitAccepted(POLL_TIMEOUT)) {
-		if(disconnecting)
-			return;
+	connectEnd = GET_TICK() + 30000;
+}
+
+bool BufferedSocket::checkAccept() {
+	dcassert(state == ACCEPTING);
 
-		if((startTime + 30000) < GET_TICK()) {
+	if(disconnecting) {
+		state = RUNNING;
+		return true;
+	}
+
+	if(!sock->waitAccepted(0)) {
+		auto tick = GET_TICK();
+		if(connectEnd < tick) {
 			throw SocketException(STRING(CONNECTION_TIMEOUT));
 		}
+
+		// the handshake waits for incoming data, check the rare cases of waiting for output once in a while
+		wakeAt(min(tick + POLL_TIMEOUT, connectEnd));
+		return false;
 	}
+
+	state = RUNNING;
+	return true;
 }
 
 void BufferedSocket::threadRead() {
 	if(state != RUNNING)
 		return;
 
-	int left = (mode == MODE_DATA && useLimiter) ? ThrottleManager::getInstance()->read(sock.get(), &inbuf[0], inbuf.size()) : sock->read(&inbuf[0], inbuf.size());
+	uint64_t throttleWait = 0;
+	auto curLimiter = mode == MODE_DATA ? getLimiter() : nullptr;
+	int left = curLimiter ? ThrottleManager::getInstance()->read(sock.get(), curLimiter.get(), &inbuf[0], inbuf.size(), &throttleWait) : sock->read(&inbuf[0], inbuf.size());
 	if(left == -1) {
+		if(throttleWait > 0) {
+			// leave the data in the socket until there are tokens
+			readThrottled = true;
+			wakeAt(GET_TICK() + throttleWait);
+		}
+
 		// EWOULDBLOCK, no data received...
 		return;
 	} else if(left == 0) {
@@ -297,101 +374,165 @@ void BufferedSocket::threadRead() {
 	}
 }
 
-void BufferedSocket::threadSendFile(InputStream* file) {
+/**
+ * Sends the file until the socket would block
+ * @return Whether the transfer has finished
+ */
+bool BufferedSocket::threadSendFile(SendFileInfo& aInfo) {
 	if(state != RUNNING)
-		return;
+		return true;
 
 	if(disconnecting)
-		return;
+		return true;
+
+	auto file = aInfo.stream;
 	dcassert(file != NULL);
-	size_t sockSize = (size_t)sock->getSocketOptInt(SO_SNDBUF);
-	size_t bufSize = max(sockSize, (size_t)64*1024);
 
-	ByteVector readBuf(bufSize);
-	ByteVector writeBuf(bufSize);
+	if(aInfo.bufSize == 0) {
+		aInfo.sockSize = (size_t)sock->getSocketOptInt(SO_SNDBUF);
+		aInfo.bufSize = max(aInfo.sockSize, (size_t)64*1024);
 
-	size_t readPos = 0;
+#ifdef HAVE_SOCKET_SENDFILE
+		if(!sock->isSecure()) {
+			int64_t maxBytes = -1;
+			aInfo.directFile = file->getDirectFile(maxBytes);
+			if(aInfo.directFile) {
+				aInfo.bytesLeft = maxBytes >= 0 ? maxBytes : max(aInfo.directFile->getSize() - aInfo.directFile->getPos(), (int64_t)0);
+			}
+		}
+#endif
+	}
+
+#ifdef HAVE_SOCKET_SENDFILE
+	if(aInfo.directFile) {
+		return threadSendFileDirect(aInfo);
+	}
+#endif
+
+	auto& readBuf = aInfo.readBuf;
+	auto& writeBuf = aInfo.writeBuf;
+	if(readBuf.empty()) {
+		readBuf.resize(aInfo.bufSize);
+	}
 
-	bool readDone = false;
 	//dcdebug("Starting threadSend\n");
 	while(!disconnecting) {
-		if(!readDone && readBuf.size() > readPos) {
-			// Fill read buffer
-			size_t bytesRead = readBuf.size() - readPos;
-			size_t actual = file->read(&readBuf[readPos], bytesRead);
+		if(aInfo.writePos == writeBuf.size()) {
+			if(!aInfo.readDone && readBuf.size() > aInfo.readPos) {
+				// Fill read buffer
+				size_t bytesRead = readBuf.size() - aInfo.readPos;
+				size_t actual = file->read(&readBuf[aInfo.readPos], bytesRead);
+
+				if(bytesRead > 0) {
+					fire(BufferedSocketListener::BytesSent(), bytesRead, 0);
+				}
 
-			if(bytesRead > 0) {
-				fire(BufferedSocketListener::BytesSent(), bytesRead, 0);
+				if(actual == 0) {
+					aInfo.readDone = true;
+				} else {
+					aInfo.readPos += actual;
+				}
 			}
 
-			if(actual == 0) {
-				readDone = true;
-			} else {
-				readPos += actual;
+			if(aInfo.readDone && aInfo.readPos == 0) {
+				fire(BufferedSocketListener::TransmitDone());
+				return true;
 			}
-		}
 
-		if(readDone && readPos == 0) {
-			fire(BufferedSocketListener::TransmitDone());
-			return;
+			readBuf.swap(writeBuf);
+			readBuf.resize(aInfo.bufSize);
+			writeBuf.resize(aInfo.readPos);
+			aInfo.readPos = 0;
+
+			aInfo.writePos = aInfo.writeSize = 0;
+			aInfo.written = 0;
 		}
 
-		readBuf.swap(writeBuf);
-		readBuf.resize(bufSize);
-		writeBuf.resize(readPos);
-		readPos = 0;
-
-		size_t writePos = 0, writeSize = 0;
-		int written = 0;
-
-		while(writePos < writeBuf.size()) {
-			if(disconnecting)
-				return;
-			
-			if(written == -1) {
-				// workaround for OpenSSL (crashes when previous write failed and now retrying with different writeSize)
-				written = sock->write(&writeBuf[writePos], writeSize);
-			} else {
-				writeSize = min(sockSize / 2, writeBuf.size() - writePos);	
-				written = useLimiter ? ThrottleManager::getInstance()->write(sock.get(), &writeBuf[writePos], writeSize) : sock->read(&inbuf[0], inbuf.size());
+		if(aInfo.written == -1) {
+			// workaround for OpenSSL (crashes when previous write failed and now retrying with different writeSize)
+			aInfo.written = sock->write(&writeBuf[aInfo.writePos], aInfo.writeSize);
+		} else {
+			aInfo.writeSize = min(aInfo.sockSize / 2, writeBuf.size() - aInfo.writePos);
+			uint64_t throttleWait = 0;
+			auto curLimiter = getLimiter();
+			aInfo.written = curLimiter ? ThrottleManager::getInstance()->write(sock.get(), curLimiter.get(), &writeBuf[aInfo.writePos], aInfo.writeSize, &throttleWait) : sock->write(&writeBuf[aInfo.writePos], aInfo.writeSize);
+
+			if(throttleWait > 0) {
+				wakeAt(GET_TICK() + throttleWait);
+				return false;
 			}
-			
-			if(written > 0) {
-				writePos += written;
+		}
 
-				fire(BufferedSocketListener::BytesSent(), 0, written);
+		if(aInfo.written > 0) {
+			aInfo.writePos += aInfo.written;
 
-			} else if(written == -1) {
-				if(!readDone && readPos < readBuf.size()) {
-					// Read a little since we're blocking anyway...
-					size_t bytesRead = min(readBuf.size() - readPos, readBuf.size() / 2);
-					size_t actual = file->read(&readBuf[readPos], bytesRead);
+			fire(BufferedSocketListener::BytesSent(), 0, aInfo.written);
 
-					if(bytesRead > 0) {
-						fire(BufferedSocketListener::BytesSent(), bytesRead, 0);
-					}
+		} else if(aInfo.written == -1) {
+			if(!aInfo.readDone && aInfo.readPos < readBuf.size()) {
+				// Read a little since we're waiting anyway...
+				size_t bytesRead = min(readBuf.size() - aInfo.readPos, readBuf.size() / 2);
+				size_t actual = file->read(&readBuf[aInfo.readPos], bytesRead);
 
-					if(actual == 0) {
-						readDone = true;
-					} else {
-						readPos += actual;
-					}
+				if(bytesRead > 0) {
+					fire(BufferedSocketListener::BytesSent(), bytesRead, 0);
+				}
+
+				if(actual == 0) {
+					aInfo.readDone = true;
 				} else {
-					while(!disconnecting) {
-						auto w = sock->wait(POLL_TIMEOUT, true, true);
-						if(w.first) {
-							threadRead();
-						}
-						if(w.second) {
-							break;
-						}
-					}
+					aInfo.readPos += actual;
 				}
+			} else {
+				writeBlocked = true;
+				return false;
 			}
 		}
 	}
+
+	return true;
 }
 
+#ifdef HAVE_SOCKET_SENDFILE
+/**
+ * Sends the file with sendfile so that the data isn't copied to userspace
+ */
+bool BufferedSocket::threadSendFileDirect(SendFileInfo& aInfo) {
+	// the data doesn't pass through our buffers so there's no reason to send it in small pieces
+	size_t chunkSize = max(aInfo.sockSize, (size_t)256*1024);
+	auto& f = *aInfo.directFile;
+
+	while(!disconnecting) {
+		if(aInfo.bytesLeft == 0) {
+			fire(BufferedSocketListener::TransmitDone());
+			return true;
+		}
+
+		size_t len = (size_t)min((int64_t)chunkSize, aInfo.bytesLeft);
+		uint64_t throttleWait = 0;
+		auto curLimiter = getLimiter();
+		int sent = curLimiter ? ThrottleManager::getInstance()->sendFile(sock.get(), curLimiter.get(), f, len, &throttleWait) : sock->sendFile(f, len);
+
+		if(sent > 0) {
+			aInfo.stream->directRead(sent);
+			aInfo.bytesLeft -= sent;
+			fire(BufferedSocketListener::BytesSent(), sent, sent);
+		} else if(sent == -1) {
+			writeBlocked = true;
+			return false;
+		} else if(throttleWait > 0) {
+			wakeAt(GET_TICK() + throttleWait);
+			return false;
+		} else if(f.getPos() >= f.getSize()) {
+			// the file was truncated
+			aInfo.bytesLeft = 0;
+		}
+	}
+
+	return true;
+}
+#endif
+
 void BufferedSocket::write(const char* aBuf, size_t aLen) noexcept {
 	if(!sock.get())
 		return;
@@ -402,44 +543,66 @@ void BufferedSocket::write(const char* aBuf, size_t aLen) noexcept {
 	writeBuf.insert(writeBuf.end(), aBuf, aBuf+aLen);
 }
 
-void BufferedSocket::threadSendData() {
-	if(state != RUNNING)
-		return;
+/**
+ * Sends the data taken by the SEND_DATA task until the socket would block
+ * @return Whether all of it has been sent
+ */
+bool BufferedSocket::threadSendData() {
+	while(sendPos < sendBuf.size()) {
+		if(disconnecting) {
+			break;
+		}
 
-	{
-		Lock l(cs);
-		if(writeBuf.empty())
-			return;
+		int n = sock->write(&sendBuf[sendPos], sendBuf.size() - sendPos);
+		if(n <= 0) {
+			writeBlocked = true;
+			return false;
+		}
 
-		writeBuf.swap(sendBuf);
+		sendPos += n;
 	}
 
-	size_t left = sendBuf.size();
-	size_t done = 0;
-	while(left > 0) {
-		if(disconnecting) {
-			return;
-		}
-
-		auto w = sock->wait(POLL_TIMEOUT, true, true);
+	sendBuf.clear();
+	sendPos = 0;
+	return true;
+}
 
-		if(w.first) {
-			threadRead();
-		}
+void BufferedSocket::wakeAt(uint64_t aTick) noexcept {
+	if(wakeTime == 0 || aTick < wakeTime) {
+		wakeTime = aTick;
+	}
+}
 
-		if(w.second) {
-			int n = sock->write(&sendBuf[done], left);
-			if(n > 0) {
-				left -= n;
-				done += n;
+/**
+ * Continues connecting or sending, the tasks are run in order so the next one can't be started before
+ * @return Whether there's nothing in progress anymore
+ */
+bool BufferedSocket::checkProgress() {
+	switch(state) {
+		case CONNECTING: return checkConnect();
+		case ACCEPTING: return checkAccept();
+		case RUNNING:
+			if(sendFile) {
+				if(!threadSendFile(*sendFile))
+					return false;
+
+				sendFile.reset();
 			}
-		}
+			return threadSendData();
+		default: return true;
 	}
-	sendBuf.clear();
 }
 
 bool BufferedSocket::checkEvents() {
-	while(state == RUNNING ? taskSem.wait(0) : taskSem.wait()) {
+	readThrottled = writeBlocked = false;
+	wakeTime = 0;
+
+#ifdef HAVE_SOCKET_REACTOR
+	// the reactor will run us again when there are new tasks
+	while(checkProgress() && taskSem.wait(0)) {
+#else
+	while(checkProgress() && (state == RUNNING ? taskSem.wait(0) : taskSem.wait())) {
+#endif
 		pair<Tasks, unique_ptr<TaskData> > p;
 		{
 			Lock l(cs);
@@ -459,18 +622,19 @@ bool BufferedSocket::checkEvents() {
 
 		if(state == STARTING) {
 			if(p.first == CONNECT) {
-				ConnectInfo* ci = static_cast<ConnectInfo*>(p.second.get());
-				threadConnect(ci->addr, ci->port, ci->localPort, ci->natRole, ci->proxy);
+				threadConnect(unique_ptr<ConnectInfo>(static_cast<ConnectInfo*>(p.second.release())));
 			} else if(p.first == ACCEPTED) {
 				threadAccept();
 			} else {
 				dcdebug("%d unexpected in STARTING state\n", p.first);
 			}
 		} else if(state == RUNNING) {
+			// checkProgress sends the data
 			if(p.first == SEND_DATA) {
-				threadSendData();
+				Lock l(cs);
+				writeBuf.swap(sendBuf);
 			} else if(p.first == SEND_FILE) {
-				threadSendFile(static_cast<SendFileInfo*>(p.second.get())->stream); break;
+				sendFile.reset(static_cast<SendFileInfo*>(p.second.release()));
 			} else if(p.first == DISCONNECT) {
 				fail("Disconnected");
 			} else {
@@ -482,13 +646,67 @@ bool BufferedSocket::checkEvents() {
 }
 
 void BufferedSocket::checkSocket() {
-	auto w = sock->wait(POLL_TIMEOUT, true, false);
+	uint32_t timeout = POLL_TIMEOUT;
+	if(wakeTime > 0) {
+		auto tick = GET_TICK();
+		timeout = wakeTime > tick ? static_cast<uint32_t>(min(wakeTime - tick, static_cast<uint64_t>(timeout))) : 0;
+	}
+
+	// the connecting socket may be either IPv4 or IPv6, so just wait for the next check
+	bool checkRead = (state == RUNNING || state == ACCEPTING) && !readThrottled;
+	bool checkWrite = state == RUNNING && writeBlocked;
+	if(!checkRead && !checkWrite) {
+		Thread::sleep(timeout);
+		return;
+	}
+
+	auto w = sock->wait(timeout, checkRead, checkWrite);
 
-	if(w.first) {
+	if(w.first && state == RUNNING) {
 		threadRead();
 	}
 }
 
+#ifdef HAVE_SOCKET_REACTOR
+
+/**
+ * Main task dispatcher for the buffered socket abstraction, called by the reactor
+ * when there are new tasks, socket events or the wake time has passed.
+ */
+SocketReactor::Result BufferedSocket::handleEvents() noexcept {
+	try {
+		if(!checkEvents()) {
+			return SocketReactor::RESULT_REMOVE;
+		}
+
+		if(state == RUNNING && sock->wait(0, true, false).first) {
+			threadRead();
+
+			// there may be more (SSL may also have buffered data that won't be reported by epoll)
+			if(!readThrottled)
+				return SocketReactor::RESULT_AGAIN;
+		}
+	} catch(const Exception& e) {
+		fail(e.getError());
+	}
+
+	return SocketReactor::RESULT_WAIT;
+}
+
+socket_t BufferedSocket::getPollSocket() noexcept {
+	return (state == RUNNING || state == ACCEPTING) && sock.get() ? sock->getSock() : INVALID_SOCKET;
+}
+
+int BufferedSocket::getPollEvents() noexcept {
+	return (readThrottled ? 0 : SocketReactor::POLL_READ) | (state == RUNNING && writeBlocked ? SocketReactor::POLL_WRITE : 0);
+}
+
+uint64_t BufferedSocket::getWakeTime() noexcept {
+	return state == FAILED ? 0 : wakeTime;
+}
+
+#else
+
 /**
  * Main task dispatcher for the buffered socket abstraction.
  * @todo Fix the polling...
@@ -500,7 +718,7 @@ int BufferedSocket::run() {
 			if(!checkEvents()) {
 				break;
 			}
-			if(state == RUNNING) {
+			if(state == CONNECTING || state == ACCEPTING || state == RUNNING) {
 				checkSocket();
 			}
 		} catch(const Exception& e) {
@@ -512,6 +730,8 @@ int BufferedSocket::run() {
 	return 0;
 }
 
+#endif
+
 void BufferedSocket::fail(const string& aError) {
 	if(sock.get()) {
 		sock->disconnect();
@@ -532,6 +752,10 @@ void BufferedSocket::shutdown(function<void ()> f) {
 void BufferedSocket::addTask(Tasks task, TaskData* data) {
 	dcassert(task == DISCONNECT || task == SHUTDOWN || sock.get());
 	tasks.emplace_back(task, unique_ptr<TaskData>(data)); taskSem.signal();
+
+#ifdef HAVE_SOCKET_REACTOR
+	SocketReactor::getInstance()->schedule(this);
+#endif
 }
 
 } // namespace dcpp
@@ -26,9 +26,11 @@
 
 #include "BufferedSocketListener.h"
 #include "Semaphore.h"
+#include "SocketReactor.h"
 #include "Thread.h"
 #include "Speaker.h"
 #include "Socket.h"
+#include "ThrottleManager.h"
 #include "atomic.h"
 
 namespace dcpp {
@@ -38,7 +40,11 @@ using std::function;
 using std::pair;
 using std::unique_ptr;
 
+#ifdef HAVE_SOCKET_REACTOR
+class BufferedSocket : public Speaker<BufferedSocketListener>, private SocketReactor::Handler {
+#else
 class BufferedSocket : public Speaker<BufferedSocketListener>, private Thread {
+#endif
 public:
 	enum Modes {
 		MODE_LINE,
@@ -109,7 +115,10 @@ public:
 	bool isV6Valid() const { return sock->isV6Valid(); }
 
 	GETSET(char, separator, Separator);
-	GETSET(bool, useLimiter, UseLimiter);
+
+	/** Traffic class of the socket, nullptr if the transfers aren't throttled (safe to call from any thread) */
+	ThrottleManager::LimiterPtr getLimiter() const noexcept { return std::atomic_load(&limiter); }
+	void setLimiter(const ThrottleManager::LimiterPtr& aLimiter) noexcept { std::atomic_store(&limiter, aLimiter); }
 private:
 	enum Tasks {
 		CONNECT,
@@ -123,6 +132,8 @@ private:
 
 	enum State {
 		STARTING, // Waiting for CONNECT/ACCEPTED/SHUTDOWN
+		CONNECTING,
+		ACCEPTING,
 		RUNNING,
 		FAILED
 	};
@@ -141,6 +152,21 @@ private:
 	struct SendFileInfo : public TaskData {
 		SendFileInfo(InputStream* stream_) : stream(stream_) { }
 		InputStream* stream;
+
+		// progress of the transfer between the calls
+		size_t sockSize = 0;
+		size_t bufSize = 0;
+		ByteVector readBuf;
+		ByteVector writeBuf;
+		size_t readPos = 0;
+		size_t writePos = 0;
+		size_t writeSize = 0;
+		int written = 0;
+		bool readDone = false;
+#ifdef HAVE_SOCKET_SENDFILE
+		File* directFile = nullptr;
+		int64_t bytesLeft = 0;
+#endif
 	};
 	struct CallData : public TaskData {
 		CallData(function<void ()> f) : f(f) { }
@@ -164,25 +190,56 @@ private:
 	ByteVector inbuf;
 	ByteVector writeBuf;
 	ByteVector sendBuf;
+	size_t sendPos = 0;
+	unique_ptr<SendFileInfo> sendFile;
+
+	unique_ptr<ConnectInfo> connectInfo;
+	/** Tick when connecting or accepting times out */
+	uint64_t connectEnd = 0;
+	/** Tick when the next connection attempt should be made, 0 if one is in progress */
+	uint64_t connectRetry = 0;
+
+	// what the socket is waiting for, updated by each round of checkEvents
+	bool readThrottled = false;
+	bool writeBlocked = false;
+	uint64_t wakeTime = 0;
 
 	std::unique_ptr<Socket> sock;
+	ThrottleManager::LimiterPtr limiter;
 	State state;
 	bool disconnecting;
 	bool v4only;
 
+#ifdef HAVE_SOCKET_REACTOR
+	SocketReactor::Result handleEvents() noexcept;
+	socket_t getPollSocket() noexcept;
+	int getPollEvents() noexcept;
+	uint64_t getWakeTime() noexcept;
+#else
 	virtual int run();
+#endif
 
-	void threadConnect(const string& aAddr, const string& aPort, const string& localPort, NatRoles natRole, bool proxy);
+	void threadConnect(unique_ptr<ConnectInfo>&& aInfo);
+	void startConnect();
 	void threadAccept();
 	void threadRead();
-	void threadSendFile(InputStream* is);
-	void threadSendData();
+
+	// these return false when they need to be called again after the socket is ready or wakeTime has passed
+	bool checkConnect();
+	bool checkAccept();
+	bool threadSendFile(SendFileInfo& aInfo);
+#ifdef HAVE_SOCKET_SENDFILE
+	bool threadSendFileDirect(SendFileInfo& aInfo);
+#endif
+	bool threadSendData();
 
 	void fail(const string& aError);
 	static atomic<long> sockets;
 
 	bool checkEvents();
+	bool checkProgress();
 	void checkSocket();
+	void wakeAt(uint64_t aTick) noexcept;
 
 	void setSocket(std::unique_ptr<Socket>&& s);
 	void setOptions();
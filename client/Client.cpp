@@ -129,6 +129,7 @@ void Client::reloadSettings(bool updateNick) {
 	}
 
 	searchQueue.minInterval = get(HubSettings::SearchInterval);
+	ThrottleManager::getInstance()->setHubLimits(getHubUrl(), get(HubSettings::UploadLimit), get(HubSettings::DownloadLimit));
 	if(updateNick)
 		checkNick(get(Nick));
 	else
@@ -44,7 +44,7 @@ namespace dcpp {
 
 using boost::find_if;
 
-ClientManager::ClientManager() : udp(Socket::TYPE_UDP), lastOfflineUserCleanup(GET_TICK()) {
+ClientManager::ClientManager() : udp(Socket::TYPE_UDP), sentUdpPackets(0), lastOfflineUserCleanup(GET_TICK()) {
 	TimerManager::getInstance()->addListener(this);
 }
 
@@ -769,49 +769,70 @@ void ClientManager::userCommand(const HintedUser& user, const UserCommand& uc, P
 }
 
 bool ClientManager::sendUDP(AdcCommand& cmd, const CID& cid, bool noCID /*false*/, bool noPassive /*false*/, const string& aKey /*Util::emptyString*/, const string& aHubUrl /*Util::emptyString*/) noexcept {
+	return sendUDP(&cmd, 1, cid, noCID, noPassive, aKey, aHubUrl);
+}
+
+bool ClientManager::sendUDP(vector<AdcCommand>& aCommands, const CID& cid, bool noCID /*false*/, bool noPassive /*false*/, const string& aKey /*Util::emptyString*/, const string& aHubUrl /*Util::emptyString*/) noexcept {
+	if (aCommands.empty())
+		return true;
+
+	return sendUDP(&aCommands[0], aCommands.size(), cid, noCID, noPassive, aKey, aHubUrl);
+}
+
+bool ClientManager::sendUDP(AdcCommand* aCommands, size_t aCount, const CID& cid, bool noCID, bool noPassive, const string& aKey, const string& aHubUrl) noexcept {
 	RLock l(cs);
 	auto u = findOnlineUser(cid, aHubUrl);
 	if(u) {
-		if(cmd.getType() == AdcCommand::TYPE_UDP && !u->getIdentity().isUdpActive()) {
+		if(aCommands[0].getType() == AdcCommand::TYPE_UDP && !u->getIdentity().isUdpActive()) {
 			if(u->getUser()->isNMDC() || noPassive)
 				return false;
-			cmd.setType(AdcCommand::TYPE_DIRECT);
-			cmd.setTo(u->getIdentity().getSID());
-			u->getClient().send(cmd);
+			for(size_t i = 0; i < aCount; ++i) {
+				auto& cmd = aCommands[i];
+				cmd.setType(AdcCommand::TYPE_DIRECT);
+				cmd.setTo(u->getIdentity().getSID());
+				u->getClient().send(cmd);
+			}
 		} else {
 			try {
-				COMMAND_DEBUG(cmd.toString(), DebugManager::TYPE_CLIENT_UDP, DebugManager::OUTGOING, u->getIdentity().getIp());
-				auto cmdStr = noCID ? cmd.toString() : cmd.toString(getMe()->getCID());
-				if (!aKey.empty() && Encoder::isBase32(aKey.c_str())) {
-					uint8_t keyChar[16];
-					Encoder::fromBase32(aKey.c_str(), keyChar, 16);
-
-					uint8_t ivd[16] = { };
-
-					// prepend 16 random bytes to message
-					RAND_bytes(ivd, 16);
-					cmdStr.insert(0, (char*)ivd, 16);
-					
-					// use PKCS#5 padding to align the message length to the cypher block size (16)
-					uint8_t pad = 16 - (cmdStr.length() & 15);
-					cmdStr.append(pad, (char)pad);
-
-					// encrypt it
-					uint8_t* out = new uint8_t[cmdStr.length()];
-					memset(ivd, 0, 16);
-					int aLen = cmdStr.length();
-
-					AES_KEY key;
-					AES_set_encrypt_key(keyChar, 128, &key);
-					AES_cbc_encrypt((unsigned char*)cmdStr.c_str(), out, cmdStr.length(), &key, ivd, AES_ENCRYPT);
-
-					dcassert((aLen & 15) == 0);
-
-					cmdStr.clear();
-					cmdStr.insert(0, (char*)out, aLen);
-					delete[] out;
+				StringList packets;
+				for(size_t i = 0; i < aCount; ++i) {
+					auto& cmd = aCommands[i];
+					COMMAND_DEBUG(cmd.toString(), DebugManager::TYPE_CLIENT_UDP, DebugManager::OUTGOING, u->getIdentity().getIp());
+					auto cmdStr = noCID ? cmd.toString() : cmd.toString(getMe()->getCID());
+					if (!aKey.empty() && Encoder::isBase32(aKey.c_str())) {
+						uint8_t keyChar[16];
+						Encoder::fromBase32(aKey.c_str(), keyChar, 16);
+
+						uint8_t ivd[16] = { };
+
+						// prepend 16 random bytes to message
+						RAND_bytes(ivd, 16);
+						cmdStr.insert(0, (char*)ivd, 16);
+						
+						// use PKCS#5 padding to align the message length to the cypher block size (16)
+						uint8_t pad = 16 - (cmdStr.length() & 15);
+						cmdStr.append(pad, (char)pad);
+
+						// encrypt it
+						uint8_t* out = new uint8_t[cmdStr.length()];
+						memset(ivd, 0, 16);
+						int aLen = cmdStr.length();
+
+						AES_KEY key;
+						AES_set_encrypt_key(keyChar, 128, &key);
+						AES_cbc_encrypt((unsigned char*)cmdStr.c_str(), out, cmdStr.length(), &key, ivd, AES_ENCRYPT);
+
+						dcassert((aLen & 15) == 0);
+
+						cmdStr.clear();
+						cmdStr.insert(0, (char*)out, aLen);
+						delete[] out;
+					}
+					packets.push_back(move(cmdStr));
 				}
-				udp.writeTo(u->getIdentity().getIp(), u->getIdentity().getUdpPort(), cmdStr);
+
+				udp.writeBatchTo(u->getIdentity().getIp(), u->getIdentity().getUdpPort(), packets);
+				sentUdpPackets += packets.size();
 			} catch(const SocketException&) {
 				dcdebug("Socket exception sending ADC UDP command\n");
 			}
@@ -907,8 +928,12 @@ void ClientManager::on(NmdcSearch, Client* aClient, const string& aSeeker, int a
 				if(port.empty()) 
 					port = "412";
 
+				StringList packets;
 				for(const auto& sr: l)
-					udp.writeTo(ip, port, sr->toSR(*aClient));
+					packets.push_back(sr->toSR(*aClient));
+
+				udp.writeBatchTo(ip, port, packets);
+				sentUdpPackets += packets.size();
 
 			} catch(...) {
 				dcdebug("Search caught error\n");
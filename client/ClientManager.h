@@ -163,6 +163,9 @@ public:
 	string getClientStats() const noexcept;
 	
 	bool sendUDP(AdcCommand& c, const CID& to, bool noCID = false, bool noPassive = false, const string& encryptionKey = Util::emptyString, const string& aHubUrl = Util::emptyString) noexcept;
+	/** Sends the commands to the same user with as few system calls as possible */
+	bool sendUDP(vector<AdcCommand>& aCommands, const CID& to, bool noCID = false, bool noPassive = false, const string& encryptionKey = Util::emptyString, const string& aHubUrl = Util::emptyString) noexcept;
+	uint64_t getSentUdpPackets() const noexcept { return sentUdpPackets; }
 
 	bool connect(const UserPtr& aUser, const string& aToken, bool allowUrlChange, string& lastError_, string& hubHint_, bool& isProtocolError) noexcept;
 	bool privateMessage(const HintedUser& user, const string& msg, string& error_, bool thirdPerson) noexcept;
@@ -209,6 +212,7 @@ private:
 	UserPtr me;
 
 	Socket udp;
+	atomic<uint64_t> sentUdpPackets;
 	
 	CID pid;
 	uint64_t lastOfflineUserCleanup;
@@ -236,6 +240,7 @@ private:
 	OnlineUser* findOnlineUserHint(const CID& cid, const string& hintUrl, OnlinePairC& p) const noexcept;
 
 	void onSearch(const Client* c, const AdcCommand& adc, OnlineUser& from) noexcept;
+	bool sendUDP(AdcCommand* aCommands, size_t aCount, const CID& to, bool noCID, bool noPassive, const string& encryptionKey, const string& aHubUrl) noexcept;
 
 	// ClientListener
 	void on(Connected, const Client* c) noexcept;
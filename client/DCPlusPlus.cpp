@@ -22,6 +22,7 @@
 #include "ConnectionManager.h"
 #include "DownloadManager.h"
 #include "GeoManager.h"
+#include "UploadCache.h"
 #include "UploadManager.h"
 #include "CryptoManager.h"
 #include "ShareManager.h"
@@ -42,6 +43,7 @@
 #include "ThrottleManager.h"
 #include "IgnoreManager.h"
 #include "HighlightManager.h"
+#include "SocketReactor.h"
 
 #include "StringTokenizer.h"
 
@@ -82,11 +84,15 @@ void startup(function<void(const string&)> stepF, function<bool(const string& /*
 	TimerManager::newInstance();
 	HashManager::newInstance();
 	CryptoManager::newInstance();
+#ifdef HAVE_SOCKET_REACTOR
+	SocketReactor::newInstance();
+#endif
 	SearchManager::newInstance();
 	ClientManager::newInstance();
 	ConnectionManager::newInstance();
 	DownloadManager::newInstance();
 	UploadManager::newInstance();
+	UploadCache::newInstance();
 	ThrottleManager::newInstance();
 	QueueManager::newInstance();
 	ShareManager::newInstance();
@@ -174,6 +180,9 @@ void shutdown(function<void (const string&)> stepF, function<void (float)> progr
 	ConnectivityManager::getInstance()->close();
 	GeoManager::getInstance()->close();
 	BufferedSocket::waitShutdown();
+#ifdef HAVE_SOCKET_REACTOR
+	SocketReactor::deleteInstance();
+#endif
 	
 	announce(STRING(SAVING_SETTINGS));
 	AutoSearchManager::getInstance()->AutoSearchSave();
@@ -199,6 +208,7 @@ void shutdown(function<void (const string&)> stepF, function<void (float)> progr
 	QueueManager::deleteInstance();
 	DownloadManager::deleteInstance();
 	UploadManager::deleteInstance();
+	UploadCache::deleteInstance();
 	ShareScannerManager::deleteInstance();
 	ConnectionManager::deleteInstance();
 	SearchManager::deleteInstance();
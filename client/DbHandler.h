@@ -21,6 +21,7 @@
 #define DCPLUSPLUS_DCPP_DBHANDLER_H_
 
 #include "stdinc.h"
+#include "atomic.h"
 #include "Exception.h"
 #include "Text.h"
 #include "Util.h"
@@ -54,8 +55,25 @@ public:
 	virtual int64_t getSizeOnDisk() throw(DbException) = 0;
 
 	virtual void remove_if(std::function<bool(void* aKey, size_t keyLen, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot = nullptr) throw(DbException) = 0;
+
+	/* Same as above for the keys in range [aFrom, aTo), an empty aTo means the end of the database. The iteration ends when aStop is set
+	 * but the removals of the keys handled by then are written. Different ranges may be processed in parallel. */
+	virtual void remove_if(std::function<bool(void* aKey, size_t keyLen, void* aValue, size_t valueLen)> f, const string& aFrom, const string& aTo, const atomic<bool>& aStop, DbSnapshot* aSnapshot = nullptr) throw(DbException) = 0;
+
+	/* Returns keys that split the database into aCount ranges with approximately equal size (or less if the database is small) */
+	virtual StringList getSplitKeys(size_t /*aCount*/) throw(DbException) { return StringList(); }
+
+	/* Calls f for all keys that start with aPrefix and don't contain aSeparator after it (direct children of a path). Keys
+	 * under deeper levels are skipped without iterating through them. */
+	virtual void forEachChild(void* aPrefix, size_t prefixLen, char aSeparator, std::function<void(void* aKey, size_t keyLen, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot = nullptr) throw(DbException) = 0;
 	virtual void compact() {}
 
+	/* Group the following writes into batches that are committed when the batch reaches aMaxBytes or the oldest pending write
+	 * is older than aMaxDelay milliseconds. Pending writes are visible to reads, flush must be called to commit them otherwise.
+	 * The pending writes of aFlushFirst are committed before each commit of this database (e.g. for entries referring to it). */
+	virtual void setGroupCommit(size_t /*aMaxBytes*/, uint64_t /*aMaxDelay*/, DbHandler* /*aFlushFirst*/ = nullptr) noexcept { }
+	virtual void flush() throw(DbException) { }
+
 	virtual string getStats() throw(DbException) { return "Not supported"; }
 	virtual string getRepairFlag() const = 0;
 
@@ -179,34 +179,6 @@ void DirectoryListing::loadFile() throw(Exception, AbortException) {
 	}
 }
 
-class ListLoader : public SimpleXMLReader::CallBack {
-public:
-	ListLoader(DirectoryListing* aList, DirectoryListing::Directory* root, const string& aBase, bool aUpdating, const UserPtr& aUser, bool aCheckDupe, bool aPartialList, time_t aListDate) : 
-	  list(aList), cur(root), base(aBase), inListing(false), updating(aUpdating), user(aUser), checkDupe(aCheckDupe), partialList(aPartialList), dirsLoaded(0), listDate(aListDate) { 
-	}
-
-	virtual ~ListLoader() { }
-
-	void startTag(const string& name, StringPairList& attribs, bool simple);
-	void endTag(const string& name);
-
-	//const string& getBase() const { return base; }
-	int getLoadedDirs() { return dirsLoaded; }
-private:
-	DirectoryListing* list;
-	DirectoryListing::Directory* cur;
-	UserPtr user;
-
-	string baseLower;
-	string base;
-	bool inListing;
-	bool updating;
-	bool checkDupe;
-	bool partialList;
-	int dirsLoaded;
-	time_t listDate;
-};
-
 int DirectoryListing::updateXML(const string& xml, const string& aBase) {
 	MemoryInputStream mis(xml);
 	return loadXML(mis, true, aBase);
@@ -237,6 +209,36 @@ static const string sName = "Name";
 static const string sSize = "Size";
 static const string sTTH = "TTH";
 static const string sDate = "Date";
+void ListLoader::startTagRefs(const string& name, const SimpleXMLReader::AttribRefList& attribs, bool simple) {
+	if(!inListing || name != sFile) {
+		SimpleXMLReader::CallBack::startTagRefs(name, attribs, simple);
+		return;
+	}
+
+	if(list->getClosing()) {
+		throw AbortException();
+	}
+
+	// files make most of the list so their attributes are read directly from the parser's buffer
+	auto n = getAttrib(attribs, sName, 0);
+	if(n.empty())
+		return;
+	auto s = getAttrib(attribs, sSize, 1);
+	if(s.empty())
+		return;
+
+	addFile(n.str(), s.toInt64(), getAttrib(attribs, sTTH, 2).str(), getAttrib(attribs, sDate, 3).toUInt32());
+}
+
+void ListLoader::addFile(const string& aName, int64_t aSize, const string& aTTH, uint32_t aDate) {
+	if(aTTH.empty() && !SettingsManager::lanMode)
+		return;		
+	TTHValue tth(aTTH); /// @todo verify validity?
+
+	DirectoryListing::File* f = new DirectoryListing::File(cur, aName, aSize, tth, checkDupe, aDate);
+	cur->files.push_back(f);
+}
+
 void ListLoader::startTag(const string& name, StringPairList& attribs, bool simple) {
 	if(list->getClosing()) {
 		throw AbortException();
@@ -250,15 +252,8 @@ void ListLoader::startTag(const string& name, StringPairList& attribs, bool simp
 			const string& s = getAttrib(attribs, sSize, 1);
 			if(s.empty())
 				return;
-			auto size = Util::toInt64(s);
-
-			const string& h = getAttrib(attribs, sTTH, 2);
-			if(h.empty() && !SettingsManager::lanMode)
-				return;		
-			TTHValue tth(h); /// @todo verify validity?
 
-			DirectoryListing::File* f = new DirectoryListing::File(cur, n, size, tth, checkDupe, Util::toUInt32(getAttrib(attribs, sDate, 3)));
-			cur->files.push_back(f);
+			addFile(n, Util::toInt64(s), getAttrib(attribs, sTTH, 2), Util::toUInt32(getAttrib(attribs, sDate, 3)));
 		} else if(name == sDirectory) {
 			const string& n = getAttrib(attribs, sName, 0);
 			if(n.empty()) {
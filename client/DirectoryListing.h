@@ -40,6 +40,7 @@
 #include "TaskQueue.h"
 #include "UserInfoBase.h"
 #include "SearchResult.h"
+#include "SimpleXMLReader.h"
 #include "ShareManager.h"
 #include "Streams.h"
 #include "TargetUtil.h"
@@ -281,6 +282,38 @@ private:
 	HintedUser hintedUser;
 };
 
+/** Loads the XML file lists into DirectoryListing */
+class ListLoader : public SimpleXMLReader::CallBack {
+public:
+	ListLoader(DirectoryListing* aList, DirectoryListing::Directory* root, const string& aBase, bool aUpdating, const UserPtr& aUser, bool aCheckDupe, bool aPartialList, time_t aListDate) : 
+	  list(aList), cur(root), base(aBase), inListing(false), updating(aUpdating), user(aUser), checkDupe(aCheckDupe), partialList(aPartialList), dirsLoaded(0), listDate(aListDate) { 
+	}
+
+	virtual ~ListLoader() { }
+
+	void startTag(const string& name, StringPairList& attribs, bool simple);
+	void startTagRefs(const string& name, const SimpleXMLReader::AttribRefList& attribs, bool simple);
+	void endTag(const string& name);
+
+	//const string& getBase() const { return base; }
+	int getLoadedDirs() { return dirsLoaded; }
+private:
+	void addFile(const string& aName, int64_t aSize, const string& aTTH, uint32_t aDate);
+
+	DirectoryListing* list;
+	DirectoryListing::Directory* cur;
+	UserPtr user;
+
+	string baseLower;
+	string base;
+	bool inListing;
+	bool updating;
+	bool checkDupe;
+	bool partialList;
+	int dirsLoaded;
+	time_t listDate;
+};
+
 inline bool operator==(const DirectoryListing::Directory::Ptr& a, const string& b) { return Util::stricmp(a->getName(), b) == 0; }
 inline bool operator==(const DirectoryListing::File::Ptr& a, const string& b) { return Util::stricmp(a->getName(), b) == 0; }
 
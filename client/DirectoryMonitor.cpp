@@ -22,10 +22,12 @@
 #include "ResourceManager.h"
 #include "Text.h"
 
-/*#ifndef _WIN32
-#include <sys/inotify.h>
+#ifndef _WIN32
+#include <dirent.h>
 #include <sys/epoll.h>
-#endif*/
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
 
 namespace dcpp {
 
@@ -65,19 +67,32 @@ void DirectoryMonitor::Server::init() throw(MonitorException) {
 		throw MonitorException(Util::translateError(::GetLastError()));
 	}
 #else
-	/*fd = inotify_init();
-	if (fd < 0)
-		throw MonitorException(Util::translateError(::GetLastError()));
+	// the thread of the previous run has exited (the monitors are added again after stopping)
+	closeHandles();
 
-	efd = epoll_create(sizeof(int));
-	if (efd < 0)
-		throw MonitorException(Util::translateError(::GetLastError()));
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		threadRunning.clear();
+		throw MonitorException(Util::translateError(errno));
+	}
 
-	ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
-	cfg = epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev);
-	if (cfg < 0)
-		throw MonitorException(Util::translateError(::GetLastError()));*/
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0) {
+		auto error = errno;
+		closeHandles();
+		threadRunning.clear();
+		throw MonitorException(Util::translateError(error));
+	}
 
+	struct epoll_event ev = { };
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		auto error = errno;
+		closeHandles();
+		threadRunning.clear();
+		throw MonitorException(Util::translateError(error));
+	}
 #endif
 
 	start();
@@ -199,13 +214,17 @@ void Monitor::openDirectory(HANDLE iocp) {
 
 #else
 
-Monitor::Monitor(const string& aPath, DirectoryMonitor::Server* aServer, int monitorFlags, size_t bufferSize) {
+Monitor::Monitor(const string& aPath, DirectoryMonitor::Server* aServer, int /*monitorFlags*/, size_t /*bufferSize*/) :
+	server(aServer),
+	changes(0),
+	path(aPath),
+	stopped(false) {
 }
 
 Monitor::~Monitor() { }
 
 void Monitor::stopMonitoring() {
-
+	stopped = true;
 }
 
 DirectoryMonitor::Server::Server(DirectoryMonitor* aBase, int numThreads) : base(aBase), m_bTerminate(false), m_nThreads(numThreads) {
@@ -213,7 +232,22 @@ DirectoryMonitor::Server::Server(DirectoryMonitor* aBase, int numThreads) : base
 }
 
 DirectoryMonitor::Server::~Server() {
+	closeHandles();
+}
+
+void DirectoryMonitor::Server::closeHandles() noexcept {
+	if (efd >= 0) {
+		close(efd);
+		efd = -1;
+	}
 
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	// the watch descriptors were released with the inotify instance
+	watches.clear();
 }
 
 #endif
@@ -359,44 +393,232 @@ bool DirectoryMonitor::Server::addDirectory(const string& aPath) throw(MonitorEx
 #else
 
 bool DirectoryMonitor::Server::addDirectory(const string& aPath) throw(MonitorException) {
-	//int fd = inotify_init();
-	//if (fd < 0)
-	//	throw MonitorException(Util::translateError(::GetLastError()));
+	{
+		RLock l(cs);
+		if (monitors.find(aPath) != monitors.end())
+			return false;
+	}
 
-	/*int wd = inotify_add_watch(fd, Text::fromUtf8(aPath), IN_MODIFY);
-	if (wd < 0)
-		throw MonitorException(Util::translateError(::GetLastError()));
+	init();
 
+	Monitor* mon = new Monitor(aPath, this, 0, 0);
 
-	int cfg = epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev);
-	if (cfg < 0)
-		throw MonitorException(Util::translateError(::GetLastError()));*/
+	WLock l(cs);
+	try {
+		addWatches(mon, aPath);
+	} catch (MonitorException&) {
+		removeWatches(mon, aPath);
+		delete mon;
+		throw;
+	}
 
+	monitors.emplace(aPath, mon);
 	return true;
 }
 
+void DirectoryMonitor::Server::addWatches(Monitor* aMon, const string& aPath) throw(MonitorException) {
+	const auto nativePath = Text::fromUtf8(aPath);
+	auto wd = inotify_add_watch(fd, nativePath.c_str(), IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_EXCL_UNLINK);
+	if (wd < 0) {
+		if (errno == ENOSPC)
+			throw MonitorException(STRING(MONITOR_WATCH_LIMIT));
+
+		if (aPath == aMon->path)
+			throw MonitorException(getErrorStr(errno));
+
+		// the subdirectory was removed already or it can't be accessed
+		return;
+	}
+
+	watches[wd] = { aMon, aPath };
+
+	// list the subdirectories before adding them so that the directory won't be kept open during the recursion
+	StringList subDirs;
+	DIR* dir = opendir(nativePath.c_str());
+	if (!dir)
+		return;
+
+	while (auto ent = readdir(dir)) {
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		bool isDir = ent->d_type == DT_DIR;
+		if (ent->d_type == DT_UNKNOWN) {
+			// symlinks aren't followed
+			struct stat inode;
+			isDir = lstat((nativePath + ent->d_name).c_str(), &inode) == 0 && S_ISDIR(inode.st_mode);
+		}
+
+		if (isDir)
+			subDirs.push_back(Text::toUtf8(ent->d_name));
+	}
+
+	closedir(dir);
+
+	for (const auto& d: subDirs)
+		addWatches(aMon, aPath + d + PATH_SEPARATOR);
+}
+
+void DirectoryMonitor::Server::removeWatches(const Monitor* aMon, const string& aPath) {
+	for (auto i = watches.begin(); i != watches.end();) {
+		if (i->second.monitor == aMon && i->second.path.compare(0, aPath.length(), aPath) == 0) {
+			inotify_rm_watch(fd, i->first);
+			i = watches.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void DirectoryMonitor::Server::renameWatches(const Monitor* aMon, const string& aOldPath, const string& aNewPath) {
+	for (auto& w: watches | map_values) {
+		if (w.monitor == aMon && w.path.compare(0, aOldPath.length(), aOldPath) == 0) {
+			w.path.replace(0, aOldPath.length(), aNewPath);
+		}
+	}
+}
+
 void DirectoryMonitor::Server::deleteDirectory(DirectoryMonitor::Server::MonitorMap::iterator mon) {
+	removeWatches(mon->second, mon->second->path);
+	delete mon->second;
+	monitors.erase(mon);
+}
 
+void DirectoryMonitor::Server::addCreatedDirectory(Monitor* aMon, const string& aPath, NotificationList& notifications_) {
+	try {
+		addWatches(aMon, aPath + PATH_SEPARATOR);
+	} catch (const MonitorException&) {
+		// changes in the new directory can't be tracked, the whole tree needs to be refreshed
+		notifications_.emplace_back(Notification::TYPE_OVERFLOW, aMon->path);
+	}
 }
 
 int DirectoryMonitor::Server::read() {
-	/*struct epoll_event ev;
-	ev.events = EPOLLIN|EPOLLOUT|EPOLLET;
-	int ret = epoll_wait(efd, &ev, 100, 86400000);
-	if (ret > 0) {
-		
-	} else if (ret < 0) {
-		perror("Error in the polling");
-		break;
-	} else {
-		perror("Timed Out");
-		break;
-	}*/
-	return 0;
+	{
+		WLock l(cs);
+
+		// remove the stopped monitors
+		for (auto i = monitors.begin(); i != monitors.end();) {
+			auto cur = i++;
+			if (cur->second->stopped)
+				deleteDirectory(cur);
+		}
+
+		if (m_bTerminate && monitors.empty())
+			return 0;
+	}
+
+	struct epoll_event ev;
+	auto ret = epoll_wait(efd, &ev, 1, POLL_TIMEOUT);
+	if (ret <= 0) {
+		// timeout or an interrupted call
+		return 1;
+	}
+
+	// read everything that is available and deliver the changes as a single batch
+	vector<PendingMove> moves;
+	NotificationList notifications;
+
+	alignas(struct inotify_event) char buf[EVENT_BUFFER_SIZE];
+	for (;;) {
+		auto len = ::read(fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+
+		WLock l(cs);
+		handleEvents(buf, len, moves, notifications);
+	}
+
+	if (!moves.empty()) {
+		// moved outside the monitored trees
+		WLock l(cs);
+		for (const auto& m: moves) {
+			if (m.isDirectory)
+				removeWatches(m.monitor, m.path + PATH_SEPARATOR);
+			notifications.emplace_back(Notification::TYPE_DELETED, m.path);
+		}
+	}
+
+	if (!notifications.empty()) {
+		auto b = base;
+		b->callAsync([=] { b->processNotifications(notifications); });
+	}
+
+	return 1;
 }
 
-void DirectoryMonitor::processNotification(const string& aPath, const ByteVector& aBuf) {
+void DirectoryMonitor::Server::handleEvents(const char* aBuf, ssize_t aLen, vector<PendingMove>& moves_, NotificationList& notifications_) {
+	for (auto p = aBuf; p < aBuf + aLen; ) {
+		auto e = reinterpret_cast<const struct inotify_event*>(p);
+		p += sizeof(struct inotify_event) + e->len;
 
+		if (e->mask & IN_Q_OVERFLOW) {
+			// events were lost, refresh everything
+			for (const auto m: monitors | map_values) {
+				if (!m->stopped)
+					notifications_.emplace_back(Notification::TYPE_OVERFLOW, m->path);
+			}
+			continue;
+		}
+
+		auto w = watches.find(e->wd);
+		if (w == watches.end())
+			continue;
+
+		auto mon = w->second.monitor;
+		if (e->mask & IN_IGNORED) {
+			// the directory was deleted or unmounted
+			if (w->second.path == mon->path && !mon->stopped) {
+				mon->stopped = true;
+				notifications_.emplace_back(Notification::TYPE_FAILED, mon->path, getErrorStr(ENOENT));
+			}
+
+			watches.erase(w);
+			continue;
+		}
+
+		if (e->len == 0 || mon->stopped)
+			continue;
+
+		mon->changes++;
+
+		const auto path = w->second.path + Text::toUtf8(e->name);
+		const bool isDir = (e->mask & IN_ISDIR) > 0;
+		if (e->mask & IN_CREATE) {
+			if (isDir)
+				addCreatedDirectory(mon, path, notifications_);
+			notifications_.emplace_back(Notification::TYPE_CREATED, path);
+		} else if (e->mask & (IN_MODIFY | IN_CLOSE_WRITE)) {
+			// writes are reported continuously, skip the duplicates
+			if (notifications_.empty() || notifications_.back().type != Notification::TYPE_MODIFIED || notifications_.back().path != path)
+				notifications_.emplace_back(Notification::TYPE_MODIFIED, path);
+		} else if (e->mask & IN_DELETE) {
+			notifications_.emplace_back(Notification::TYPE_DELETED, path);
+		} else if (e->mask & IN_MOVED_FROM) {
+			moves_.push_back({ e->cookie, mon, path, isDir });
+		} else if (e->mask & IN_MOVED_TO) {
+			auto m = find_if(moves_.begin(), moves_.end(), [e](const PendingMove& aMove) { return aMove.cookie == e->cookie; });
+			if (m == moves_.end()) {
+				// moved from outside the monitored trees
+				if (isDir)
+					addCreatedDirectory(mon, path, notifications_);
+				notifications_.emplace_back(Notification::TYPE_CREATED, path);
+				continue;
+			}
+
+			if (m->isDirectory) {
+				if (m->monitor == mon) {
+					renameWatches(mon, m->path + PATH_SEPARATOR, path + PATH_SEPARATOR);
+				} else {
+					removeWatches(m->monitor, m->path + PATH_SEPARATOR);
+					addCreatedDirectory(mon, path, notifications_);
+				}
+			}
+
+			notifications_.emplace_back(Notification::TYPE_RENAMED, m->path, path);
+			moves_.erase(m);
+		}
+	}
 }
 
 #endif
@@ -510,6 +732,31 @@ void DirectoryMonitor::processNotification(const string& aPath, const ByteVector
 
 #else
 
+void DirectoryMonitor::processNotifications(const NotificationList& aNotifications) {
+	for (const auto& n: aNotifications) {
+		switch(n.type) {
+			case Notification::TYPE_CREATED:
+				fire(DirectoryMonitorListener::FileCreated(), n.path);
+				break;
+			case Notification::TYPE_MODIFIED:
+				fire(DirectoryMonitorListener::FileModified(), n.path);
+				break;
+			case Notification::TYPE_RENAMED:
+				fire(DirectoryMonitorListener::FileRenamed(), n.path, n.extra);
+				break;
+			case Notification::TYPE_DELETED:
+				fire(DirectoryMonitorListener::FileDeleted(), n.path);
+				break;
+			case Notification::TYPE_OVERFLOW:
+				fire(DirectoryMonitorListener::Overflow(), n.path);
+				break;
+			case Notification::TYPE_FAILED:
+				fire(DirectoryMonitorListener::DirectoryFailed(), n.path, n.extra);
+				break;
+		}
+	}
+}
+
 #endif
 
 } //dcpp
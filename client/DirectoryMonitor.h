@@ -64,6 +64,31 @@ public:
 	}
 private:
 	friend class Monitor;
+
+#ifndef WIN32
+	// Changes collected by the monitoring thread, they are fired in the dispatcher thread
+	struct Notification {
+		enum Type {
+			TYPE_CREATED,
+			TYPE_MODIFIED,
+			TYPE_RENAMED,
+			TYPE_DELETED,
+			TYPE_OVERFLOW,
+			TYPE_FAILED
+		};
+
+		Notification(Type aType, const string& aPath, const string& aExtra = Util::emptyString) : type(aType), path(aPath), extra(aExtra) { }
+
+		Type type;
+		string path;
+
+		// new path for renames, error for failures
+		string extra;
+	};
+
+	typedef vector<Notification> NotificationList;
+#endif
+
 	class Server : public Thread {
 	public:
 		Server(DirectoryMonitor* aBase, int numThreads);
@@ -96,6 +121,35 @@ private:
 #ifdef WIN32
 		HANDLE m_hIOCP;
 #else
+		enum {
+			POLL_TIMEOUT = 500,
+			EVENT_BUFFER_SIZE = 64 * 1024
+		};
+
+		struct Watch {
+			Monitor* monitor;
+			string path;
+		};
+
+		struct PendingMove {
+			uint32_t cookie;
+			Monitor* monitor;
+			string path;
+			bool isDirectory;
+		};
+
+		// Adds watches for the directory and all its subdirectories
+		void addWatches(Monitor* aMon, const string& aPath) throw(MonitorException);
+		void removeWatches(const Monitor* aMon, const string& aPath);
+		void renameWatches(const Monitor* aMon, const string& aOldPath, const string& aNewPath);
+
+		void handleEvents(const char* aBuf, ssize_t aLen, vector<PendingMove>& moves_, NotificationList& notifications_);
+		void closeHandles() noexcept;
+		void addCreatedDirectory(Monitor* aMon, const string& aPath, NotificationList& notifications_);
+
+		// watch descriptor -> watched directory
+		unordered_map<int, Watch> watches;
+
 		int efd = -1;
 		int fd = -1;
 #endif
@@ -104,7 +158,11 @@ private:
 
 	Server* server;
 
+#ifdef WIN32
 	void processNotification(const string& aPath, const ByteVector& aBuf);
+#else
+	void processNotifications(const NotificationList& aNotifications);
+#endif
 	DispatcherQueue dispatcher;
 };
 
@@ -120,8 +178,6 @@ public:
 	void openDirectory(HANDLE iocp);
 	void beginRead();
 #else
-	//int addWatch(const string& aPath);
-
 	Monitor(const string& aPath, DirectoryMonitor::Server* aParent, int monitorFlags, size_t bufferSize);
 	~Monitor();
 #endif
@@ -153,7 +209,11 @@ private:
 	int errorCount;
 	int key;
 #else
+	// root path of the watched tree
+	const string path;
 
+	// the watches will be removed by the monitoring thread
+	bool stopped;
 #endif
 };
 
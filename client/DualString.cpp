@@ -86,20 +86,25 @@ size_t DualString::initSizeArray(size_t strLen) {
 	return arrSize;
 }
 
+void DualString::freeSizeArray() noexcept {
+	delete[] charSizes;
+	charSizes = nullptr;
+}
+
 DualString& DualString::operator=(DualString&& rhs) {
-	assign(rhs.begin(), rhs.end());
+	freeSizeArray();
+
+	string::operator=(std::move(rhs));
 	charSizes = rhs.charSizes;
 	rhs.charSizes = nullptr;
 	return *this; 
 }
 
-DualString::DualString(DualString&& rhs) : charSizes(rhs.charSizes) {
-	assign(rhs.begin(), rhs.end());
+DualString::DualString(DualString&& rhs) : string(std::move(rhs)), charSizes(rhs.charSizes) {
 	rhs.charSizes = nullptr;
 }
 
-DualString::DualString(const DualString& rhs) {
-	assign(rhs.begin(), rhs.end());
+DualString::DualString(const DualString& rhs) : string(rhs) {
 	if (rhs.charSizes) {
 		auto size = initSizeArray(rhs.size());
 		for (size_t s = 0; s < size; ++s) {
@@ -110,10 +115,10 @@ DualString::DualString(const DualString& rhs) {
 }
 
 DualString& DualString::operator= (const DualString& rhs) {
-	if (charSizes) {
-		delete charSizes;
-		charSizes = nullptr;
-	}
+	if (this == &rhs)
+		return *this;
+
+	freeSizeArray();
 
 	assign(rhs.begin(), rhs.end());
 	if (rhs.charSizes) {
@@ -126,8 +131,7 @@ DualString& DualString::operator= (const DualString& rhs) {
 }
 
 DualString::~DualString() { 
-	if (charSizes)
-		delete charSizes; 
+	freeSizeArray();
 }
 
 string DualString::getNormal() const {
@@ -165,4 +169,17 @@ string DualString::getNormal() const {
 
 bool DualString::lowerCaseOnly() const noexcept {
 	return !charSizes; 
-}
\ No newline at end of file
+}
+
+size_t DualString::getMemoryUsage() const noexcept {
+	size_t ret = sizeof(DualString);
+
+	// short strings are usually stored in the object itself
+	if (capacity() > 15)
+		ret += capacity() + 1;
+
+	if (charSizes)
+		ret += ((string::size() + ARRAY_BITS - 1) / ARRAY_BITS) * sizeof(MaskType);
+
+	return ret;
+}
@@ -42,12 +42,16 @@ public:
 
 	bool lowerCaseOnly() const noexcept;
 
+	// Approximate number of bytes used by the string
+	size_t getMemoryUsage() const noexcept;
+
 	DualString(DualString&& rhs);
 	DualString& operator=(DualString&&);
 	DualString(const DualString&);
 	DualString& operator= (const DualString& other);
 private:
 	size_t initSizeArray(size_t strLen);
+	void freeSizeArray() noexcept;
 	MaskType* charSizes = nullptr;
 };
 
@@ -526,7 +526,28 @@ string File::getMountPath(const string& aPath) noexcept {
 		return Util::emptyString;
 	}
 
-	return Util::toString((uint32_t)statbuf.st_dev);
+	// walk up until the parent directory is on a different device
+	string path = aPath;
+	while (path.size() > 1 && path.back() == PATH_SEPARATOR)
+		path.pop_back();
+
+	while (path.size() > 1) {
+		auto pos = path.rfind(PATH_SEPARATOR);
+		if (pos == string::npos)
+			break;
+
+		auto parent = pos == 0 ? string(1, PATH_SEPARATOR) : path.substr(0, pos);
+
+		struct stat parentStat;
+		if (stat(Text::fromUtf8(parent).c_str(), &parentStat) == -1 || parentStat.st_dev != statbuf.st_dev)
+			break;
+
+		path = parent;
+	}
+
+	if (path.empty() || path.back() != PATH_SEPARATOR)
+		path += PATH_SEPARATOR;
+	return path;
 }
 
 uint64_t File::getLastModified(const string& aPath) noexcept {
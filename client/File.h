@@ -98,6 +98,11 @@ public:
 
 	uint64_t getLastModified() const noexcept;
 
+	File* getDirectFile(int64_t& aMaxBytes) noexcept { aMaxBytes = -1; return this; }
+#ifndef _WIN32
+	int getNativeHandle() const noexcept { return h; }
+#endif
+
 	static bool createFile(const string& aPath, const string& aContent = Util::emptyString) noexcept;
 	static void copyFile(const string& src, const string& target);
 	static void renameFile(const string& source, const string& target);
@@ -26,8 +26,12 @@
 #include "Util.h"
 
 #ifndef _WIN32
+#include "atomic.h"
+#include "ScopedFunctor.h"
+#include "Semaphore.h"
 #include "TimerManager.h"
 #include <fcntl.h>
+#include <thread>
 #endif
 
 namespace dcpp {
@@ -273,8 +277,124 @@ size_t FileReader::readMapped(const string& /*file*/, const DataCallback& /*call
 #include <unistd.h>
 
 
+struct FileDescriptor : boost::noncopyable {
+	FileDescriptor(int fd) : fd(fd) { }
+	~FileDescriptor() { ::close(fd); }
+
+	operator int() { return fd; }
+
+	int fd;
+};
+
 size_t FileReader::readDirect(const string& file, const DataCallback& callback) {
+#ifdef O_DIRECT
+	int tmp = open(Text::fromUtf8(file).c_str(), O_RDONLY | O_DIRECT);
+	if(tmp == -1) {
+		dcdebug("Failed to open unbuffered file %s: %s\n", file.c_str(), Util::translateError(errno).c_str());
+		return READ_FAILED;
+	}
+
+	FileDescriptor fd(tmp);
+
+	struct stat statbuf;
+	if(fstat(fd, &statbuf) == -1) {
+		dcdebug("Error opening file %s: %s\n", file.c_str(), Util::translateError(errno).c_str());
+		return READ_FAILED;
+	}
+
+	// O_DIRECT requires the buffers, offsets and sizes to be aligned by the logical block size, which doesn't exceed the page size
+	const size_t alignment = getpagesize();
+	const size_t bufSize = getBlockSize(alignment);
+	buffer.resize(bufSize * READ_AHEAD + alignment);
+	auto buf = static_cast<uint8_t*>(align(&buffer[0], alignment));
+
+	if(statbuf.st_size < static_cast<int64_t>(bufSize)) {
+		// Not worth starting a thread for
+		auto n = pread(fd, buf, bufSize, 0);
+		if(n < 0) {
+			dcdebug("Unbuffered read failed for %s: %s\n", file.c_str(), Util::translateError(errno).c_str());
+			return READ_FAILED;
+		}
+
+		if(n > 0) {
+			callback(buf, n);
+		}
+		return n;
+	}
+
+	// Read the following blocks in a separate thread while the callback processes the current one
+	vector<pair<ssize_t, int>> results(READ_AHEAD);
+	Semaphore freeBlocks, readBlocks;
+	atomic<bool> stop { false };
+
+	for(size_t i = 0; i < READ_AHEAD; ++i) {
+		freeBlocks.signal();
+	}
+
+	std::thread reader([&] {
+		int64_t pos = 0;
+		for(size_t i = 0;; i = (i + 1) % READ_AHEAD) {
+			freeBlocks.wait();
+			if(stop) {
+				break;
+			}
+
+			auto n = pread(fd, buf + i * bufSize, bufSize, pos);
+			results[i] = make_pair(n, n < 0 ? errno : 0);
+			readBlocks.signal();
+
+			// Error or end of file
+			if(n < static_cast<ssize_t>(bufSize)) {
+				break;
+			}
+
+			pos += n;
+		}
+	});
+
+	size_t total = 0;
+	int error = 0;
+
+	// The reader must also be stopped if the callback throws
+	{
+		ScopedFunctor([&] {
+			stop = true;
+			freeBlocks.signal();
+			reader.join();
+		});
+
+		for(size_t i = 0;; i = (i + 1) % READ_AHEAD) {
+			readBlocks.wait();
+
+			auto n = results[i].first;
+			if(n < 0) {
+				error = results[i].second;
+				break;
+			}
+
+			total += n;
+			if((n > 0 && !callback(buf + i * bufSize, n)) || n < static_cast<ssize_t>(bufSize)) {
+				break;
+			}
+
+			freeBlocks.signal();
+		}
+	}
+
+	if(error != 0) {
+		if(total == 0) {
+			// Probably not supported by the file system
+			dcdebug("Unbuffered read failed for %s: %s\n", file.c_str(), Util::translateError(error).c_str());
+			return READ_FAILED;
+		}
+
+		throw FileException(Util::translateError(error));
+	}
+
+	return total;
+#else
 	return READ_FAILED;
+#endif
 }
 
 static const int64_t BUF_SIZE = 0x1000000 - (0x1000000 % getpagesize());
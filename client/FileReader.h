@@ -64,6 +64,8 @@ public:
 private:
 	static const size_t DEFAULT_BLOCK_SIZE = 256*1024;
 	static const size_t DEFAULT_MMAP_SIZE = 64*1024*1024;
+	/** Number of blocks that may be read ahead of the callback in direct mode */
+	static const size_t READ_AHEAD = 4;
 
 	string file;
 	bool direct;
@@ -34,7 +34,7 @@ namespace dcpp {
  */
 class HashBloom {
 public:
-	HashBloom() : k(0), h(0) { }
+	HashBloom() : k(0), m(0), h(0) { }
 
 	/** Return a suitable value for k based on n */
 	static size_t get_k(size_t n, size_t h);
@@ -50,9 +50,14 @@ public:
 private:	
 	
 	size_t pos(const TTHValue& tth, size_t n) const;
-	
-	std::vector<bool> bloom;
+
+	bool get(size_t aPos) const { return (bloom[aPos / 64] >> (aPos % 64)) & 1; }
+	void set(size_t aPos) { bloom[aPos / 64] |= 1ULL << (aPos % 64); }
+
+	// bit i of the filter is stored in bit i % 64 of word i / 64
+	std::vector<uint64_t> bloom;
 	size_t k;
+	size_t m;
 	size_t h;
 };
 
@@ -27,10 +27,13 @@
 #include "ShareManager.h"
 #include "ResourceManager.h"
 #include "ScopedFunctor.h"
+#include "SettingsManager.h"
+#include "SimpleXML.h"
 #include "SimpleXMLReader.h"
 #include "Util.h"
 #include "version.h"
 #include "ZUtils.h"
+#include "concurrency.h"
 
 //#include "BerkeleyDB.h"
 #include "LevelDB.h"
@@ -63,6 +66,18 @@ bool HashManager::checkTTH(const string& aFileLower, const string& aFileName, Ha
 	return true;
 }
 
+bool HashManager::checkTTH(const string& aFileLower, const string& aFileName, HashedFile& fi_, const HashedFileMap& aDirFiles) {
+	dcassert(Text::isLower(aFileLower));
+	auto p = aDirFiles.find(aFileLower);
+	if (p == aDirFiles.end() || p->second.getTimeStamp() != fi_.getTimeStamp() || p->second.getSize() != fi_.getSize()) {
+		hashFile(aFileName, aFileLower, fi_.getSize());
+		return false;
+	}
+
+	fi_ = p->second;
+	return true;
+}
+
 void HashManager::getFileInfo(const string& aFileLower, const string& aFileName, HashedFile& fi_) throw(HashException) {
 	dcassert(Text::isLower(aFileLower));
 	auto found = store.getFileInfo(aFileLower, fi_);
@@ -191,7 +206,7 @@ void HashManager::getFileTTH(const string& aFile, int64_t aSize, bool addStore,
 		auto start = GET_TICK();
 		int64_t tickHashed = 0;
 
-		FileReader fr(true);
+		FileReader fr(SETTING(HASH_DIRECT_READ));
 		fr.read(aFile, [&](const void* buf, size_t n) -> bool {
 			tt.update(buf, n);
 
@@ -219,6 +234,7 @@ void HashManager::getFileTTH(const string& aFile, int64_t aSize, bool addStore,
 		if (addStore && !aCancel) {
 			auto fi = HashedFile(tth_, timestamp, aSize);
 			store.addHashedFile(pathLower, tt, fi);
+			flush();
 		}
 	} else {
 		tth_ = fi.getRoot();
@@ -526,117 +542,311 @@ bool HashManager::HashStore::getFileInfo(const string& aFileLower, HashedFile& f
 	return false;
 }
 
+void HashManager::HashStore::getDirectoryFiles(const string& aDirLower, HashedFileMap& files_) noexcept {
+	dcassert(!aDirLower.empty() && aDirLower.back() == PATH_SEPARATOR);
+	try {
+		fileDb->forEachChild((void*)aDirLower.c_str(), aDirLower.length(), PATH_SEPARATOR, [&](void* aKey, size_t keyLen, void* aValue, size_t valueLen) {
+			HashedFile fi;
+			if (loadFileInfo(aValue, valueLen, fi)) {
+				files_.emplace(string((const char*)aKey, keyLen), fi);
+			}
+		});
+	} catch(DbException& e) {
+		LogManager::getInstance()->message(STRING_F(READ_FAILED_X, fileDb->getNameLower() % e.getError()), LogManager::LOG_ERROR);
+	}
+}
+
+HashManager::HashStore::MaintenanceShardList HashManager::HashStore::createShards(DbHandler& aDb, bool aDone) throw(DbException) {
+	auto keys = aDb.getSplitKeys(MAINTENANCE_SHARDS);
+
+	MaintenanceShardList ret;
+	string from;
+	for (auto& k: keys) {
+		auto to = k;
+		ret.emplace_back(move(from), move(to), aDone);
+		from = move(k);
+	}
+
+	ret.emplace_back(move(from), string(), aDone);
+	return ret;
+}
+
+#define MAINTENANCE_FILE "HashMaintenance.xml"
+
+void HashManager::HashStore::onShardDone(MaintenanceShard& aShard, MaintenancePhase aPhase, bool aVerify, const MaintenanceShardList& aShards) noexcept {
+	Lock l(maintenanceCS);
+	if (aShard.done)
+		return;
+
+	aShard.done = true;
+	saveMaintenance(aPhase, aVerify, aShards);
+}
+
+void HashManager::HashStore::saveMaintenance(MaintenancePhase aPhase, bool aVerify, const MaintenanceShardList& aShards) noexcept {
+	SimpleXML xml;
+	xml.addTag("Maintenance");
+	xml.addChildAttrib("Phase", static_cast<int>(aPhase));
+	xml.addChildAttrib("Verify", aVerify);
+	xml.stepIn();
+
+	for (const auto& s: aShards) {
+		xml.addTag("Range");
+		xml.addChildAttrib("From", Encoder::toBase32((const uint8_t*)s.from.data(), s.from.size()));
+		xml.addChildAttrib("To", Encoder::toBase32((const uint8_t*)s.to.data(), s.to.size()));
+		xml.addChildAttrib("Done", s.done);
+	}
+
+	xml.stepOut();
+	SettingsManager::saveSettingFile(xml, Util::PATH_USER_CONFIG, MAINTENANCE_FILE);
+}
+
+bool HashManager::HashStore::loadMaintenance(MaintenancePhase& phase_, bool& verify_, MaintenanceShardList& shards_) noexcept {
+	auto decode = [](const string& aKey) {
+		string ret(aKey.size() * 5 / 8, '\0');
+		Encoder::fromBase32(aKey.c_str(), (uint8_t*)&ret[0], ret.size());
+		return ret;
+	};
+
+	try {
+		SimpleXML xml;
+		SettingsManager::loadSettingFile(xml, Util::PATH_USER_CONFIG, MAINTENANCE_FILE, false);
+		if (!xml.findChild("Maintenance"))
+			return false;
+
+		phase_ = static_cast<MaintenancePhase>(xml.getIntChildAttrib("Phase"));
+		verify_ = xml.getBoolChildAttrib("Verify");
+
+		xml.stepIn();
+		while (xml.findChild("Range")) {
+			shards_.emplace_back(decode(xml.getChildAttrib("From")), decode(xml.getChildAttrib("To")), xml.getBoolChildAttrib("Done"));
+		}
+		xml.stepOut();
+	} catch (const Exception& e) {
+		LogManager::getInstance()->message(STRING_F(LOAD_FAILED_X, MAINTENANCE_FILE % e.getError()), LogManager::LOG_ERROR);
+		shards_.clear();
+	}
+
+	return !shards_.empty() && phase_ <= PHASE_MISSING;
+}
+
 void HashManager::HashStore::optimize(bool doVerify) noexcept {
 	getInstance()->fire(HashManagerListener::MaintananceStarted());
 
-	int unusedTrees = 0;
-	int failedTrees = 0;
-	int unusedFiles=0; 
-	int validFiles = 0;
-	int validTrees = 0;
-	int missingTrees = 0;
-	int removedFiles = 0;
-	int64_t failedSize = 0;
+	atomic<int> unusedTrees(0);
+	atomic<int> failedTrees(0);
+	atomic<int> unusedFiles(0);
+	atomic<int> validFiles(0);
+	atomic<int> validTrees(0);
+	atomic<int> missingTrees(0);
+	atomic<int> removedFiles(0);
+	atomic<int64_t> failedSize(0);
+
+	// continue an interrupted maintenance
+	MaintenancePhase savedPhase = PHASE_FILES;
+	bool savedVerify = false;
+	MaintenanceShardList savedShards;
+	auto resumed = loadMaintenance(savedPhase, savedVerify, savedShards);
+	if (resumed) {
+		doVerify = doVerify || savedVerify;
+		LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_RESUMED), LogManager::LOG_INFO);
+	} else {
+		LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_STARTED), LogManager::LOG_INFO);
+	}
 
-	LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_STARTED), LogManager::LOG_INFO);
-	{
-		unordered_set<TTHValue> usedRoots;
+	auto getShards = [&](DbHandler& aDb, MaintenancePhase aPhase) -> MaintenanceShardList {
+		if (resumed && savedPhase == aPhase)
+			return move(savedShards);
+
+		// the phases finished earlier are only walked through for collecting the roots
+		auto replay = resumed && savedPhase > aPhase;
+		auto ret = createShards(aDb, replay);
+		if (!replay)
+			saveMaintenance(aPhase, doVerify, ret);
+		return ret;
+	};
+
+	const auto& stop = getInstance()->aShutdown;
+	auto onFailed = [&](const DbHandler& aDb, const DbException& e) {
+		LogManager::getInstance()->message(STRING_F(READ_FAILED_X, aDb.getNameLower() % e.getError()), LogManager::LOG_ERROR);
+		LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_FAILED), LogManager::LOG_ERROR);
+		getInstance()->fire(HashManagerListener::MaintananceFinished());
+	};
+
+	auto onInterrupted = [&] {
+		LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_INTERRUPTED), LogManager::LOG_WARNING);
+		getInstance()->fire(HashManagerListener::MaintananceFinished());
+	};
 
+	{
 		//make sure that the databases stay in sync so that trees added during this operation won't get removed
 		unique_ptr<DbSnapshot> fileSnapshot(fileDb->getSnapshot()); 
 		unique_ptr<DbSnapshot> hashSnapshot(hashDb->getSnapshot()); 
 
-		HashedFile fi;
-		string path;
-
 		// lookup each item in file index from the share
+		vector<TTHValue> usedRoots;
 		try {
-			fileDb->remove_if([&](void* aKey, size_t key_len, void* aValue, size_t valueLen) {
-				path = string((const char*)aKey, key_len);
-				if (ShareManager::getInstance()->isRealPathShared(path)) {
-					if (!loadFileInfo(aValue, valueLen, fi))
+			auto shards = getShards(*fileDb, PHASE_FILES);
+			parallel_for_each(shards.begin(), shards.end(), [&](MaintenanceShard& s) {
+				HashedFile fi;
+				fileDb->remove_if([&](void* aKey, size_t key_len, void* aValue, size_t valueLen) {
+					if (!s.done && !ShareManager::getInstance()->isRealPathShared(string((const char*)aKey, key_len))) {
+						unusedFiles++;
 						return true;
+					}
+
+					if (!loadFileInfo(aValue, valueLen, fi))
+						return !s.done;
 
-					usedRoots.emplace(fi.getRoot());
+					s.roots.push_back(fi.getRoot());
 					validFiles++;
 					return false;
-				} else {
-					unusedFiles++;
-					return true;
-				}
-			}, fileSnapshot.get());
+				}, s.from, s.to, stop, fileSnapshot.get());
+
+				if (!stop)
+					onShardDone(s, PHASE_FILES, doVerify, shards);
+			});
+
+			if (stop) {
+				onInterrupted();
+				return;
+			}
+
+			for (auto& s: shards) {
+				usedRoots.insert(usedRoots.end(), s.roots.begin(), s.roots.end());
+				vector<TTHValue>().swap(s.roots);
+			}
 		} catch(DbException& e) {
-			LogManager::getInstance()->message(STRING_F(READ_FAILED_X, fileDb->getNameLower() % e.getError()), LogManager::LOG_ERROR);
-			LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_FAILED), LogManager::LOG_ERROR);
-			getInstance()->fire(HashManagerListener::MaintananceFinished());
+			onFailed(*fileDb, e);
 			return;
 		}
 
+		// a sorted vector takes a fraction of the memory of a hash set and the trees are iterated in the same order
+		sort(usedRoots.begin(), usedRoots.end());
+		usedRoots.erase(unique(usedRoots.begin(), usedRoots.end()), usedRoots.end());
+
 		//remove trees that aren't shared or queued and optionally check whether each tree can be loaded
-		TigerTree tt;
-		TTHValue curRoot;
+		vector<TTHValue> invalidRoots;
 		try {
-			hashDb->remove_if([&](void* aKey, size_t key_len, void* aValue, size_t valueLen) {
-				memcpy(&curRoot, aKey, key_len);
-				auto i = usedRoots.find(curRoot);
-				if (i == usedRoots.end() && !QueueManager::getInstance()->isFileQueued(curRoot)) {
-					//not needed
-					unusedTrees++;
+			auto shards = getShards(*hashDb, PHASE_TREES);
+			parallel_for_each(shards.begin(), shards.end(), [&](MaintenanceShard& s) {
+				auto rootLess = [](const TTHValue& aRoot, const string& aKey) { return string((const char*)aRoot.data, sizeof(TTHValue)) < aKey; };
+				auto cur = lower_bound(usedRoots.begin(), usedRoots.end(), s.from, rootLess);
+				auto end = s.to.empty() ? usedRoots.end() : lower_bound(cur, usedRoots.end(), s.to, rootLess);
+
+				TigerTree tt;
+				TTHValue curRoot;
+				hashDb->remove_if([&](void* aKey, size_t key_len, void* aValue, size_t valueLen) {
+					if (key_len != sizeof(TTHValue))
+						return !s.done;
+
+					memcpy(&curRoot, aKey, key_len);
+
+					// the roots skipped by now don't have a tree
+					for (; cur != end && *cur < curRoot; ++cur) {
+						s.roots.push_back(*cur);
+						missingTrees++;
+					}
+
+					auto used = cur != end && *cur == curRoot;
+					if (used)
+						++cur;
+
+					if (s.done) {
+						if (used)
+							validTrees++;
+						return false;
+					}
+
+					if (!used && !QueueManager::getInstance()->isFileQueued(curRoot)) {
+						//not needed
+						unusedTrees++;
+						return true;
+					}
+
+					if (!doVerify || loadTree(aValue, valueLen, curRoot, tt, false)) {
+						//valid tree
+						validTrees++;
+						return false;
+					}
+
+					//failed to load it
+					failedTrees++;
+					if (used)
+						s.roots.push_back(curRoot);
 					return true;
+				}, s.from, s.to, stop, hashSnapshot.get());
+
+				if (stop)
+					return;
+
+				for (; cur != end; ++cur) {
+					s.roots.push_back(*cur);
+					missingTrees++;
 				}
-				
-				if (!doVerify || loadTree(aValue, valueLen, curRoot, tt, false)) {
-					//valid tree
-					if (i != usedRoots.end())
-						usedRoots.erase(i);
-					validTrees++;
-					return false;
-				}
 
-				//failed to load it
-				failedTrees++;
-				return true;
-			}, hashSnapshot.get());
+				onShardDone(s, PHASE_TREES, doVerify, shards);
+			});
+
+			if (stop) {
+				onInterrupted();
+				return;
+			}
+
+			for (const auto& s: shards)
+				invalidRoots.insert(invalidRoots.end(), s.roots.begin(), s.roots.end());
 		} catch(DbException& e) {
-			LogManager::getInstance()->message(STRING_F(READ_FAILED_X, hashDb->getNameLower() % e.getError()), LogManager::LOG_ERROR);
-			LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_FAILED), LogManager::LOG_ERROR);
-			getInstance()->fire(HashManagerListener::MaintananceFinished());
+			onFailed(*hashDb, e);
 			return;
 		}
 
 		//remove file entries that don't have a corresponding hash data entry
-		missingTrees = usedRoots.size() - failedTrees;
-		if (usedRoots.size() > 0) {
+		vector<TTHValue>().swap(usedRoots);
+		sort(invalidRoots.begin(), invalidRoots.end());
+		if (!invalidRoots.empty()) {
 			try {
-				HashedFile fi;
-				fileDb->remove_if([&](void* /*aKey*/, size_t /*key_len*/, void* aValue, size_t valueLen) {
-					loadFileInfo(aValue, valueLen, fi);
-					if (usedRoots.find(fi.getRoot()) != usedRoots.end()) {
-						failedSize += fi.getSize();
-						validFiles--;
-						removedFiles++;
-						return true;
-					}
+				auto shards = getShards(*fileDb, PHASE_MISSING);
+				parallel_for_each(shards.begin(), shards.end(), [&](MaintenanceShard& s) {
+					if (s.done)
+						return;
+
+					HashedFile fi;
+					fileDb->remove_if([&](void* /*aKey*/, size_t /*key_len*/, void* aValue, size_t valueLen) {
+						loadFileInfo(aValue, valueLen, fi);
+						if (binary_search(invalidRoots.begin(), invalidRoots.end(), fi.getRoot())) {
+							failedSize += fi.getSize();
+							validFiles--;
+							removedFiles++;
+							return true;
+						}
 
-					return false;
-				}, fileSnapshot.get());
+						return false;
+					}, s.from, s.to, stop, fileSnapshot.get());
+
+					if (!stop)
+						onShardDone(s, PHASE_MISSING, doVerify, shards);
+				});
+
+				if (stop) {
+					onInterrupted();
+					return;
+				}
 			} catch(DbException& e) {
-				LogManager::getInstance()->message(STRING_F(READ_FAILED_X, fileDb->getNameLower() % e.getError()), LogManager::LOG_ERROR);
-				LogManager::getInstance()->message(STRING(HASHDB_MAINTENANCE_FAILED), LogManager::LOG_ERROR);
-				getInstance()->fire(HashManagerListener::MaintananceFinished());
+				onFailed(*fileDb, e);
 				return;
 			}
 		}
 	}
 
-	SettingsManager::getInstance()->set(SettingsManager::CUR_REMOVED_FILES, SETTING(CUR_REMOVED_FILES) + unusedFiles + missingTrees);
+	File::deleteFile(Util::getPath(Util::PATH_USER_CONFIG) + MAINTENANCE_FILE);
+
+	SettingsManager::getInstance()->set(SettingsManager::CUR_REMOVED_FILES, SETTING(CUR_REMOVED_FILES) + unusedFiles.load() + missingTrees.load());
 	if (validFiles == 0 || (static_cast<double>(SETTING(CUR_REMOVED_FILES)) / static_cast<double>(validFiles)) > 0.05) {
 		LogManager::getInstance()->message(STRING_F(COMPACTING_X, fileDb->getNameLower()), LogManager::LOG_INFO);
 		fileDb->compact();
 		SettingsManager::getInstance()->set(SettingsManager::CUR_REMOVED_FILES, 0);
 	}
 
-	SettingsManager::getInstance()->set(SettingsManager::CUR_REMOVED_TREES, SETTING(CUR_REMOVED_TREES) + unusedTrees + failedTrees);
+	SettingsManager::getInstance()->set(SettingsManager::CUR_REMOVED_TREES, SETTING(CUR_REMOVED_TREES) + unusedTrees.load() + failedTrees.load());
 	if (validTrees == 0 || (static_cast<double>(SETTING(CUR_REMOVED_TREES)) / static_cast<double>(validTrees)) > 0.05) {
 		LogManager::getInstance()->message(STRING_F(COMPACTING_X, hashDb->getNameLower()), LogManager::LOG_INFO);
 		hashDb->compact();
@@ -645,7 +855,7 @@ void HashManager::HashStore::optimize(bool doVerify) noexcept {
 
 	string msg;
 	if (unusedFiles > 0 || unusedTrees > 0) {
-		msg = STRING_F(HASHDB_MAINTENANCE_UNUSED, unusedFiles % unusedTrees);
+		msg = STRING_F(HASHDB_MAINTENANCE_UNUSED, unusedFiles.load() % unusedTrees.load());
 	} else {
 		msg = STRING(HASHDB_MAINTENANCE_NO_UNUSED);
 	}
@@ -654,12 +864,12 @@ void HashManager::HashStore::optimize(bool doVerify) noexcept {
 
 	if (failedTrees > 0 || missingTrees > 0) {
 		if (doVerify) {
-			msg = STRING_F(REBUILD_FAILED_ENTRIES_VERIFY, missingTrees % failedTrees);
+			msg = STRING_F(REBUILD_FAILED_ENTRIES_VERIFY, missingTrees.load() % failedTrees.load());
 		} else {
-			msg = STRING_F(REBUILD_FAILED_ENTRIES_OPTIMIZE, missingTrees);
+			msg = STRING_F(REBUILD_FAILED_ENTRIES_OPTIMIZE, missingTrees.load());
 		}
 
-		msg += ". " + STRING_F(REBUILD_REFRESH_PROMPT, Util::formatBytes(failedSize));
+		msg += ". " + STRING_F(REBUILD_REFRESH_PROMPT, Util::formatBytes(failedSize.load()));
 		LogManager::getInstance()->message(msg, LogManager::LOG_ERROR);
 	}
 
@@ -732,6 +942,35 @@ void HashManager::HashStore::openDb(StepFunction stepF, MessageFunction messageF
 
 	hashDb->open(stepF, messageF);
 	fileDb->open(stepF, messageF);
+
+	// Each write is synced separately otherwise, which becomes the bottleneck with multiple hashers and small files.
+	// The pending writes are committed when the hashers become idle at the latest.
+	// The trees are always committed before the file entries so that there are no files without trees after a crash.
+	hashDb->setGroupCommit(4*1024*1024, 3000);
+	fileDb->setGroupCommit(256*1024, 3000, hashDb.get());
+}
+
+void HashManager::HashStore::flush() throw(HashException) {
+	// trees first so that there are no files without trees
+	try {
+		hashDb->flush();
+	} catch (DbException& e) {
+		throw HashException(STRING_F(WRITE_FAILED_X, hashDb->getNameLower() % e.getError()));
+	}
+
+	try {
+		fileDb->flush();
+	} catch (DbException& e) {
+		throw HashException(STRING_F(WRITE_FAILED_X, fileDb->getNameLower() % e.getError()));
+	}
+}
+
+void HashManager::flush() noexcept {
+	try {
+		store.flush();
+	} catch (const HashException& e) {
+		LogManager::getInstance()->message(e.getError(), LogManager::LOG_ERROR);
+	}
 }
 
 class HashLoader: public SimpleXMLReader::CallBack {
@@ -827,6 +1066,7 @@ void HashManager::HashStore::load(StepFunction stepF, ProgressFunction progressF
 				CountedInputStream<false> countedStream(&f);
 				HashLoader l(*this, countedStream, hashDataSize + hashIndexSize, progressF);
 				SimpleXMLReader(&l).parse(countedStream);
+				flush();
 				migratedFiles = l.migratedFiles;
 				migratedTrees = l.migratedTrees;
 				failedTrees = l.failedTrees;
@@ -933,8 +1173,9 @@ HashManager::HashStore::HashStore() {
 }
 
 void HashManager::HashStore::closeDb() {
-	hashDb.reset(nullptr);
+	// the file index flushes the trees when it's closed
 	fileDb.reset(nullptr);
+	hashDb.reset(nullptr);
 }
 
 HashManager::HashStore::~HashStore() {
@@ -1074,6 +1315,8 @@ void HashManager::shutdown(ProgressFunction progressF) noexcept {
 		}
 		Thread::sleep(50);
 	}
+
+	flush();
 }
 
 void HashManager::Hasher::clear() noexcept {
@@ -1161,7 +1404,7 @@ int HashManager::Hasher::run() {
 
 				uint64_t lastRead = GET_TICK();
  
-                FileReader fr(true);
+                FileReader fr(SETTING(HASH_DIRECT_READ));
 				fr.read(fname, [&](const void* buf, size_t n) -> bool {
 					uint64_t now = GET_TICK();
 					if(SETTING(MAX_HASH_SPEED)> 0) {
@@ -1251,12 +1494,14 @@ int HashManager::Hasher::run() {
 		};
 
 		bool deleteThis = false;
+		bool idle = false;
 		{
 			WLock l(hcs);
 			if (!fname.empty())
 				removeDevice(curDevID);
 
 			if (w.empty()) {
+				idle = true;
 				if (sizeHashed > 0) {
 					if (dirsHashed == 0) {
 						onDirHashed();
@@ -1288,6 +1533,9 @@ int HashManager::Hasher::run() {
 			currentFile.clear();
 		}
 
+		if (idle)
+			getInstance()->flush();
+
 		if (!failed && !fname.empty())
 			getInstance()->fire(HashManagerListener::TTHDone(), fname, fi);
 
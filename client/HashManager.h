@@ -73,6 +73,19 @@ public:
 	 */
 	bool checkTTH(const string& fileLower, const string& aFileName, HashedFile& fi_);
 
+	/** Stored file information by lowercase path */
+	typedef unordered_map<string, HashedFile> HashedFileMap;
+
+	/**
+	 * Load the stored information of all files directly inside the directory (the path must end with a separator)
+	 */
+	void getDirectoryFiles(const string& aDirLower, HashedFileMap& files_) noexcept { store.getDirectoryFiles(aDirLower, files_); }
+
+	/**
+	 * Same as checkTTH but uses the information loaded with getDirectoryFiles instead of reading the database
+	 */
+	bool checkTTH(const string& fileLower, const string& aFileName, HashedFile& fi_, const HashedFileMap& aDirFiles);
+
 	void stopHashing(const string& baseDir) noexcept;
 	void setPriority(Thread::Priority p) noexcept;
 
@@ -113,6 +126,9 @@ public:
 	string getDbStats() { return store.getDbStats(); }
 	void compact() noexcept { store.compact(); }
 
+	/** Commit the pending database writes */
+	void flush() noexcept;
+
 	void closeDB() { store.closeDb(); }
 	void onScheduleRepair(bool schedule) noexcept { store.onScheduleRepair(schedule); }
 	bool isRepairScheduled() const noexcept { return store.isRepairScheduled(); }
@@ -225,6 +241,7 @@ private:
 
 		void addTree(const TigerTree& tt) throw(HashException);
 		bool getFileInfo(const string& aFileLower, HashedFile& aFile);
+		void getDirectoryFiles(const string& aDirLower, HashedFileMap& files_) noexcept;
 		bool getTree(const TTHValue& root, TigerTree& tth);
 		bool hasTree(const TTHValue& root) throw(HashException);
 
@@ -244,9 +261,11 @@ private:
 
 		void getDbSizes(int64_t& fileDbSize_, int64_t& hashDbSize_) const noexcept;
 		void compact() noexcept;
+		void flush() throw(HashException);
 	private:
-		std::unique_ptr<DbHandler> fileDb;
+		// destroyed after the file index that refers to it
 		std::unique_ptr<DbHandler> hashDb;
+		std::unique_ptr<DbHandler> fileDb;
 
 
 		friend class HashLoader;
@@ -261,12 +280,44 @@ private:
 		static bool loadFileInfo(const void* src, size_t len, HashedFile& aFile);
 		static void saveFileInfo(void *dest, const HashedFile& aTree);
 		static uint32_t getFileInfoSize(const HashedFile& aTree);
+
+		/* The maintenance processes key ranges of the databases in parallel. Finished ranges are saved so that an interrupted maintenance
+		can be continued from the same position. */
+		enum MaintenancePhase {
+			PHASE_FILES,
+			PHASE_TREES,
+			PHASE_MISSING
+		};
+
+		enum {
+			MAINTENANCE_SHARDS = 32
+		};
+
+		struct MaintenanceShard {
+			MaintenanceShard(string&& aFrom, string&& aTo, bool aDone) : from(move(aFrom)), to(move(aTo)), done(aDone) { }
+
+			string from;
+			string to;
+
+			// only the roots are collected from finished ranges
+			bool done;
+			vector<TTHValue> roots;
+		};
+		typedef vector<MaintenanceShard> MaintenanceShardList;
+
+		static MaintenanceShardList createShards(DbHandler& aDb, bool aDone) throw(DbException);
+		void onShardDone(MaintenanceShard& aShard, MaintenancePhase aPhase, bool aVerify, const MaintenanceShardList& aShards) noexcept;
+		void saveMaintenance(MaintenancePhase aPhase, bool aVerify, const MaintenanceShardList& aShards) noexcept;
+		bool loadMaintenance(MaintenancePhase& phase_, bool& verify_, MaintenanceShardList& shards_) noexcept;
+
+		CriticalSection maintenanceCS;
 	};
 
 	friend class HashLoader;
 
 	bool hashFile(const string& filePath, const string& pathLower, int64_t size);
-	bool aShutdown = false;
+	// read by the maintenance threads
+	atomic<bool> aShutdown { false };
 
 	typedef vector<Hasher*> HasherList;
 	HasherList hashers;
@@ -29,7 +29,7 @@ const string HubSettings::boolNames[BoolCount] = {
 	"ShowJoins", "FavShowJoins", "LogMainChat", "ShowChatNotify", "AcceptFailovers"
 };
 const string HubSettings::intNames[IntCount] = {
-	"MinSearchInterval", "IncomingConnections", "IncomingConnections6"
+	"MinSearchInterval", "IncomingConnections", "IncomingConnections6", "UploadLimit", "DownloadLimit"
 };
 
 namespace {
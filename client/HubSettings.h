@@ -66,6 +66,8 @@ struct HubSettings
 		SearchInterval = HubIntFirst,
 		Connection,
 		Connection6,
+		UploadLimit,
+		DownloadLimit,
 		// don't forget to edit intNames in HubSettings.cpp when adding a def here!
 
 		HubIntLast
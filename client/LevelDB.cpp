@@ -23,6 +23,7 @@
 #include "LogManager.h"
 #include "ResourceManager.h"
 #include "Thread.h"
+#include "TimerManager.h"
 #include "Util.h"
 #include "version.h"
 
@@ -123,8 +124,15 @@ void LevelDB::repair(StepFunction stepF, MessageFunction messageF) throw(DbExcep
 }
 
 LevelDB::~LevelDB() {
-	if (db)
+	if (db) {
+		try {
+			flush();
+		} catch (const DbException&) {
+			// the owner should have flushed the writes before (and reported the errors)
+		}
+
 		delete db;
+	}
 #ifdef HAVE_LEVELDB_BLOOM
 	delete options.filter_policy;
 #endif
@@ -138,13 +146,104 @@ void LevelDB::put(void* aKey, size_t keyLen, void* aValue, size_t valueLen, DbSn
 	leveldb::Slice key((const char*)aKey, keyLen);
 	leveldb::Slice value((const char*)aValue, valueLen);
 
+	if (maxBatchBytes > 0) {
+		Lock l(batchCS);
+		string k((const char*)aKey, keyLen);
+		pendingRemovals.erase(k);
+		pendingPuts[k].assign((const char*)aValue, valueLen);
+		batch.Put(key, value);
+		addBatched(keyLen + valueLen);
+		return;
+	}
+
 	// leveldb will replace existing values
+	auto start = GET_TICK();
 	DBACTION(db->Put(writeoptions, key, value));
+	commitTime += GET_TICK() - start;
+	totalCommits++;
+	committedWrites++;
+}
+
+bool LevelDB::getPending(const string& aKey, bool& found_, string& value_) {
+	Lock l(batchCS);
+	if (pendingRemovals.find(aKey) != pendingRemovals.end()) {
+		found_ = false;
+		return true;
+	}
+
+	auto p = pendingPuts.find(aKey);
+	if (p == pendingPuts.end())
+		return false;
+
+	found_ = true;
+	value_ = p->second;
+	return true;
+}
+
+bool LevelDB::hasPendingPrefix(const string& aPrefix) {
+	Lock l(batchCS);
+	auto hasPrefix = [&aPrefix](const string& aKey) { return aKey.compare(0, aPrefix.size(), aPrefix) == 0; };
+	return any_of(pendingPuts.begin(), pendingPuts.end(), [&](const pair<const string, string>& p) { return hasPrefix(p.first); }) ||
+		any_of(pendingRemovals.begin(), pendingRemovals.end(), hasPrefix);
+}
+
+void LevelDB::addBatched(size_t aBytes) throw(DbException) {
+	batchWrites++;
+	batchBytes += aBytes;
+
+	auto tick = GET_TICK();
+	if (batchStarted == 0)
+		batchStarted = tick;
+
+	if (batchBytes >= maxBatchBytes || tick - batchStarted >= maxBatchDelay) {
+		commitBatch();
+	}
+}
+
+void LevelDB::commitBatch() throw(DbException) {
+	if (batchStarted == 0)
+		return;
+
+	// the database that our entries refer to must be committed first
+	if (flushFirst)
+		flushFirst->flush();
+
+	auto start = GET_TICK();
+	DBACTION(db->Write(writeoptions, &batch));
+	commitTime += GET_TICK() - start;
+	totalCommits++;
+	committedWrites += batchWrites;
+
+	batch.Clear();
+	pendingPuts.clear();
+	pendingRemovals.clear();
+	batchBytes = 0;
+	batchWrites = 0;
+	batchStarted = 0;
+}
+
+void LevelDB::setGroupCommit(size_t aMaxBytes, uint64_t aMaxDelay, DbHandler* aFlushFirst) noexcept {
+	Lock l(batchCS);
+	maxBatchBytes = aMaxBytes;
+	maxBatchDelay = aMaxDelay;
+	flushFirst = aFlushFirst;
+}
+
+void LevelDB::flush() throw(DbException) {
+	Lock l(batchCS);
+	commitBatch();
 }
 
 bool LevelDB::get(void* aKey, size_t keyLen, size_t /*initialValueLen*/, std::function<bool(void* aValue, size_t aValueLen)> loadF, DbSnapshot* /*aSnapshot*/ /*nullptr*/) throw(DbException) {
 	totalReads++;
 	string value;
+	if (maxBatchBytes > 0) {
+		bool found;
+		if (getPending(string((const char*)aKey, keyLen), found, value)) {
+			return found && loadF((void*)value.data(), value.size());
+		}
+	}
+
 	leveldb::Slice key((const char*)aKey, keyLen);
 	auto ret = DBACTION(db->Get(readoptions, key, &value));
 	if (ret.ok()) {
@@ -155,6 +254,8 @@ bool LevelDB::get(void* aKey, size_t keyLen, size_t /*initialValueLen*/, std::fu
 }
 
 string LevelDB::getStats() throw(DbException) {
+	flush();
+
 	string ret;
 	string value = "leveldb.stats";
 	leveldb::Slice prop(value.c_str(), value.length());
@@ -164,6 +265,11 @@ string LevelDB::getStats() throw(DbException) {
 	ret += "\r\n\r\nTotal entries: " + Util::toString(size(true, nullptr));
 	ret += "\r\nTotal reads: " + Util::toString(totalReads);
 	ret += "\r\nTotal Writes: " + Util::toString(totalWrites);
+	if (totalCommits > 0) {
+		ret += "\r\nTotal commits: " + Util::toString(totalCommits) + " (" + Util::toString((double)committedWrites / (double)totalCommits) + " writes per commit)";
+		ret += "\r\nAverage commit time: " + Util::toString((double)commitTime / (double)totalCommits) + " ms (" + 
+			Util::toString(commitTime > 0 ? committedWrites * 1000 / commitTime : committedWrites) + " writes/s)";
+	}
 	ret += "\r\nI/O errors: " + Util::toString(ioErrors);
 	ret += "\r\nCurrent block size: " + Util::formatBytes(options.block_size);
 	ret += "\r\nCurrent size on disk: " + Util::formatBytes(getSizeOnDisk());
@@ -173,6 +279,13 @@ string LevelDB::getStats() throw(DbException) {
 
 bool LevelDB::hasKey(void* aKey, size_t keyLen, DbSnapshot* /*aSnapshot*/ /*nullptr*/) throw(DbException) {
 	string value;
+	if (maxBatchBytes > 0) {
+		bool found;
+		if (getPending(string((const char*)aKey, keyLen), found, value)) {
+			return found;
+		}
+	}
+
 	leveldb::Slice key((const char*)aKey, keyLen);
 	auto ret = db->Get(iteroptions, key, &value);
 	return ret.ok();
@@ -180,7 +293,21 @@ bool LevelDB::hasKey(void* aKey, size_t keyLen, DbSnapshot* /*aSnapshot*/ /*null
 
 void LevelDB::remove(void* aKey, size_t keyLen, DbSnapshot* /*aSnapshot*/ /*nullptr*/) throw(DbException) {
 	leveldb::Slice key((const char*)aKey, keyLen);
+	if (maxBatchBytes > 0) {
+		Lock l(batchCS);
+		string k((const char*)aKey, keyLen);
+		pendingPuts.erase(k);
+		pendingRemovals.insert(k);
+		batch.Delete(key);
+		addBatched(keyLen);
+		return;
+	}
+
+	auto start = GET_TICK();
 	DBACTION(db->Delete(writeoptions, key));
+	commitTime += GET_TICK() - start;
+	totalCommits++;
+	committedWrites++;
 }
 
 int64_t LevelDB::getSizeOnDisk() throw(DbException) {
@@ -192,6 +319,8 @@ size_t LevelDB::size(bool thorough, DbSnapshot* aSnapshot /*nullptr*/) throw(DbE
 		return lastSize;
 
 	// leveldb doesn't support any easy way to do this
+	flush();
+
 	size_t ret = 0;
 	leveldb::ReadOptions options;
 	options.fill_cache = false;
@@ -209,10 +338,18 @@ size_t LevelDB::size(bool thorough, DbSnapshot* aSnapshot /*nullptr*/) throw(DbE
 }
 
 DbSnapshot* LevelDB::getSnapshot() {
+	flush();
 	return new LevelSnapshot(db);
 }
 
 void LevelDB::remove_if(std::function<bool(void* aKey, size_t key_len, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException) {
+	atomic<bool> stop { false };
+	remove_if(f, Util::emptyString, Util::emptyString, stop, aSnapshot);
+}
+
+void LevelDB::remove_if(std::function<bool(void* aKey, size_t key_len, void* aValue, size_t valueLen)> f, const string& aFrom, const string& aTo, const atomic<bool>& aStop, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException) {
+	flush();
+
 	leveldb::WriteBatch wb;
 	leveldb::ReadOptions options;
 	options.fill_cache = false;
@@ -221,9 +358,12 @@ void LevelDB::remove_if(std::function<bool(void* aKey, size_t key_len, void* aVa
 		options.snapshot = static_cast<LevelSnapshot*>(aSnapshot)->snapshot;
 
 	{
+		leveldb::Slice to(aTo);
 		auto it = unique_ptr<leveldb::Iterator>(db->NewIterator(options));
-		for (it->SeekToFirst(); it->Valid(); it->Next()) {
+		for (it->Seek(aFrom); it->Valid() && !aStop; it->Next()) {
 			checkDbError(it->status());
+			if (!aTo.empty() && it->key().compare(to) >= 0)
+				break;
 
 			if (f((void*)it->key().data(), it->key().size(), (void*)it->value().data(), it->value().size())) {
 				wb.Delete(it->key());
@@ -234,11 +374,132 @@ void LevelDB::remove_if(std::function<bool(void* aKey, size_t key_len, void* aVa
 	DBACTION(db->Write(writeoptions, &wb));
 }
 
+void LevelDB::forEachChild(void* aPrefix, size_t prefixLen, char aSeparator, std::function<void(void* aKey, size_t keyLen, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException) {
+	totalReads++;
+
+	// the writes made after taking the snapshot aren't visible anyway
+	if (!aSnapshot && maxBatchBytes > 0 && hasPendingPrefix(string((const char*)aPrefix, prefixLen)))
+		flush();
+
+	// keep the block cache for point lookups
+	leveldb::ReadOptions options;
+	options.fill_cache = false;
+	if (aSnapshot)
+		options.snapshot = static_cast<LevelSnapshot*>(aSnapshot)->snapshot;
+
+	leveldb::Slice prefix((const char*)aPrefix, prefixLen);
+	string skipKey;
+
+	auto it = unique_ptr<leveldb::Iterator>(db->NewIterator(options));
+	for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);) {
+		checkDbError(it->status());
+
+		auto key = it->key();
+		auto sep = memchr(key.data() + prefixLen, aSeparator, key.size() - prefixLen);
+		if (sep) {
+			// seek past everything under this child
+			skipKey.assign(key.data(), (const char*)sep - key.data());
+			skipKey += (char)(aSeparator + 1);
+			it->Seek(skipKey);
+			continue;
+		}
+
+		f((void*)key.data(), key.size(), (void*)it->value().data(), it->value().size());
+		it->Next();
+	}
+
+	checkDbError(it->status());
+}
+
+StringList LevelDB::getSplitKeys(size_t aCount) throw(DbException) {
+	StringList ret;
+	if (aCount < 2)
+		return ret;
+
+	string first, last;
+	{
+		auto it = unique_ptr<leveldb::Iterator>(db->NewIterator(iteroptions));
+		it->SeekToFirst();
+		if (!it->Valid())
+			return ret;
+
+		first = it->key().ToString();
+		it->SeekToLast();
+		last = it->key().ToString();
+		checkDbError(it->status());
+	}
+
+	// interpolate the keys numerically from the bytes that follow the common prefix
+	size_t prefixLen = 0;
+	while (prefixLen < first.size() && prefixLen < last.size() && first[prefixLen] == last[prefixLen])
+		prefixLen++;
+
+	auto toNumber = [&](const string& aKey) {
+		uint64_t n = 0;
+		for (size_t i = prefixLen; i < prefixLen + sizeof(uint64_t); ++i)
+			n = (n << 8) | (i < aKey.size() ? static_cast<uint8_t>(aKey[i]) : 0);
+		return n;
+	};
+
+	auto toKey = [&](uint64_t n) {
+		auto key = first.substr(0, prefixLen);
+		for (int i = sizeof(uint64_t) - 1; i >= 0; --i)
+			key += static_cast<char>((n >> (i * 8)) & 0xFF);
+		return key;
+	};
+
+	auto sizeUntil = [&](uint64_t n) {
+		auto key = toKey(n);
+		leveldb::Range range(first, key);
+		uint64_t size = 0;
+		db->GetApproximateSizes(&range, 1, &size);
+		return size;
+	};
+
+	auto low = toNumber(first), high = toNumber(last);
+	if (low >= high)
+		return ret;
+
+	auto total = sizeUntil(high);
+	for (size_t i = 1; i < aCount; ++i) {
+		uint64_t split;
+		if (total == 0) {
+			// everything is still in the memory table, split evenly
+			split = low + (high - low) / aCount * i;
+		} else {
+			// the first key with the wanted amount of data before it
+			uint64_t target = total / aCount * i;
+			auto lo = ret.empty() ? low : toNumber(ret.back()), hi = high;
+			while (lo < hi) {
+				auto mid = lo + (hi - lo) / 2;
+				if (sizeUntil(mid) < target) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			split = lo;
+		}
+
+		auto key = toKey(split);
+		if (key > first && key <= last && (ret.empty() || key > ret.back()))
+			ret.push_back(move(key));
+	}
+
+	return ret;
+}
+
 // free up some space, https://code.google.com/p/leveldb/issues/detail?id=158
 // LevelDB will perform some kind of compaction on every startup but it's not as comprehensive as manual one
 // The issue has been "fixed" in version 1.13 but it still won't match the manual one (possibly because only ranges that are iterated
 // through are compacted but there won't be that many reads to those ranges, not in the file index at least)
 void LevelDB::compact() {
+	try {
+		flush();
+	} catch (const DbException&) {
+		// the writes remain pending
+	}
+
 	db->CompactRange(nullptr, nullptr);
 }
 
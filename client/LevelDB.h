@@ -21,11 +21,13 @@
 #define DCPLUSPLUS_DCPP_LEVELDB_H_
 
 #include "DbHandler.h"
+#include "CriticalSection.h"
 
 #include <leveldb/status.h>
 #include <leveldb/db.h>
 #include <leveldb/env.h>
 #include <leveldb/options.h>
+#include <leveldb/write_batch.h>
 
 namespace dcpp {
 
@@ -47,7 +49,14 @@ public:
 	int64_t getSizeOnDisk() throw(DbException);
 
 	void remove_if(std::function<bool(void* aKey, size_t key_len, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException);
+	void remove_if(std::function<bool(void* aKey, size_t key_len, void* aValue, size_t valueLen)> f, const string& aFrom, const string& aTo, const atomic<bool>& aStop, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException);
+	StringList getSplitKeys(size_t aCount) throw(DbException);
+	void forEachChild(void* aPrefix, size_t prefixLen, char aSeparator, std::function<void(void* aKey, size_t keyLen, void* aValue, size_t valueLen)> f, DbSnapshot* aSnapshot /*nullptr*/) throw(DbException);
 	void compact();
+
+	void setGroupCommit(size_t aMaxBytes, uint64_t aMaxDelay, DbHandler* aFlushFirst /*nullptr*/) noexcept;
+	void flush() throw(DbException);
+
 	void repair(StepFunction stepF, MessageFunction messageF) throw(DbException);
 	void open(StepFunction stepF, MessageFunction messageF) throw(DbException);
 private:
@@ -69,6 +78,12 @@ private:
 	leveldb::Status performDbOperation(function<leveldb::Status()> f) throw(DbException);
 	void checkDbError(leveldb::Status aStatus) throw(DbException);
 
+	// returns true and sets found_ if the key has a pending write
+	bool getPending(const string& aKey, bool& found_, string& value_);
+	bool hasPendingPrefix(const string& aPrefix);
+	void addBatched(size_t aBytes) throw(DbException);
+	void commitBatch() throw(DbException);
+
 	leveldb::DB* db;
 
 	//DB options
@@ -87,6 +102,23 @@ private:
 	uint64_t totalWrites;
 	uint64_t ioErrors;
 	size_t lastSize;
+
+	// group commit, the pending values are kept for the reads
+	CriticalSection batchCS;
+	leveldb::WriteBatch batch;
+	unordered_map<string, string> pendingPuts;
+	StringSet pendingRemovals;
+	size_t batchBytes = 0;
+	size_t batchWrites = 0;
+	uint64_t batchStarted = 0;
+
+	size_t maxBatchBytes = 0;
+	uint64_t maxBatchDelay = 0;
+	DbHandler* flushFirst = nullptr;
+
+	uint64_t totalCommits = 0;
+	uint64_t committedWrites = 0;
+	uint64_t commitTime = 0;
 };
 
 } //dcpp
@@ -104,18 +104,32 @@ public:
 		// Skip empty data sets if we already added at least one of them...
 		if(len == 0 && !(leaves.empty() && blocks.empty()))
 			return;
+
+		// Hash full leaves in groups
+		const uint8_t* laneData[Hasher::LANES];
+		uint8_t hashes[Hasher::LANES * Hasher::BYTES];
+		while(len - i >= Hasher::LANES * baseBlockSize) {
+			for(size_t l = 0; l < Hasher::LANES; ++l)
+				laneData[l] = buf + i + l * baseBlockSize;
+
+			Hasher::hashLanes(zero, laneData, baseBlockSize, hashes);
+			for(size_t l = 0; l < Hasher::LANES; ++l)
+				addLeaf(MerkleValue(hashes + l * Hasher::BYTES));
+
+			i += Hasher::LANES * baseBlockSize;
+		}
+
+		if(i == len && len > 0) {
+			fileSize += len;
+			return;
+		}
 		
 		do {
 			size_t n = min(baseBlockSize, len-i);
 			Hasher h;
 			h.update(&zero, 1);
 			h.update(buf + i, n);
-			if((int64_t)baseBlockSize < blockSize) {
-				blocks.emplace_back(MerkleValue(h.finalize()), baseBlockSize);
-				reduceBlocks();
-			} else {
-				leaves.emplace_back(h.finalize());
-			}
+			addLeaf(MerkleValue(h.finalize()));
 			i += n;
 		} while(i < len);
 		fileSize += len;
@@ -205,6 +219,15 @@ private:
 		return MerkleValue(h.finalize());
 	}
 
+	void addLeaf(const MerkleValue& aHash) {
+		if((int64_t)baseBlockSize < blockSize) {
+			blocks.emplace_back(aHash, baseBlockSize);
+			reduceBlocks();
+		} else {
+			leaves.push_back(aHash);
+		}
+	}
+
 	void reduceBlocks() {
 		while(blocks.size() > 1) {
 			MerkleBlock& a = blocks[blocks.size()-2];
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_NGRAM_INDEX_H
+#define DCPLUSPLUS_DCPP_NGRAM_INDEX_H
+
+#include "typedefs.h"
+
+namespace dcpp {
+
+/**
+* Inverted index that maps each N-gram of the added strings to the items containing it.
+*
+* The index is meant for finding candidates before the actual matching so it may return
+* extra items. Removed items are only filtered from the results until the posting lists are
+* compacted, which makes removing large trees cheap.
+*/
+template<size_t N, class T>
+class NgramIndex {
+public:
+	typedef vector<T> List;
+	typedef unordered_set<T> Set;
+
+	NgramIndex() { static_assert(N > 0 && N <= sizeof(uint32_t), "N-grams must fit in 32 bits"); }
+	~NgramIndex() { }
+
+	void add(const string& s, const T& aItem) noexcept {
+		if (!removed.empty())
+			removed.erase(aItem);
+
+		forEachGram(s, [&](uint32_t aGram) {
+			auto& l = postings[aGram];
+			if (l.empty() || l.back() != aItem) {
+				l.push_back(aItem);
+				entries++;
+			}
+		});
+	}
+
+	void remove(const T& aItem) noexcept {
+		removed.insert(aItem);
+		if (removed.size() >= COMPACT_MIN && removed.size() * COMPACT_RATIO >= entries) {
+			compact();
+		}
+	}
+
+	/* Returns false if the string is too short to be looked up from the index */
+	bool getCandidates(const string& s, Set& ret) const noexcept {
+		if (s.length() < N)
+			return false;
+
+		vector<const List*> lists;
+		bool missing = false;
+		forEachGram(s, [&](uint32_t aGram) {
+			auto p = postings.find(aGram);
+			if (p == postings.end()) {
+				missing = true;
+			} else {
+				lists.push_back(&p->second);
+			}
+		});
+
+		if (missing)
+			return true;
+
+		// start from the shortest list to keep the intermediate sets small
+		sort(lists.begin(), lists.end(), [](const List* a, const List* b) { return a->size() < b->size(); });
+		lists.erase(unique(lists.begin(), lists.end()), lists.end());
+
+		for (const auto& i: *lists.front()) {
+			if (removed.empty() || removed.find(i) == removed.end())
+				ret.insert(i);
+		}
+
+		for (auto l = lists.begin() + 1; l != lists.end() && !ret.empty(); ++l) {
+			Set matches;
+			for (const auto& i: **l) {
+				if (ret.find(i) != ret.end())
+					matches.insert(i);
+			}
+			ret.swap(matches);
+		}
+
+		return true;
+	}
+
+	void merge(NgramIndex<N, T>& aIndex) noexcept {
+		for (auto& p: aIndex.postings) {
+			if (!removed.empty()) {
+				for (const auto& i: p.second)
+					removed.erase(i);
+			}
+
+			auto& l = postings[p.first];
+			l.insert(l.end(), p.second.begin(), p.second.end());
+		}
+
+		entries += aIndex.entries;
+		aIndex.clear();
+	}
+
+	void compact() noexcept {
+		if (removed.empty())
+			return;
+
+		entries = 0;
+		for (auto i = postings.begin(); i != postings.end();) {
+			auto& l = i->second;
+			l.erase(remove_if(l.begin(), l.end(), [this](const T& aItem) { return removed.find(aItem) != removed.end(); }), l.end());
+			if (l.empty()) {
+				i = postings.erase(i);
+			} else {
+				entries += l.size();
+				++i;
+			}
+		}
+
+		removed.clear();
+	}
+
+	void clear() noexcept {
+		postings.clear();
+		removed.clear();
+		entries = 0;
+	}
+
+	size_t getGramCount() const noexcept { return postings.size(); }
+	size_t getEntryCount() const noexcept { return entries; }
+	size_t getRemovedCount() const noexcept { return removed.size(); }
+	size_t getMemoryUsage() const noexcept {
+		size_t ret = 0;
+		for (const auto& l: postings | map_values)
+			ret += sizeof(uint32_t) + sizeof(List) + l.capacity() * sizeof(T);
+		return ret + removed.size() * sizeof(T);
+	}
+private:
+	enum {
+		COMPACT_MIN = 1024,
+		COMPACT_RATIO = 32
+	};
+
+	template<class F>
+	static void forEachGram(const string& s, F aF) noexcept {
+		const uint32_t mask = static_cast<uint32_t>((1ULL << (8 * N)) - 1);
+
+		uint32_t gram = 0;
+		for (size_t i = 0; i < s.length(); ++i) {
+			gram = ((gram << 8) | static_cast<uint8_t>(s[i])) & mask;
+			if (i + 1 >= N) {
+				aF(gram);
+			}
+		}
+	}
+
+	unordered_map<uint32_t, List> postings;
+	Set removed;
+	size_t entries = 0;
+};
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_DCPP_NGRAM_INDEX_H)
@@ -1376,6 +1376,9 @@ void QueueManager::hashBundle(BundlePtr& aBundle) noexcept {
 					//...
 				}
 			}
+
+			if (SETTING(FINISHED_NO_HASH))
+				HashManager::getInstance()->flush();
 		}
 
 		if (hashSize > 0) {
@@ -168,6 +168,10 @@ const string& SearchManager::getPort() const {
 	return udpServer.getPort(); 
 }
 
+string SearchManager::getUdpStats() const noexcept {
+	return udpServer.getStats() + "\r\nSent packets: " + Util::toString(ClientManager::getInstance()->getSentUdpPackets()) + "\r\n";
+}
+
 void SearchManager::listen() {
 	udpServer.listen();
 }
@@ -541,11 +545,17 @@ void SearchManager::respond(const AdcCommand& adc, OnlineUser& aUser, bool isUdp
 
 
 	adc.getParam("KY", 0, key);
-	for(const auto& sr: results) {
-		AdcCommand cmd = sr->toRES(AdcCommand::TYPE_UDP);
-		if(!token.empty())
-			cmd.addParam("TO", token);
-		ClientManager::getInstance()->sendUDP(cmd, aUser.getUser()->getCID(), false, false, key, aUser.getHubUrl());
+	{
+		vector<AdcCommand> cmds;
+		cmds.reserve(results.size());
+		for(const auto& sr: results) {
+			AdcCommand cmd = sr->toRES(AdcCommand::TYPE_UDP);
+			if(!token.empty())
+				cmd.addParam("TO", token);
+			cmds.push_back(move(cmd));
+		}
+
+		ClientManager::getInstance()->sendUDP(cmds, aUser.getUser()->getCID(), false, false, key, aUser.getHubUrl());
 	}
 
 end:
@@ -87,6 +87,7 @@ public:
 	void respond(const AdcCommand& cmd, OnlineUser& aUser, bool isUdpActive, const string& hubIpPort, ProfileToken aProfile);
 
 	const string& getPort() const;
+	string getUdpStats() const noexcept;
 
 	void listen();
 	void disconnect() noexcept;
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "stdinc.h"
+#include "SearchResultCache.h"
+
+#include "SearchQuery.h"
+#include "SearchResult.h"
+
+namespace dcpp {
+
+namespace {
+
+void appendPatterns(string& key_, const StringSearch& aSearch, bool aSort) {
+	StringList patterns;
+	for (const auto& p: aSearch.getPatterns())
+		patterns.push_back(p.str());
+
+	// the order of the include patterns affects the relevancy of the results
+	if (aSort)
+		sort(patterns.begin(), patterns.end());
+
+	for (const auto& p: patterns) {
+		key_ += p;
+		key_ += '\0';
+	}
+	key_ += '\n';
+}
+
+void appendExtensions(string& key_, StringList aExtensions) {
+	sort(aExtensions.begin(), aExtensions.end());
+	for (const auto& e: aExtensions) {
+		key_ += e;
+		key_ += '\0';
+	}
+	key_ += '\n';
+}
+
+}
+
+SearchResultCache::Item::Item(const SearchResultPtr& aResult) noexcept : path(aResult->getPath()), tth(aResult->getTTH()), size(aResult->getSize()), 
+	date(aResult->getDate()), files(aResult->getFileCount()), folders(aResult->getFolderCount()), type(aResult->getType()), parentOnly(!aResult->getUser().user) {
+
+}
+
+SearchResultPtr SearchResultCache::Item::toResult() const noexcept {
+	if (parentOnly)
+		return SearchResultPtr(new SearchResult(path));
+
+	// the slot counts are read when the result is created
+	return SearchResultPtr(new SearchResult(static_cast<SearchResult::Types>(type), size, path, tth, date, files, folders));
+}
+
+string SearchResultCache::getKey(const SearchQuery& aSearch, ProfileToken aProfile, const string& aDir) noexcept {
+	string key = Util::toString(aProfile) + '\n' + aDir + '\n';
+	key += Util::toString(aSearch.matchType) + ':' + Util::toString(aSearch.itemType) + ':' + Util::toString(aSearch.addParents) + ':' + Util::toString(aSearch.maxResults) + '\n';
+	key += Util::toString(aSearch.gt) + ':' + Util::toString(aSearch.lt) + ':' + Util::toString(aSearch.minDate) + ':' + Util::toString(aSearch.maxDate) + '\n';
+
+	appendPatterns(key, aSearch.include, false);
+	appendPatterns(key, aSearch.exclude, true);
+	appendExtensions(key, aSearch.ext);
+	appendExtensions(key, aSearch.noExt);
+	return key;
+}
+
+bool SearchResultCache::get(const string& aKey, SearchResultList& results_) noexcept {
+	Lock l(cs);
+	auto i = entries.find(aKey);
+	if (i == entries.end() || i->second.generation != generation) {
+		misses++;
+		return false;
+	}
+
+	lru.splice(lru.begin(), lru, i->second.lruPos);
+	for (const auto& item: i->second.items)
+		results_.push_back(item.toResult());
+	hits++;
+	return true;
+}
+
+void SearchResultCache::add(const string& aKey, const SearchResultList& aResults) noexcept {
+	ItemList items;
+	items.reserve(aResults.size());
+	for (const auto& sr: aResults)
+		items.emplace_back(sr);
+
+	Lock l(cs);
+	auto i = entries.find(aKey);
+	if (i != entries.end()) {
+		i->second.items = move(items);
+		i->second.generation = generation;
+		lru.splice(lru.begin(), lru, i->second.lruPos);
+		return;
+	}
+
+	while (entries.size() >= MAX_ENTRIES) {
+		entries.erase(lru.back());
+		lru.pop_back();
+	}
+
+	lru.push_front(aKey);
+	entries.emplace(aKey, Entry { move(items), generation, lru.begin() });
+}
+
+size_t SearchResultCache::getEntryCount() const noexcept {
+	Lock l(cs);
+	return entries.size();
+}
+
+} // namespace dcpp
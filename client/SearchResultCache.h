@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef DCPLUSPLUS_DCPP_SEARCH_RESULT_CACHE_H
+#define DCPLUSPLUS_DCPP_SEARCH_RESULT_CACHE_H
+
+#include <atomic>
+#include <list>
+
+#include "typedefs.h"
+#include "forward.h"
+
+#include "CriticalSection.h"
+#include "MerkleTree.h"
+
+namespace dcpp {
+
+class SearchQuery;
+
+/**
+* Bounded cache for the results of incoming recursive searches.
+*
+* The entries are keyed by a normalized form of the query and they are only valid for the share
+* generation that they were created in. The generation is bumped whenever the share tree or the
+* profiles change so stale entries are never returned and they will be dropped from the end of the
+* LRU list eventually.
+*
+* Only the matched items are stored, new results are created for each hit so that the slot counts
+* are always current.
+*/
+class SearchResultCache {
+public:
+	enum { MAX_ENTRIES = 256 };
+
+	SearchResultCache() { }
+
+	static string getKey(const SearchQuery& aSearch, ProfileToken aProfile, const string& aDir) noexcept;
+
+	/* Returns false if there is no valid entry for the key */
+	bool get(const string& aKey, SearchResultList& results_) noexcept;
+	void add(const string& aKey, const SearchResultList& aResults) noexcept;
+
+	/* Invalidates all existing entries */
+	void invalidate() noexcept { generation++; }
+
+	uint64_t getHits() const noexcept { return hits; }
+	uint64_t getMisses() const noexcept { return misses; }
+	size_t getEntryCount() const noexcept;
+private:
+	/* The shared item that was matched by the search */
+	struct Item {
+		explicit Item(const SearchResultPtr& aResult) noexcept;
+		SearchResultPtr toResult() const noexcept;
+
+		string path;
+		TTHValue tth;
+		int64_t size;
+		time_t date;
+		int files;
+		int folders;
+		uint8_t type;
+
+		/* Parent directory results are sent without size or slot information */
+		bool parentOnly;
+	};
+
+	typedef vector<Item> ItemList;
+
+	struct Entry {
+		ItemList items;
+		uint64_t generation;
+		std::list<string>::iterator lruPos;
+	};
+
+	mutable CriticalSection cs;
+
+	unordered_map<string, Entry> entries;
+	/** Most recently used keys first */
+	std::list<string> lru;
+
+	atomic<uint64_t> generation { 0 };
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_DCPP_SEARCH_RESULT_CACHE_H)
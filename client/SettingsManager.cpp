@@ -171,7 +171,7 @@ const string SettingsManager::settingTags[] =
 	"QueueSplitterPosition", "FullListDLLimit", "ASDelayHours", "LastListProfile", "MaxHashingThreads", "HashersPerVolume", "SubtractlistSkip", "BloomMode", "FavUsersSplitterPos", "AwayIdleTime",
 	"SearchHistoryMax", "ExcludeHistoryMax", "DirectoryHistoryMax", "MinDupeCheckSize", "DbCacheSize", "DLAutoDisconnectMode", "RemovedTrees", "RemovedFiles", "MultithreadedRefresh", "MonitoringMode",
 	"MonitoringDelay", "DelayCountMode", "MaxRunningBundles", "DefaultShareProfile", "UpdateChannel", "ColorStatusFinished", "ColorStatusShared", "ProgressLighten",
-	"ConfigBuildNumber",
+	"UploadCacheSize", "MaxUploadSpeedUser", "MaxDownloadSpeedUser", "RefreshThreadsPerVolume", "ConfigBuildNumber",
 	"SENTRY",
 
 	// Bools
@@ -221,6 +221,7 @@ const string SettingsManager::settingTags[] =
 	"AcceptFailoversFavs", "RemoveExpiredAs", "AdcLogGroupCID", "ShareFollowSymlinks", "ScanMonitoredFolders", "FinishedNoHash", "ConfirmFileDeletions", "UseDefaultCertPaths", "StartupRefresh", "DctmpStoreDestination", "FLReportDupeFiles",
 	"FilterFLShared", "FilterFLQueued", "FilterFLInversed", "FilterFLTop", "FilterFLPartialDupes", "FilterFLResetChange", "FilterSearchShared", "FilterSearchQueued", "FilterSearchInversed", "FilterSearchTop", "FilterSearchPartialDupes", "FilterSearchResetChange",
 	"SearchAschOnlyMan", "IgnoreIndirectSR", "UseUploadBundles", "CloseMinimize", "LogIgnored", "UsersFilterIgnore", "NfoExternal", "SingleClickTray", "QueueShowFinished", "RemoveFinishedBundles",
+	"ShareSearchIndex", "ShareSearchParallel", "HashDirectRead",
 	"SENTRY",
 	// Int64
 	"TotalUpload", "TotalDownload",
@@ -246,6 +247,8 @@ SettingsManager::SettingsManager()
 	}
 
 	setDefault(MAX_UPLOAD_SPEED_MAIN, 0);
+	setDefault(MAX_UPLOAD_SPEED_USER, 0);
+	setDefault(MAX_DOWNLOAD_SPEED_USER, 0);
 	setDefault(MAX_DOWNLOAD_SPEED_MAIN, 0);
 	setDefault(TIME_DEPENDENT_THROTTLE, false);
 	setDefault(MAX_DOWNLOAD_SPEED_ALTERNATE, 0);
@@ -810,17 +813,22 @@ SettingsManager::SettingsManager()
 	setDefault(ACCEPT_FAILOVERS, true);
 
 	setDefault(DB_CACHE_SIZE, 8);
+	setDefault(UPLOAD_CACHE_SIZE, 64);
 	setDefault(CUR_REMOVED_TREES, 0);
 	setDefault(CUR_REMOVED_FILES, 0);
 
 	setDefault(DL_AUTO_DISCONNECT_MODE, QUEUE_FILE);
 	setDefault(REFRESH_THREADING, MULTITHREAD_MANUAL);
+	setDefault(REFRESH_THREADS_PER_VOLUME, 4);
 
 	setDefault(REMOVE_EXPIRED_AS, false);
 
 	setDefault(PM_LOG_GROUP_CID, true);
 	setDefault(SHARE_FOLLOW_SYMLINKS, true);
 	setDefault(SCAN_MONITORED_FOLDERS, true);
+	setDefault(SHARE_SEARCH_INDEX, false);
+	setDefault(SHARE_SEARCH_PARALLEL, false);
+	setDefault(HASH_DIRECT_READ, true);
 
 #ifdef _WIN32
 	setDefault(MONITORING_MODE, MONITORING_ALL);
@@ -1241,6 +1249,8 @@ HubSettings SettingsManager::getHubSettings() const {
 	ret.get(HubSettings::AwayMsg) = get(DEFAULT_AWAY_MESSAGE);
 	ret.get(HubSettings::AcceptFailovers) = get(ACCEPT_FAILOVERS);
 	ret.get(HubSettings::NmdcEncoding) = get(NMDC_ENCODING);
+	ret.get(HubSettings::UploadLimit) = 0;
+	ret.get(HubSettings::DownloadLimit) = 0;
 	return ret;
 }
 
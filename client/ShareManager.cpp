@@ -23,6 +23,7 @@
 #include "BZUtils.h"
 #include "ClientManager.h"
 #include "File.h"
+#include "FileReader.h"
 #include "FilteredFile.h"
 #include "LogManager.h"
 #include "HashManager.h"
@@ -37,6 +38,7 @@
 #include "UserConnection.h"
 
 #include "version.h"
+#include "ZUtils.h"
 
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/algorithm/copy.hpp>
@@ -74,7 +76,7 @@ ShareDirInfo::ShareDirInfo(const ShareDirInfoPtr& aInfo, ProfileToken aNewProfil
 ShareDirInfo::ShareDirInfo(const string& aVname, ProfileToken aProfile, const string& aPath, bool aIncoming /*false*/, State aState /*STATE_NORMAL*/) : vname(aVname), profile(aProfile), path(aPath), incoming(aIncoming),
 	found(false), diffState(DIFF_NORMAL), state(aState), size(0) {}
 
-ShareManager::ShareManager() : bloom(new ShareBloom(1 << 20)), monitor(1, false)
+ShareManager::ShareManager() : bloom(new ShareBloom(1 << 22)), monitor(1, false)
 { 
 	SettingsManager::getInstance()->addListener(this);
 	QueueManager::getInstance()->addListener(this);
@@ -177,24 +179,42 @@ void ShareManager::removeMonitoring(const StringList& aPaths) noexcept {
 }
 
 optional<pair<string, bool>> ShareManager::checkModifiedPath(const string& aPath) const noexcept {
-	// TODO: FIX LINUX
+#ifdef _WIN32
 	FileFindIter f(aPath);
-	if (f != FileFindIter()) {
-		if (!SETTING(SHARE_HIDDEN) && f->isHidden())
-			return nullptr;
+	if (f == FileFindIter())
+		return nullptr;
 
-		if (!SETTING(SHARE_FOLLOW_SYMLINKS) && f->isLink())
-			return nullptr;
+	bool isHidden = f->isHidden();
+	bool isLink = f->isLink();
+	bool isDir = f->isDirectory();
+	int64_t size = f->getSize();
+#else
+	// FileFindIter can only be used for listing directories here
+	struct stat inode;
+	const auto nativePath = Text::fromUtf8(aPath);
+	if (lstat(nativePath.c_str(), &inode) != 0)
+		return nullptr;
 
-		bool isDir = f->isDirectory();
-		auto path = isDir ? aPath + PATH_SEPARATOR : aPath;
-		if (!checkSharedName(path, Text::toLower(path), isDir, true, f->getSize()))
-			return nullptr;
+	bool isLink = S_ISLNK(inode.st_mode);
+	if (isLink && stat(nativePath.c_str(), &inode) != 0)
+		return nullptr;
 
-		return make_pair(path, isDir);
-	}
+	bool isHidden = Util::getFileName(aPath).compare(0, 1, ".") == 0;
+	bool isDir = S_ISDIR(inode.st_mode);
+	int64_t size = inode.st_size;
+#endif
 
-	return nullptr;
+	if (!SETTING(SHARE_HIDDEN) && isHidden)
+		return nullptr;
+
+	if (!SETTING(SHARE_FOLLOW_SYMLINKS) && isLink)
+		return nullptr;
+
+	auto path = isDir ? aPath + PATH_SEPARATOR : aPath;
+	if (!checkSharedName(path, Text::toLower(path), isDir, true, size))
+		return nullptr;
+
+	return make_pair(path, isDir);
 }
 
 void ShareManager::addModifyInfo(const string& aPath, bool isDirectory, DirModifyInfo::ActionType aAction) noexcept {
@@ -282,6 +302,7 @@ bool ShareManager::handleModifyInfo(DirModifyInfo& info, optional<StringList>& b
 	//handle deleted files first
 	if (info.dirAction == DirModifyInfo::ACTION_DELETED) {
 		WLock l(cs);
+		searchCache.invalidate();
 		//the whole dir removed
 		handleDeletedFile(info.path, true, dirtyProfiles_);
 		LogManager::getInstance()->message(STRING_F(SHARED_DIR_REMOVED, info.path), LogManager::LOG_INFO);
@@ -293,6 +314,7 @@ bool ShareManager::handleModifyInfo(DirModifyInfo& info, optional<StringList>& b
 
 		{
 			WLock l(cs);
+			searchCache.invalidate();
 			for (auto i = info.files.begin(); i != info.files.end();) {
 				if (i->second.action == DirModifyInfo::ACTION_DELETED) {
 					bool isDir = i->first.back() == PATH_SEPARATOR;
@@ -426,6 +448,7 @@ bool ShareManager::handleModifyInfo(DirModifyInfo& info, optional<StringList>& b
 					HashedFile hashedFile(ff.getLastModified(), size);
 					if (HashManager::getInstance()->checkTTH(Text::toLower(fi), fi, hashedFile)) {
 						WLock l(cs);
+						searchCache.invalidate();
 						addFile(Util::getFileName(fi), dir, hashedFile, dirtyProfiles_);
 						hashedFiles++;
 						continue;
@@ -542,6 +565,7 @@ void ShareManager::on(DirectoryMonitorListener::FileRenamed, const string& aOldP
 
 	{
 		WLock l(cs);
+		searchCache.invalidate();
 		auto parent = findDirectory(Util::getFilePath(aOldPath), false, false, false);
 		if (parent) {
 			auto fileNameOldLower = Text::toLower(Util::getFileName(aOldPath));
@@ -626,6 +650,9 @@ void ShareManager::on(DirectoryMonitorListener::FileRenamed, const string& aOldP
 		}
 	}
 
+	if (!toRename.empty())
+		HashManager::getInstance()->flush();
+
 	setProfilesDirty(dirtyProfiles);
 }
 
@@ -734,12 +761,13 @@ void ShareManager::abortRefresh() noexcept {
 
 void ShareManager::shutdown(function<void(float)> progressF) noexcept {
 	monitor.removeListener(this);
-	saveXmlList(false, progressF);
+	saveShareCache(false, progressF);
 
 	try {
 		RLock l (cs);
 		//clear refs so we can delete filelists.
 		auto lists = File::findFiles(Util::getPath(Util::PATH_USER_CONFIG), "files?*.xml.bz2", File::TYPE_FILE);
+		boost::copy(File::findFiles(Util::getPath(Util::PATH_USER_CONFIG), "filelistpart_*", File::TYPE_FILE), back_inserter(lists));
 		for(auto& f: shareProfiles) {
 			if(f->getProfileList() && f->getProfileList()->bzXmlRef.get()) 
 				f->getProfileList()->bzXmlRef.reset(); 
@@ -750,6 +778,7 @@ void ShareManager::shutdown(function<void(float)> progressF) noexcept {
 }
 
 void ShareManager::setProfilesDirty(ProfileTokenSet aProfiles, bool forceXmlRefresh /*false*/) noexcept {
+	searchCache.invalidate();
 	if (!aProfiles.empty()) {
 		RLock l(cs);
 		for(const auto aProfile: aProfiles) {
@@ -939,18 +968,26 @@ bool ShareManager::ProfileDirectory::isExcluded(ProfileToken aProfile) const noe
 	return excludedProfiles.find(aProfile) != excludedProfiles.end();
 }
 
-ShareManager::ProfileDirectory::ProfileDirectory(const string& aRootPath, const string& aVname, ProfileToken aProfile, bool incoming /*false*/) : path(aRootPath), cacheDirty(false) { 
+atomic<uint64_t> ShareManager::ProfileDirectory::nextRevision(0);
+
+ShareManager::ProfileDirectory::ProfileDirectory(const string& aRootPath, const string& aVname, ProfileToken aProfile, bool incoming /*false*/) : path(aRootPath), cacheDirty(false), revision(++nextRevision) { 
 	rootProfiles.emplace(aProfile, aVname);
 	setFlag(FLAG_ROOT);
 	if (incoming)
 		setFlag(FLAG_INCOMING);
 }
 
-ShareManager::ProfileDirectory::ProfileDirectory(const string& aRootPath, ProfileToken aProfile) : path(aRootPath), cacheDirty(false) {
+ShareManager::ProfileDirectory::ProfileDirectory(const string& aRootPath, ProfileToken aProfile) : path(aRootPath), cacheDirty(false), revision(++nextRevision) {
 	excludedProfiles.insert(aProfile);
 	setFlag(FLAG_EXCLUDE_PROFILE);
 }
 
+void ShareManager::ProfileDirectory::setCacheDirty(bool aDirty) noexcept {
+	cacheDirty = aDirty;
+	if (aDirty)
+		revision = ++nextRevision;
+}
+
 void ShareManager::ProfileDirectory::addRootProfile(const string& aName, ProfileToken aProfile) noexcept {
 	rootProfiles.erase(aProfile);
 	rootProfiles.emplace(aProfile, aName);
@@ -1366,10 +1403,59 @@ static const string DATE = "Date";
 static const string SHARE = "Share";
 static const string SVERSION = "Version";
 
+/*
+ * Binary share cache (ShareCache_*.dat)
+ *
+ * The file starts with CacheHeader and the path of the shared root. The directory tree follows in pre-order: each directory is stored
+ * as CacheDirectory and its name, followed by its files (CacheFile and the name of each file) and its subdirectories. The root
+ * directory has no name. Names are stored next to their records so that the file can be decoded in a single pass over the mapped
+ * blocks. The file ends with CacheFooter, which contains the number of records and the CRC32 of everything before it.
+ *
+ * Numbers are stored in the native byte order, the magic doesn't match if the cache was written with another one.
+ */
+
+#define SHARE_CACHE_MAGIC 0x31435341 // "ASC1"
+#define SHARE_CACHE_BIN_VERSION 1
+
+struct CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pathLen;
+	uint32_t reserved;
+};
+
+struct CacheDirectory {
+	uint64_t lastWrite;
+	uint32_t nameLen;
+	uint32_t fileCount;
+	uint32_t dirCount;
+	uint32_t reserved;
+};
+
+struct CacheFile {
+	int64_t size;
+	uint64_t lastWrite;
+	uint8_t tth[TTHValue::BYTES];
+	uint32_t nameLen;
+	uint32_t reserved;
+};
+
+struct CacheFooter {
+	uint64_t dirCount;
+	uint64_t fileCount;
+	uint32_t crc;
+	uint32_t magic;
+};
+
+static_assert(sizeof(CacheHeader) == 16 && sizeof(CacheDirectory) == 24 && sizeof(CacheFile) == 48 && sizeof(CacheFooter) == 24, "Unexpected padding in the share cache records");
+
+static const size_t MAX_CACHE_NAME = 64*1024;
+
 struct ShareManager::ShareLoader : public SimpleXMLReader::ThreadedCallBack, public ShareManager::RefreshInfo {
-	ShareLoader(const string& aPath, const ShareManager::Directory::Ptr& aOldRoot, ShareManager::ShareBloom* aBloom) : 
-		ShareManager::RefreshInfo(aPath, aOldRoot, 0),
-		ThreadedCallBack(aOldRoot->getProfileDir()->getCacheXmlPath()),
+	ShareLoader(const string& aPath, const ShareManager::Directory::Ptr& aOldRoot, const string& aCachePath, ShareManager::ShareBloom* aBloom, bool aBuildIndex) : 
+		ShareManager::RefreshInfo(aPath, aOldRoot, 0, aBuildIndex),
+		ThreadedCallBack(aCachePath),
+		cachePath(aCachePath),
 		curDirPath(aOldRoot->getProfileDir()->getPath()),
 		curDirPathLower(Text::toLower(aOldRoot->getProfileDir()->getPath())),
 		bloom(aBloom)
@@ -1377,6 +1463,48 @@ struct ShareManager::ShareLoader : public SimpleXMLReader::ThreadedCallBack, pub
 		cur = root;
 	}
 
+	const string cachePath;
+
+	bool isBinary() const noexcept { return Util::getFileExt(cachePath) == ".dat"; }
+
+	// Returns whether the file is a binary cache that can be loaded by this version
+	static bool isLoadable(const string& aPath) noexcept {
+		try {
+			CacheHeader header;
+			File f(aPath, File::READ, File::OPEN);
+			size_t len = sizeof(header);
+			return f.read(&header, len) == sizeof(header) && header.magic == SHARE_CACHE_MAGIC && header.version == SHARE_CACHE_BIN_VERSION;
+		} catch (const FileException&) {
+			return false;
+		}
+	}
+
+	void loadBinary() throw(Exception) {
+		auto size = File::getSize(cachePath);
+		if (size < 0)
+			throw Exception("Failed to read the cache");
+		fileSize = static_cast<uint64_t>(size);
+
+		string error;
+		FileReader().read(cachePath, [&](const void* aData, size_t aLen) {
+			// don't throw through the reader, the mapped blocks need to be released
+			try {
+				feed(static_cast<const char*>(aData), aLen);
+				return true;
+			} catch (const Exception& e) {
+				error = e.getError();
+				return false;
+			} catch (const std::exception& e) {
+				error = e.what();
+				return false;
+			}
+		});
+
+		if (!error.empty())
+			throw Exception(error);
+		if (binState != BIN_DONE)
+			throw Exception("Unexpected end of file");
+	}
 
 	void startTag(const string& name, StringPairList& attribs, bool simple) {
 		if(compare(name, SDIRECTORY) == 0) {
@@ -1384,24 +1512,7 @@ struct ShareManager::ShareLoader : public SimpleXMLReader::ThreadedCallBack, pub
 			const string& date = getAttrib(attribs, DATE, 1);
 
 			if(!name.empty()) {
-				curDirPath += name + PATH_SEPARATOR;
-
-				ShareManager::ProfileDirectory::Ptr pd = nullptr;
-				if (!subProfiles.empty()) {
-					auto i = subProfiles.find(curDirPath);
-					if(i != subProfiles.end()) {
-						pd = i->second;
-					}
-				}
-
-				cur = ShareManager::Directory::create(name, cur, Util::toUInt32(date), pd);
-				curDirPathLower += cur->realName.getLower() + PATH_SEPARATOR;
-				if (pd && pd->isSet(ShareManager::ProfileDirectory::FLAG_ROOT)) {
-					rootPathsNew[curDirPathLower] = cur;
-				}
-
-				cur->addBloom(*bloom);
-				dirNameMapNew.emplace(const_cast<string*>(&cur->realName.getLower()), cur);
+				startDirectory(name, Util::toUInt32(date));
 			}
 
 			if(simple) {
@@ -1420,8 +1531,7 @@ struct ShareManager::ShareLoader : public SimpleXMLReader::ThreadedCallBack, pub
 				DualString name(fname);
 				HashedFile fi;
 				HashManager::getInstance()->getFileInfo(curDirPathLower + name.getLower(), curDirPath + fname, fi);
-				auto pos = cur->files.insert_sorted(new ShareManager::Directory::File(move(name), cur, fi));
-				ShareManager::updateIndices(*cur, *pos.first, *bloom, addedSize, tthIndexNew);
+				addFile(move(name), fi);
 			}catch(Exception& e) {
 				hashSize += File::getSize(curDirPath + fname);
 				dcdebug("Error loading file list %s \n", e.getError().c_str());
@@ -1431,29 +1541,286 @@ struct ShareManager::ShareLoader : public SimpleXMLReader::ThreadedCallBack, pub
 			if (version > Util::toInt(SHARE_CACHE_VERSION))
 				throw("Newer cache version"); //don't load those...
 
-			cur->addBloom(*bloom);
-			dirNameMapNew.emplace(const_cast<string*>(&cur->realName.getLower()), cur);
-			cur->setLastWrite(Util::toUInt32(getAttrib(attribs, DATE, 2)));
+			startRoot(Util::toUInt32(getAttrib(attribs, DATE, 2)));
 		}
 	}
 	void endTag(const string& name) {
 		if(compare(name, SDIRECTORY) == 0) {
-			if(cur) {
-				curDirPath = Util::getParentDir(curDirPath);
-				curDirPathLower = Util::getParentDir(curDirPathLower);
-				cur = cur->getParent();
-			}
+			endDirectory();
 		}
 	}
 
 private:
 	friend struct SizeSort;
 
+	void startRoot(uint64_t aLastWrite) {
+		cur->addBloom(*bloom);
+		dirNameMapNew.emplace(const_cast<string*>(&cur->realName.getLower()), cur);
+		cur->setLastWrite(aLastWrite);
+	}
+
+	void startDirectory(const string& aName, uint64_t aLastWrite) {
+		curDirPath += aName + PATH_SEPARATOR;
+
+		ShareManager::ProfileDirectory::Ptr pd = nullptr;
+		if (!subProfiles.empty()) {
+			auto i = subProfiles.find(curDirPath);
+			if(i != subProfiles.end()) {
+				pd = i->second;
+			}
+		}
+
+		cur = ShareManager::Directory::create(aName, cur, aLastWrite, pd);
+		curDirPathLower += cur->realName.getLower() + PATH_SEPARATOR;
+		if (pd && pd->isSet(ShareManager::ProfileDirectory::FLAG_ROOT)) {
+			rootPathsNew[curDirPathLower] = cur;
+		}
+
+		cur->addBloom(*bloom);
+		dirNameMapNew.emplace(const_cast<string*>(&cur->realName.getLower()), cur);
+		if (searchIndexNew)
+			searchIndexNew->add(cur->realName.getLower(), cur.get());
+	}
+
+	void endDirectory() {
+		if(cur) {
+			curDirPath = Util::getParentDir(curDirPath);
+			curDirPathLower = Util::getParentDir(curDirPathLower);
+			cur = cur->getParent();
+		}
+	}
+
+	void addFile(DualString&& aName, const HashedFile& aFileInfo) {
+		auto pos = cur->files.insert_sorted(new ShareManager::Directory::File(move(aName), cur, aFileInfo));
+		ShareManager::updateIndices(*cur, *pos.first, *bloom, addedSize, tthIndexNew, searchIndexNew.get());
+	}
+
+	enum BinaryState {
+		BIN_HEADER,
+		BIN_DIRECTORY,
+		BIN_FILE,
+		BIN_FOOTER,
+		BIN_DONE
+	};
+
+	// Records are small so a record split between two blocks can be completed by copying a limited part of the next block
+	void feed(const char* aData, size_t aLen) {
+		if (!pending.empty()) {
+			auto old = pending.size();
+			auto n = min(aLen, sizeof(CacheFile) + MAX_CACHE_NAME);
+			pending.append(aData, n);
+
+			auto used = decode(pending.data(), pending.size());
+			if (used < old) {
+				if (n < aLen)
+					throw Exception("Invalid record");
+
+				// still not complete
+				pending.erase(0, used);
+				return;
+			}
+
+			aData += used - old;
+			aLen -= used - old;
+			pending.clear();
+		}
+
+		auto used = decode(aData, aLen);
+		pending.assign(aData + used, aLen - used);
+	}
+
+	// Returns the number of bytes in complete records that were read
+	size_t decode(const char* aBuf, size_t aLen) {
+		size_t pos = 0;
+		auto consume = [&](size_t aBytes) {
+			crc(aBuf + pos, aBytes);
+			pos += aBytes;
+			decoded += aBytes;
+		};
+
+		for (;;) {
+			auto p = aBuf + pos;
+			auto left = aLen - pos;
+
+			switch (binState) {
+				case BIN_HEADER: {
+					CacheHeader header;
+					if (left < sizeof(header))
+						return pos;
+
+					memcpy(&header, p, sizeof(header));
+					if (header.magic != SHARE_CACHE_MAGIC || header.version != SHARE_CACHE_BIN_VERSION || header.pathLen > MAX_CACHE_NAME)
+						throw Exception("Invalid header");
+					if (left < sizeof(header) + header.pathLen)
+						return pos;
+
+					if (compare(string(p + sizeof(header), header.pathLen), curDirPath) != 0)
+						throw Exception("The cache belongs to another directory");
+
+					consume(sizeof(header) + header.pathLen);
+					binState = BIN_DIRECTORY;
+					break;
+				}
+				case BIN_DIRECTORY: {
+					CacheDirectory dir;
+					if (left < sizeof(dir))
+						return pos;
+
+					memcpy(&dir, p, sizeof(dir));
+					if (dir.nameLen > MAX_CACHE_NAME || (dir.nameLen == 0) != subDirs.empty())
+						throw Exception("Invalid directory record");
+					if (left < sizeof(dir) + dir.nameLen)
+						return pos;
+
+					// the counts aren't verified before the footer, don't allocate more than the rest of the file can contain
+					auto remaining = fileSize - min(fileSize, decoded + sizeof(dir) + dir.nameLen);
+					if (dir.fileCount > remaining / (sizeof(CacheFile) + 1) || dir.dirCount > remaining / (sizeof(CacheDirectory) + 1))
+						throw Exception("Invalid directory record");
+
+					if (subDirs.empty()) {
+						startRoot(dir.lastWrite);
+					} else {
+						startDirectory(string(p + sizeof(dir), dir.nameLen), dir.lastWrite);
+					}
+
+					// everything is written in sorted order
+					cur->files.reserve(dir.fileCount);
+					cur->directories.reserve(dir.dirCount);
+
+					subDirs.push_back(dir.dirCount);
+					files = dir.fileCount;
+					dirCount++;
+
+					consume(sizeof(dir) + dir.nameLen);
+					binState = nextState();
+					break;
+				}
+				case BIN_FILE: {
+					CacheFile file;
+					if (left < sizeof(file))
+						return pos;
+
+					memcpy(&file, p, sizeof(file));
+					if (file.nameLen == 0 || file.nameLen > MAX_CACHE_NAME)
+						throw Exception("Invalid file record");
+					if (left < sizeof(file) + file.nameLen)
+						return pos;
+
+					addFile(DualString(string(p + sizeof(file), file.nameLen)), HashedFile(TTHValue(file.tth), file.lastWrite, file.size));
+
+					files--;
+					fileCount++;
+
+					consume(sizeof(file) + file.nameLen);
+					binState = nextState();
+					break;
+				}
+				case BIN_FOOTER: {
+					CacheFooter footer;
+					if (left < sizeof(footer))
+						return pos;
+
+					memcpy(&footer, p, sizeof(footer));
+					if (footer.magic != SHARE_CACHE_MAGIC || footer.crc != crc.getValue() || footer.dirCount != dirCount || footer.fileCount != fileCount)
+						throw Exception("Checksum mismatch");
+
+					pos += sizeof(footer);
+					binState = BIN_DONE;
+					break;
+				}
+				case BIN_DONE: {
+					if (left > 0)
+						throw Exception("Unexpected data after the end of the cache");
+					return pos;
+				}
+			}
+		}
+	}
+
+	BinaryState nextState() {
+		if (files > 0)
+			return BIN_FILE;
+
+		// continue with the next subdirectory of the closest parent that has any left
+		while (subDirs.back() == 0) {
+			subDirs.pop_back();
+			if (subDirs.empty())
+				return BIN_FOOTER;
+
+			endDirectory();
+		}
+
+		subDirs.back()--;
+		return BIN_DIRECTORY;
+	}
+
 	ShareManager::Directory::Ptr cur;
 
 	string curDirPathLower;
 	string curDirPath;
 	ShareManager::ShareBloom* bloom;
+
+	// binary cache
+	BinaryState binState = BIN_HEADER;
+	string pending;
+	CRC32Filter crc;
+	uint64_t fileSize = 0;
+	uint64_t decoded = 0;
+
+	// subdirectories left for each level
+	vector<uint32_t> subDirs;
+	uint32_t files = 0;
+
+	uint64_t dirCount = 0;
+	uint64_t fileCount = 0;
+};
+
+struct ShareManager::ShareCacheWriter {
+	ShareCacheWriter(OutputStream& aStream) : stream(aStream) { }
+
+	void write(const Directory& aRoot) {
+		const auto& path = aRoot.getProfileDir()->getPath();
+
+		CacheHeader header = { SHARE_CACHE_MAGIC, SHARE_CACHE_BIN_VERSION, static_cast<uint32_t>(path.size()), 0 };
+		add(&header, sizeof(header));
+		add(path.data(), path.size());
+
+		writeDirectory(aRoot, Util::emptyString);
+
+		CacheFooter footer = { dirCount, fileCount, crc.getValue(), SHARE_CACHE_MAGIC };
+		stream.write(&footer, sizeof(footer));
+	}
+private:
+	void writeDirectory(const Directory& aDir, const string& aName) {
+		CacheDirectory dir = { aDir.getLastWrite(), static_cast<uint32_t>(aName.size()), static_cast<uint32_t>(aDir.files.size()), static_cast<uint32_t>(aDir.directories.size()), 0 };
+		add(&dir, sizeof(dir));
+		add(aName.data(), aName.size());
+		dirCount++;
+
+		for (const auto& f: aDir.files) {
+			auto name = f->name.lowerCaseOnly() ? f->name.getLower() : f->name.getNormal();
+
+			CacheFile file = { f->getSize(), f->getLastWrite(), { 0 }, static_cast<uint32_t>(name.size()), 0 };
+			memcpy(file.tth, f->getTTH().data, TTHValue::BYTES);
+			add(&file, sizeof(file));
+			add(name.data(), name.size());
+			fileCount++;
+		}
+
+		for (const auto& d: aDir.directories) {
+			writeDirectory(*d, d->realName.lowerCaseOnly() ? d->realName.getLower() : d->realName.getNormal());
+		}
+	}
+
+	void add(const void* aData, size_t aLen) {
+		crc(aData, aLen);
+		stream.write(aData, aLen);
+	}
+
+	OutputStream& stream;
+	CRC32Filter crc;
+	uint64_t dirCount = 0;
+	uint64_t fileCount = 0;
 };
 
 typedef shared_ptr<ShareManager::ShareLoader> ShareLoaderPtr;
@@ -1466,6 +1833,9 @@ bool ShareManager::loadCache(function<void(float)> progressF) noexcept{
 
 	StringList fileList = File::findFiles(Util::getPath(Util::PATH_SHARECACHE), "ShareCache_*", File::TYPE_FILE);
 
+	// the index will be kept updated by the following refreshes
+	searchIndex.reset(SETTING(SHARE_SEARCH_INDEX) ? new ShareIndex() : nullptr);
+
 	if (fileList.empty()) {
 		if (Util::fileExists(Util::getPath(Util::PATH_USER_CONFIG) + "Shares.xml")) {
 			//delete the old cache
@@ -1486,11 +1856,16 @@ bool ShareManager::loadCache(function<void(float)> progressF) noexcept{
 
 	//create the info dirs
 	for (const auto& p : fileList) {
-		if (Util::getFileExt(p) == ".xml") {
-			auto rp = find_if(parents | map_values, [&p](const Directory::Ptr& aDir) { return Util::stricmp(aDir->getProfileDir()->getCacheXmlPath(), p) == 0; });
-			if (rp.base() != parents.end()) { //make sure that subdirs are never listed here...
+		auto rp = find_if(parents | map_values, [&p](const Directory::Ptr& aDir) { 
+			return Util::stricmp(aDir->getProfileDir()->getCachePath(), p) == 0 || Util::stricmp(aDir->getProfileDir()->getCacheXmlPath(), p) == 0; 
+		});
+
+		if (rp.base() != parents.end()) { //make sure that subdirs are never listed here...
+			// the XML cache is used only if there is no binary cache that we are able to load
+			auto loadable = Util::getFileExt(p) == ".dat" ? ShareLoader::isLoadable(p) : !ShareLoader::isLoadable((*rp)->getProfileDir()->getCachePath());
+			if (loadable) {
 				try {
-					auto loader = new ShareLoader(rp.base()->first, *rp, bloom.get());
+					auto loader = new ShareLoader(rp.base()->first, *rp, p, bloom.get(), searchIndex ? true : false);
 					ll.emplace_back(loader);
 					continue;
 				} catch (...) {}
@@ -1505,7 +1880,7 @@ bool ShareManager::loadCache(function<void(float)> progressF) noexcept{
 
 	//ll.sort(SimpleXMLReader::ThreadedCallBack::SizeSort());
 
-	//load the XML files
+	//load the caches
 	atomic<long> loaded(0);
 	bool hasFailed = false;
 
@@ -1514,14 +1889,18 @@ bool ShareManager::loadCache(function<void(float)> progressF) noexcept{
 			//LogManager::getInstance()->message("Thread: " + Util::toString(::GetCurrentThreadId()) + "Size " + Util::toString(loader.size), LogManager::LOG_INFO);
 			auto& loader = *i;
 			try {
-				SimpleXMLReader(&loader).parse(*loader.file);
-			} catch (SimpleXMLException& e) {
-				LogManager::getInstance()->message("Error loading " + loader.xmlPath + ": " + e.getError(), LogManager::LOG_ERROR);
+				if (loader.isBinary()) {
+					loader.loadBinary();
+				} else {
+					SimpleXMLReader(&loader).parse(*loader.file);
+				}
+			} catch (Exception& e) {
+				LogManager::getInstance()->message("Error loading " + loader.cachePath + ": " + e.getError(), LogManager::LOG_ERROR);
 				hasFailed = true;
-				File::deleteFile(loader.xmlPath);
+				File::deleteFile(loader.cachePath);
 			} catch (...) {
 				hasFailed = true;
-				File::deleteFile(loader.xmlPath);
+				File::deleteFile(loader.cachePath);
 			}
 
 			if (progressF) {
@@ -1541,7 +1920,7 @@ bool ShareManager::loadCache(function<void(float)> progressF) noexcept{
 
 	DirMap newRoots;
 
-	mergeRefreshChanges(ll, dirNameMap, newRoots, tthIndex, hashSize, sharedSize, nullptr);
+	mergeRefreshChanges(ll, dirNameMap, newRoots, tthIndex, searchIndex.get(), hashSize, sharedSize, nullptr);
 
 	//make sure that the subprofiles are added too
 	for (auto& p : newRoots)
@@ -1621,6 +2000,21 @@ void ShareManager::Directory::countStats(uint64_t& totalAge_, size_t& totalDirs_
 	totalFiles_ += files.size();
 }
 
+size_t ShareManager::Directory::getMemoryUsage() const noexcept {
+	size_t ret = sizeof(Directory) - sizeof(DualString) + realName.getMemoryUsage();
+	ret += directories.capacity() * sizeof(Ptr) + files.capacity() * sizeof(File*);
+
+	for (const auto& f: files) {
+		ret += sizeof(File) - sizeof(DualString) + f->name.getMemoryUsage();
+	}
+
+	for (const auto& d: directories) {
+		ret += d->getMemoryUsage();
+	}
+
+	return ret;
+}
+
 void ShareManager::countStats(uint64_t& totalAge_, size_t& totalDirs_, int64_t& totalSize_, size_t& totalFiles_, size_t& lowerCaseFiles_, size_t& totalStrLen_, size_t& roots_) const noexcept{
 	RLock l(cs);
 	for (const auto& d : rootPaths | map_values | filtered(Directory::IsParent())) {
@@ -1639,8 +2033,16 @@ string ShareManager::printStats() const noexcept {
 	countStats(totalAge, totalDirs, totalSize, totalFiles, lowerCaseFiles, totalStrLen, roots);
 
 	unordered_set<TTHValue*> uniqueTTHs;
-	for(auto tth: tthIndex | map_keys) {
-		uniqueTTHs.insert(tth);
+	size_t treeMemory = 0;
+	{
+		RLock l(cs);
+		for(auto tth: tthIndex | map_keys) {
+			uniqueTTHs.insert(tth);
+		}
+
+		for (const auto& d : rootPaths | map_values | filtered(Directory::IsParent())) {
+			treeMemory += d->getMemoryUsage();
+		}
 	}
 
 	auto upseconds = static_cast<double>(GET_TICK()) / 1000.00;
@@ -1654,7 +2056,9 @@ Total shared files: %d (of which %d%% are lowercase)\r\n\
 Unique TTHs: %d (%d%%)\r\n\
 Total shared directories: %d (%d files per directory)\r\n\
 Average age of a file: %s\r\n\
-Average name length of a shared item: %d bytes (total size %s)")
+Average name length of a shared item: %d bytes (total size %s)\r\n\
+Memory used by the share tree: %s (%d bytes per file)\r\n\
+Search index: %s")
 
 		% (shareProfiles.size()-1) // remove hidden
 		% roots % ((rootPaths.size() == 0 ? 0 : static_cast<double>(roots) / static_cast<double>(rootPaths.size())) *100.00)
@@ -1665,6 +2069,8 @@ Average name length of a shared item: %d bytes (total size %s)")
 		% Util::formatTime(GET_TIME() - (totalFiles == 0 ? 0 : totalAge / totalFiles), false, true)
 		% (totalFiles + totalDirs == 0 ? 0 : static_cast<double>(totalStrLen) / static_cast<double>(totalFiles + totalDirs))
 		% Util::formatBytes(totalStrLen)
+		% Util::formatBytes(treeMemory) % (totalFiles == 0 ? 0 : treeMemory / totalFiles)
+		% (searchIndex ? boost::str(boost::format("%d n-grams, %d entries (%s)") % searchIndex->getGramCount() % searchIndex->getEntryCount() % Util::formatBytes(searchIndex->getMemoryUsage())) : "Disabled")
 	);
 
 	ret += boost::str(boost::format(
@@ -1675,6 +2081,8 @@ Filtered text searches: %d%% (%d%% of the matched ones returned results)\r\n\
 Average search tokens (non-filtered only): %d (%d bytes per token)\r\n\
 Auto searches (text, ADC only): %d%%\r\n\
 Average time for matching a recursive search: %d ms\r\n\
+Average time for matching a recursive search (search index/tree walk only): %d ms / %d ms\r\n\
+Cached text searches: %d%% (%d hits, %d misses, %d entries)\r\n\
 TTH searches: %d%% (hash bloom mode: %s)")
 
 		% totalSearches % (totalSearches / upseconds)
@@ -1685,6 +2093,10 @@ TTH searches: %d%% (hash bloom mode: %s)")
 		% (searchTokenCount == 0 ? 0 : static_cast<double>(searchTokenLength) / static_cast<double>(searchTokenCount)) // search token length
 		% (recursiveSearches == 0 ? 0 : (static_cast<double>(autoSearches) / static_cast<double>(recursiveSearches))*100.00) // auto searches
 		% (recursiveSearches - filteredSearches == 0 ? 0 : recursiveSearchTime / (recursiveSearches - filteredSearches)) // search matching time
+		% (indexedSearches == 0 ? 0 : indexedSearchTime / indexedSearches) // search matching time with the index
+		% (recursiveSearches - filteredSearches - indexedSearches == 0 ? 0 : (recursiveSearchTime - indexedSearchTime) / (recursiveSearches - filteredSearches - indexedSearches)) // search matching time without the index
+		% (searchCache.getHits() + searchCache.getMisses() == 0 ? 0 : (static_cast<double>(searchCache.getHits()) / static_cast<double>(searchCache.getHits() + searchCache.getMisses()))*100.00) // cached searches
+		% searchCache.getHits() % searchCache.getMisses() % searchCache.getEntryCount()
 		% (totalSearches == 0 ? 0 : (static_cast<double>(tthSearches) / static_cast<double>(totalSearches))*100.00) // TTH searches
 		% (SETTING(BLOOM_MODE) != SettingsManager::BLOOM_DISABLED ? "Enabled" : "Disabled") // bloom mode
 	);
@@ -1698,6 +2110,9 @@ TTH searches: %d%% (hash bloom mode: %s)")
 	} else {
 		ret += "No folders are being monitored\r\n";
 	}
+
+	ret += "\r\n\r\n-=[ UDP statistics ]=-\r\n\r\n";
+	ret += SearchManager::getInstance()->getUdpStats();
 	return ret;
 }
 
@@ -1892,7 +2307,11 @@ bool ShareManager::isFileShared(const TTHValue& aTTH, ProfileToken aProfile) con
 }
 
 void ShareManager::buildTree(string& aPath, string& aPathLower, const Directory::Ptr& aDir, const ProfileDirMap& aSubRoots, DirMultiMap& aDirs, DirMap& newShares, 
-	int64_t& hashSize, int64_t& addedSize, HashFileMap& tthIndexNew, ShareBloom& aBloom) {
+	int64_t& hashSize, int64_t& addedSize, HashFileMap& tthIndexNew, ShareBloom& aBloom, ShareIndex* aSearchIndex) {
+
+	// hash information of the files in this directory, loaded with a single scan when the first file is found
+	HashManager::HashedFileMap hashedFiles;
+	bool hashedFilesLoaded = false;
 
 	FileFindIter end;
 	for(FileFindIter i(aPath, "*"); i != end && !aShutdown; ++i) {
@@ -1939,7 +2358,7 @@ void ShareManager::buildTree(string& aPath, string& aPathLower, const Directory:
 
 			auto dir = Directory::create(move(dualName), aDir, i->getLastWriteTime(), profileDir);
 
-			buildTree(curPath, curPathLower, dir, aSubRoots, aDirs, newShares, hashSize, addedSize, tthIndexNew, aBloom);
+			buildTree(curPath, curPathLower, dir, aSubRoots, aDirs, newShares, hashSize, addedSize, tthIndexNew, aBloom, aSearchIndex);
 
 			//roots will always be added
 			if (profileDir && profileDir->isSet(ProfileDirectory::FLAG_ROOT)) {
@@ -1952,6 +2371,8 @@ void ShareManager::buildTree(string& aPath, string& aPathLower, const Directory:
 
 			aDirs.emplace(const_cast<string*>(&dir->realName.getLower()), dir);
 			dir->addBloom(aBloom);
+			if (aSearchIndex)
+				aSearchIndex->add(dir->realName.getLower(), dir.get());
 		} else {
 			// Not a directory, assume it's a file...
 			int64_t size = i->getSize();
@@ -1961,11 +2382,16 @@ void ShareManager::buildTree(string& aPath, string& aPathLower, const Directory:
 				continue;
 			}
 
+			if (!hashedFilesLoaded) {
+				HashManager::getInstance()->getDirectoryFiles(aPathLower, hashedFiles);
+				hashedFilesLoaded = true;
+			}
+
 			try {
 				HashedFile fi(i->getLastWriteTime(), size);
-				if(HashManager::getInstance()->checkTTH(aPathLower + dualName.getLower(), aPath + name, fi)) {
+				if(HashManager::getInstance()->checkTTH(aPathLower + dualName.getLower(), aPath + name, fi, hashedFiles)) {
 					auto pos = aDir->files.insert_sorted(new ShareManager::Directory::File(move(dualName), aDir, fi));
-					updateIndices(*aDir, *pos.first, aBloom, addedSize, tthIndexNew);
+					updateIndices(*aDir, *pos.first, aBloom, addedSize, tthIndexNew, aSearchIndex);
 				} else {
 					hashSize += size;
 				}
@@ -1985,22 +2411,24 @@ void ShareManager::Directory::addBloom(ShareBloom& aBloom) const noexcept {
 	}
 }
 
-void ShareManager::updateIndices(Directory::Ptr& dir, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, DirMultiMap& aDirNames) noexcept {
+void ShareManager::updateIndices(Directory::Ptr& dir, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, DirMultiMap& aDirNames, ShareIndex* aSearchIndex) noexcept {
 	// add to bloom
 	dir->addBloom(aBloom);
 	aDirNames.emplace(const_cast<string*>(&dir->realName.getLower()), dir);
+	if (aSearchIndex)
+		aSearchIndex->add(dir->realName.getLower(), dir.get());
 
 	// update all sub items
 	for(auto d: dir->directories) {
-		updateIndices(d, aBloom, sharedSize, tthIndex, aDirNames);
+		updateIndices(d, aBloom, sharedSize, tthIndex, aDirNames, aSearchIndex);
 	}
 
 	for(auto i = dir->files.begin(); i != dir->files.end(); i++) {
-		updateIndices(*dir, *i, aBloom, sharedSize, tthIndex);
+		updateIndices(*dir, *i, aBloom, sharedSize, tthIndex, aSearchIndex);
 	}
 }
 
-void ShareManager::updateIndices(Directory& dir, const Directory::File* f, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex) noexcept {
+void ShareManager::updateIndices(Directory& dir, const Directory::File* f, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, ShareIndex* aSearchIndex) noexcept {
 	dir.size += f->getSize();
 	sharedSize += f->getSize();
 
@@ -2012,6 +2440,10 @@ void ShareManager::updateIndices(Directory& dir, const Directory::File* f, Share
 
 	tthIndex.emplace(const_cast<TTHValue*>(&f->getTTH()), f);
 	aBloom.add(f->name.getLower());
+
+	// files are indexed by their parent directory
+	if (aSearchIndex)
+		aSearchIndex->add(f->name.getLower(), &dir);
 }
 
 int ShareManager::refresh(const string& aDir) noexcept {
@@ -2195,6 +2627,7 @@ ShareManager::ProfileDirMap ShareManager::getSubProfileDirs(const string& aPath)
 
 void ShareManager::addProfiles(const ShareProfileInfo::List& aProfiles) noexcept{
 	WLock l(cs);
+	searchCache.invalidate();
 	for (auto& sp : aProfiles) {
 		shareProfiles.emplace(shareProfiles.end()-1, new ShareProfile(sp->name, sp->token));
 	}
@@ -2202,6 +2635,7 @@ void ShareManager::addProfiles(const ShareProfileInfo::List& aProfiles) noexcept
 
 void ShareManager::removeProfiles(const ShareProfileInfo::List& aProfiles) noexcept{
 	WLock l(cs);
+	searchCache.invalidate();
 	for (auto& sp : aProfiles) {
 		shareProfiles.erase(remove(shareProfiles.begin(), shareProfiles.end(), sp->token), shareProfiles.end());
 	}
@@ -2209,6 +2643,7 @@ void ShareManager::removeProfiles(const ShareProfileInfo::List& aProfiles) noexc
 
 void ShareManager::renameProfiles(const ShareProfileInfo::List& aProfiles) noexcept {
 	WLock l(cs);
+	searchCache.invalidate();
 	for (auto& sp : aProfiles) {
 		auto p = find(shareProfiles.begin(), shareProfiles.end(), sp->token);
 		if (p != shareProfiles.end()) {
@@ -2223,6 +2658,7 @@ void ShareManager::addDirectories(const ShareDirInfo::List& aNewDirs) noexcept {
 
 	{
 		WLock l (cs);
+		searchCache.invalidate();
 		for(const auto& d: aNewDirs) {
 			const auto& sdiPath = d->path;
 			auto i = findRoot(sdiPath);
@@ -2293,6 +2729,7 @@ void ShareManager::removeDirectories(const ShareDirInfo::List& aRemoveDirs) noex
 
 	{
 		WLock l (cs);
+		searchCache.invalidate();
 		for(const auto& rd: aRemoveDirs) {
 			auto k = findRoot(rd->path);
 			if (k != rootPaths.end()) {
@@ -2318,6 +2755,7 @@ void ShareManager::removeDirectories(const ShareDirInfo::List& aRemoveDirs) noex
 					}
 
 					cleanIndices(*sd);
+					File::deleteFile(sd->getProfileDir()->getCachePath());
 					File::deleteFile(sd->getProfileDir()->getCacheXmlPath());
 
 					//no parent directories, get all child roots for this
@@ -2339,7 +2777,7 @@ void ShareManager::removeDirectories(const ShareDirInfo::List& aRemoveDirs) noex
 						if (Util::getParentDir(d->getProfileDir()->getPath()).length() == minLen) {
 							d->setParent(nullptr);
 							d->getProfileDir()->setCacheDirty(true);
-							updateIndices(d, *bloom.get(), sharedSize, tthIndex, dirNameMap);
+							updateIndices(d, *bloom.get(), sharedSize, tthIndex, dirNameMap, searchIndex.get());
 						}
 					}
 				}
@@ -2371,6 +2809,7 @@ void ShareManager::changeDirectories(const ShareDirInfo::List& changedDirs) noex
 
 	{
 		WLock l(cs);
+		searchCache.invalidate();
 		for(const auto& cd: changedDirs) {
 			string vName = validateVirtual(cd->vname);
 			dirtyProfiles.insert(cd->profile);
@@ -2467,7 +2906,21 @@ ShareManager::RefreshInfo::~RefreshInfo() {
 
 }
 
-ShareManager::RefreshInfo::RefreshInfo(const string& aPath, const Directory::Ptr& aOldRoot, uint64_t aLastWrite) : path(aPath), oldRoot(aOldRoot), addedSize(0), hashSize(0) {
+void ShareManager::VolumeRefresh::reportStats(uint64_t aTime, bool aLog) const noexcept {
+	int64_t size = 0;
+	for (const auto& ri : dirs)
+		size += ri->addedSize;
+
+	auto msg = STRING_F(VOLUME_REFRESHED, volume % dirs.size() % Util::formatBytes(size) % Util::formatSeconds(aTime / 1000) % 
+		Util::formatBytes(aTime > 0 ? size * 1000 / static_cast<int64_t>(aTime) : size));
+	if (aLog) {
+		LogManager::getInstance()->message(msg, LogManager::LOG_INFO);
+	} else {
+		dcdebug("%s\n", msg.c_str());
+	}
+}
+
+ShareManager::RefreshInfo::RefreshInfo(const string& aPath, const Directory::Ptr& aOldRoot, uint64_t aLastWrite, bool aBuildIndex) : path(aPath), oldRoot(aOldRoot), addedSize(0), hashSize(0) {
 	subProfiles = getInstance()->getSubProfileDirs(aPath);
 
 	//create the new root
@@ -2477,6 +2930,10 @@ ShareManager::RefreshInfo::RefreshInfo(const string& aPath, const Directory::Ptr
 	}
 
 	dirNameMapNew.emplace(const_cast<string*>(&root->realName.getLower()), root);
+	if (aBuildIndex) {
+		searchIndexNew.reset(new ShareIndex());
+		searchIndexNew->add(root->realName.getLower(), root.get());
+	}
 }
 
 void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexcept {
@@ -2514,13 +2971,18 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 		StringList monitoring;
 		vector<shared_ptr<RefreshInfo>> refreshDirs;
 
+		// a full refresh will replace the search index (the setting may change during the refresh)
+		bool buildIndex = false;
+
 		//find excluded dirs and sub-roots for each directory being refreshed (they will be passed on to buildTree for matching)
 		{
 			RLock l (cs);
+
+			buildIndex = t.first == REFRESH_ALL ? SETTING(SHARE_SEARCH_INDEX) : searchIndex ? true : false;
 			for(auto& i: task->dirs) {
 				auto d = findRoot(i);
 				if (d != rootPaths.end()) {
-					refreshDirs.emplace_back(new RefreshInfo(i, d->second, File::getLastModified(i)));
+					refreshDirs.emplace_back(new RefreshInfo(i, d->second, File::getLastModified(i), buildIndex));
 					
 					//a monitored dir?
 					if (t.first == ADD_DIR && (SETTING(MONITORING_MODE) == SettingsManager::MONITORING_ALL || (SETTING(MONITORING_MODE) == SettingsManager::MONITORING_INCOMING && d->second->getProfileDir()->isSet(ProfileDirectory::FLAG_INCOMING))))
@@ -2529,7 +2991,7 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 					auto curDir = findDirectory(i, false, false, false);
 
 					//curDir may also be nullptr
-					refreshDirs.emplace_back(new RefreshInfo(i, curDir, File::getLastModified(i)));
+					refreshDirs.emplace_back(new RefreshInfo(i, curDir, File::getLastModified(i), buildIndex));
 				}
 			}
 		}
@@ -2548,7 +3010,7 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 
 
 		//bloom
-		ShareBloom* refreshBloom = t.first == REFRESH_ALL ? new ShareBloom(1<<20) : bloom.get();
+		ShareBloom* refreshBloom = t.first == REFRESH_ALL ? new ShareBloom(1<<22) : bloom.get();
 
 		auto doRefresh = [&](RefreshInfoPtr& i) {
 			auto& ri = *i.get();
@@ -2556,7 +3018,7 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 			auto path = ri.path;
 			ri.root->addBloom(*refreshBloom);
 			try {
-				buildTree(path, pathLower, ri.root, ri.subProfiles, ri.dirNameMapNew, ri.rootPathsNew, ri.hashSize, ri.addedSize, ri.tthIndexNew, *refreshBloom);
+				buildTree(path, pathLower, ri.root, ri.subProfiles, ri.dirNameMapNew, ri.rootPathsNew, ri.hashSize, ri.addedSize, ri.tthIndexNew, *refreshBloom, ri.searchIndexNew.get());
 			} catch (const std::bad_alloc&) {
 				LogManager::getInstance()->message(STRING_F(DIR_REFRESH_FAILED, path % STRING(OUT_OF_MEMORY)), LogManager::LOG_ERROR);
 				return;
@@ -2574,8 +3036,47 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 
 		try {
 			if (SETTING(REFRESH_THREADING) == SettingsManager::MULTITHREAD_ALWAYS || (SETTING(REFRESH_THREADING) == SettingsManager::MULTITHREAD_MANUAL && (task->type == TYPE_MANUAL || task->type == TYPE_STARTUP_BLOCKING))) {
+				// scan different volumes concurrently and limit the number of directories scanned at once from the same volume (too many parallel reads would just make the disk seek)
+				vector<unique_ptr<VolumeRefresh>> volumes;
+				for (auto& ri : refreshDirs) {
+					auto vol = File::getMountPath(ri->path);
+					auto p = find_if(volumes.begin(), volumes.end(), [&vol](const unique_ptr<VolumeRefresh>& v) { return v->volume == vol; });
+					if (p == volumes.end()) {
+						volumes.emplace_back(new VolumeRefresh(vol));
+						p = volumes.end() - 1;
+					}
+
+					(*p)->dirs.push_back(ri);
+				}
+
+				auto maxThreads = static_cast<size_t>(max(SETTING(REFRESH_THREADS_PER_VOLUME), 0));
+				vector<VolumeRefresh*> threads;
+				for (auto& v : volumes) {
+					auto count = maxThreads > 0 ? min(v->dirs.size(), maxThreads) : v->dirs.size();
+					v->runningThreads = count;
+					threads.insert(threads.end(), count, v.get());
+				}
+
+				// don't fill the log with the stats of scheduled refreshes
+				auto logStats = task->type == TYPE_MANUAL || t.first == REFRESH_ALL;
+				auto start = GET_TICK();
+
 				TaskScheduler s;
-				parallel_for_each(refreshDirs.begin(), refreshDirs.end(), doRefresh);
+				parallel_for_each(threads.begin(), threads.end(), [&](VolumeRefresh* v) {
+					for (;;) {
+						if (aShutdown)
+							break;
+
+						auto pos = v->nextDir++;
+						if (pos >= v->dirs.size())
+							break;
+
+						doRefresh(v->dirs[pos]);
+					}
+
+					if (--v->runningThreads == 0 && !aShutdown)
+						v->reportStats(GET_TICK() - start, logStats);
+				});
 			} else {
 				for_each(refreshDirs, doRefresh);
 			}
@@ -2593,24 +3094,27 @@ void ShareManager::runTasks(function<void (float)> progressF /*nullptr*/) noexce
 		//append the changes
 		{		
 			WLock l(cs);
+			searchCache.invalidate();
 			if(t.first != REFRESH_ALL) {
 				refreshDirs.erase(boost::remove_if(refreshDirs, [&](RefreshInfoPtr& ri) {
 					return !handleRefreshedDirectory(ri, static_cast<TaskType>(t.first)); 
 				}), refreshDirs.end());
 
 				bloom->merge(*refreshBloom);
-				mergeRefreshChanges(refreshDirs, dirNameMap, rootPaths, tthIndex, totalHash, sharedSize, &dirtyProfiles);
+				mergeRefreshChanges(refreshDirs, dirNameMap, rootPaths, tthIndex, searchIndex.get(), totalHash, sharedSize, &dirtyProfiles);
 			} else {
 				int64_t totalAdded=0;
 				DirMultiMap newDirNames;
 				DirMap newRoots;
 				HashFileMap newTTHs;
+				unique_ptr<ShareIndex> newIndex(buildIndex ? new ShareIndex() : nullptr);
 
-				mergeRefreshChanges(refreshDirs, newDirNames, newRoots, newTTHs, totalHash, totalAdded, &dirtyProfiles);
+				mergeRefreshChanges(refreshDirs, newDirNames, newRoots, newTTHs, newIndex.get(), totalHash, totalAdded, &dirtyProfiles);
 
 				rootPaths.swap(newRoots);
 				dirNameMap.swap(newDirNames);
 				tthIndex.swap(newTTHs);
+				searchIndex.swap(newIndex);
 
 				sharedSize = totalAdded;
 				bloom.reset(refreshBloom);
@@ -2647,6 +3151,7 @@ bool ShareManager::handleRefreshedDirectory(RefreshInfoPtr& ri, TaskType aTaskTy
 		if (AirUtil::isParentOrExact(ri->path, i->first)) {
 			if (aTaskType == ADD_DIR && AirUtil::isSub(i->first, ri->root->getProfileDir()->getPath()) && !i->second->getParent()) {
 				//in case we are adding a new parent
+				File::deleteFile(i->second->getProfileDir()->getCachePath());
 				File::deleteFile(i->second->getProfileDir()->getCacheXmlPath());
 				cleanIndices(*i->second);
 			}
@@ -2697,7 +3202,7 @@ void ShareManager::on(TimerManagerListener::Second, uint64_t /*tick*/) noexcept
 
 void ShareManager::on(TimerManagerListener::Minute, uint64_t tick) noexcept {
 	if(lastSave == 0 || lastSave + 15*60*1000 <= tick) {
-		saveXmlList();
+		saveShareCache();
 	}
 
 	if(SETTING(AUTO_REFRESH_TIME) > 0 && lastFullUpdate + SETTING(AUTO_REFRESH_TIME) * 60 * 1000 <= tick) {
@@ -2758,68 +3263,173 @@ FileList* ShareManager::generateXmlList(ProfileToken aProfile, bool forced /*fal
 	{
 		Lock l(fl->cs);
 		if (fl->allowGenerateNew(forced)) {
-			auto tmpName = fl->getFileName().substr(0, fl->getFileName().length() - 4);
 			try {
-				{
-					File f(tmpName, File::RW, File::TRUNCATE | File::CREATE, File::BUFFER_SEQUENTIAL, false);
+				writeXmlList(fl, aProfile);
 
-					f.write(SimpleXML::utf8Header);
-					f.write("<FileListing Version=\"1\" CID=\"" + ClientManager::getInstance()->getMe()->getCID().toBase32() + "\" Base=\"/\" Generator=\"DC++ " DCVERSIONSTRING "\">\r\n");
+				fl->saveList();
+				fl->generationFinished(false);
+			} catch (const Exception& e) {
+				// No new file lists...
+				LogManager::getInstance()->message(STRING_F(SAVE_FAILED_X, fl->getFileName() % e.getError()), LogManager::LOG_ERROR);
+				fl->generationFinished(true);
+				fl->clearParts();
 
-					string tmp;
-					string indent = "\t";
+				// do we have anything to send?
+				if (fl->getCurrentNumber() == 0) {
+					throw ShareException(UserConnection::FILE_NOT_AVAILABLE);
+				}
+			}
+		}
+	}
+	return fl;
+}
 
-					{
-						auto root = FileListDir(Util::emptyString, 0, 0);
+static string compressBZ(const string& aData) {
+	string ret;
+	StringOutputStream sos(ret);
+	FilteredOutputStream<BZFilter, false> bzipper(&sos);
+	bzipper.write(aData);
+	bzipper.flush();
+	return ret;
+}
 
-						RLock l(cs);
-						for (const auto& d : rootPaths | map_values | filtered(Directory::HasRootProfile(aProfile))) {
-							d->toFileList(&root, aProfile, true);
-						}
+void ShareManager::writeXmlList(FileList* fl, ProfileToken aProfile) throw(Exception) {
+	if (fl->getPartsDirty())
+		fl->clearParts();
 
-						for (const auto it2 : root.listDirs | map_values) {
-							it2->toXml(f, indent, tmp, true);
-						}
-					}
+	// list the virtual root directories
+	StringList partNames;
+	vector<FileList::ListPart*> changedParts;
 
-					f.write("</FileListing>");
-					f.flush();
+	{
+		RLock l(cs);
+		unordered_map<string, Directory::List> roots;
+		for (const auto& d : rootPaths | map_values | filtered(Directory::HasRootProfile(aProfile))) {
+			const auto& name = d->getVirtualNameLower(aProfile);
+			auto& dirs = roots[name];
+			if (dirs.empty())
+				partNames.push_back(name);
+			dirs.push_back(d);
+		}
 
-					fl->setXmlListLen(f.getSize());
+		// remove parts of the old roots
+		for (auto i = fl->parts.begin(); i != fl->parts.end();) {
+			if (roots.find(i->first) == roots.end()) {
+				File::deleteFile(fl->getPartFileName(i->second.number, true));
+				File::deleteFile(fl->getPartFileName(i->second.number, false));
+				i = fl->parts.erase(i);
+			} else {
+				i++;
+			}
+		}
 
-					File bz(fl->getFileName(), File::WRITE, File::TRUNCATE | File::CREATE, File::BUFFER_SEQUENTIAL, false);
-					// We don't care about the leaves...
-					CalcOutputStream<TTFilter<1024 * 1024 * 1024>, false> bzTree(&bz);
-					FilteredOutputStream<BZFilter, false> bzipper(&bzTree);
-					CalcOutputStream<TTFilter<1024 * 1024 * 1024>, false> newXmlFile(&bzipper);
+		// write the content of the changed roots
+		string tmp;
+		string indent = "\t";
+		for (const auto& name : partNames) {
+			const auto& dirs = roots[name];
 
-					newXmlFile.write(f.read());
-					newXmlFile.flush();
+			vector<uint64_t> revisions;
+			for (const auto& d : dirs)
+				revisions.push_back(d->getProfileDir()->getRevision());
 
-					newXmlFile.getFilter().getTree().finalize();
-					bzTree.getFilter().getTree().finalize();
+			auto& part = fl->parts[name];
+			if (part.number != 0 && part.revisions == revisions)
+				continue;
 
-					fl->setXmlRoot(newXmlFile.getFilter().getTree().getRoot());
-					fl->setBzXmlRoot(bzTree.getFilter().getTree().getRoot());
-				}
+			if (part.number == 0)
+				part.number = fl->getNextPartNumber();
+			part.revisions = move(revisions);
+			changedParts.push_back(&part);
 
-				fl->saveList();
-				fl->generationFinished(false);
-			} catch (const Exception& e) {
-				// No new file lists...
-				LogManager::getInstance()->message(STRING_F(SAVE_FAILED_X, fl->getFileName() % e.getError()), LogManager::LOG_ERROR);
-				fl->generationFinished(true);
+			File f(fl->getPartFileName(part.number, false), File::WRITE, File::TRUNCATE | File::CREATE, File::BUFFER_SEQUENTIAL, false);
 
-				// do we have anything to send?
-				if (fl->getCurrentNumber() == 0) {
-					throw ShareException(UserConnection::FILE_NOT_AVAILABLE);
-				}
+			auto root = FileListDir(Util::emptyString, 0, 0);
+			for (const auto& d : dirs) {
+				d->toFileList(&root, aProfile, true);
 			}
 
-			File::deleteFile(tmpName);
+			for (const auto it2 : root.listDirs | map_values) {
+				it2->toXml(f, indent, tmp, true);
+			}
+
+			f.flush();
+			part.xmlLen = f.getSize();
 		}
 	}
-	return fl;
+
+	// compress the changed parts
+	for (auto part : changedParts) {
+		auto bz = compressBZ(File(fl->getPartFileName(part->number, false), File::READ, File::OPEN).read());
+		if (!BZStreamJoiner::getStreamInfo(bz, part->bzInfo)) {
+			// joining won't be possible
+			part->bzInfo = BZStreamJoiner::StreamInfo();
+		}
+
+		File(fl->getPartFileName(part->number, true), File::WRITE, File::TRUNCATE | File::CREATE).write(bz);
+	}
+
+	const string header = SimpleXML::utf8Header + "<FileListing Version=\"1\" CID=\"" + ClientManager::getInstance()->getMe()->getCID().toBase32() + "\" Base=\"/\" Generator=\"DC++ " DCVERSIONSTRING "\">\r\n";
+	const string footer = "</FileListing>";
+
+	const auto bzHeader = compressBZ(header), bzFooter = compressBZ(footer);
+	BZStreamJoiner::StreamInfo headerInfo, footerInfo;
+	bool join = BZStreamJoiner::getStreamInfo(bzHeader, headerInfo) && BZStreamJoiner::getStreamInfo(bzFooter, footerInfo) &&
+		all_of(partNames.begin(), partNames.end(), [&](const string& aName) { return fl->parts[aName].bzInfo.blockSize == headerInfo.blockSize; });
+
+	// create the list
+	File bz(fl->getFileName(), File::WRITE, File::TRUNCATE | File::CREATE, File::BUFFER_SEQUENTIAL, false);
+
+	// We don't care about the leaves...
+	CalcOutputStream<TTFilter<1024 * 1024 * 1024>, false> bzTree(&bz);
+	TTFilter<1024 * 1024 * 1024> xmlTree;
+	int64_t xmlLen = 0;
+
+	auto addXml = [&](const string& aXml) {
+		xmlTree(aXml.data(), aXml.size());
+		xmlLen += aXml.size();
+	};
+
+	if (join) {
+		BZStreamJoiner joiner(&bzTree, headerInfo.blockSize);
+
+		addXml(header);
+		joiner.append(bzHeader, headerInfo);
+
+		for (const auto& name : partNames) {
+			const auto& part = fl->parts[name];
+			addXml(File(fl->getPartFileName(part.number, false), File::READ, File::OPEN).read());
+			joiner.append(File(fl->getPartFileName(part.number, true), File::READ, File::OPEN).read(), part.bzInfo);
+		}
+
+		addXml(footer);
+		joiner.append(bzFooter, footerInfo);
+
+		joiner.finish();
+	} else {
+		// compress everything again
+		FilteredOutputStream<BZFilter, false> bzipper(&bzTree);
+
+		auto write = [&](const string& aXml) {
+			addXml(aXml);
+			bzipper.write(aXml);
+		};
+
+		write(header);
+		for (const auto& name : partNames) {
+			write(File(fl->getPartFileName(fl->parts[name].number, false), File::READ, File::OPEN).read());
+		}
+		write(footer);
+
+		bzipper.flush();
+	}
+
+	xmlTree.getTree().finalize();
+	bzTree.getFilter().getTree().finalize();
+
+	fl->setXmlListLen(xmlLen);
+	fl->setXmlRoot(xmlTree.getTree().getRoot());
+	fl->setBzXmlRoot(bzTree.getFilter().getTree().getRoot());
 }
 
 MemoryInputStream* ShareManager::generatePartialList(const string& dir, bool recurse, ProfileToken aProfile) const noexcept {
@@ -2982,15 +3592,6 @@ void ShareManager::FileListDir::filesToXml(OutputStream& xmlFile, string& indent
 	}
 }
 
-void ShareManager::Directory::filesToXmlList(OutputStream& xmlFile, string& indent, string& tmp2) const {
-	for(const auto& f: files) {
-		xmlFile.write(indent);
-		xmlFile.write(LITERAL("<File Name=\""));
-		xmlFile.write(SimpleXML::escape(f->name.lowerCaseOnly() ? f->name.getLower() : f->name.getNormal(), tmp2, true));
-		xmlFile.write(LITERAL("\"/>\r\n"));
-	}
-}
-
 ShareManager::Directory::File::File(DualString&& aName, const Directory::Ptr& aParent, const HashedFile& aFileInfo) : 
 	size(aFileInfo.getSize()), parent(aParent.get()), tth(aFileInfo.getRoot()), lastWrite(aFileInfo.getTimeStamp()), name(move(aName)) {
 	
@@ -3022,13 +3623,17 @@ ShareManager::FileListDir::~FileListDir() {
 	for_each(listDirs | map_values, DeleteFunction());
 }
 
+string ShareManager::ProfileDirectory::getCachePath() const noexcept {
+	return Util::getPath(Util::PATH_SHARECACHE) + "ShareCache_" + Util::validateFileName(path) + ".dat";
+}
+
 string ShareManager::ProfileDirectory::getCacheXmlPath() const noexcept {
 	return Util::getPath(Util::PATH_SHARECACHE) + "ShareCache_" + Util::validateFileName(path) + ".xml";
 }
 
 #define LITERAL(n) n, sizeof(n)-1
 
-void ShareManager::saveXmlList(bool verbose /*false*/, function<void(float)> progressF /*nullptr*/) noexcept {
+void ShareManager::saveShareCache(bool verbose /*false*/, function<void(float)> progressF /*nullptr*/) noexcept {
 
 	if(xml_saving)
 		return;
@@ -3047,35 +3652,21 @@ void ShareManager::saveXmlList(bool verbose /*false*/, function<void(float)> pro
 
 		try {
 			parallel_for_each(dirtyDirs.begin(), dirtyDirs.end(), [&](const Directory::Ptr& d) {
-				string path = d->getProfileDir()->getCacheXmlPath();
+				string path = d->getProfileDir()->getCachePath();
 				try {
-					string indent, tmp;
-
 					//create a backup first in case we get interrupted on creation.
 					File ff(path + ".tmp", File::WRITE, File::TRUNCATE | File::CREATE);
-					BufferedOutputStream<false> xmlFile(&ff);
-
-					xmlFile.write(SimpleXML::utf8Header);
-					xmlFile.write(LITERAL("<Share Version=\"" SHARE_CACHE_VERSION));
-					xmlFile.write(LITERAL("\" Path=\""));
-					xmlFile.write(SimpleXML::escape(d->getProfileDir()->getPath(), tmp, true));
-
-					xmlFile.write(LITERAL("\" Date=\""));
-					xmlFile.write(SimpleXML::escape(Util::toString(d->getLastWrite()), tmp, true));
-					xmlFile.write(LITERAL("\">\r\n"));
-					indent += '\t';
-
-					for (const auto& child : d->directories) {
-						child->toXmlList(xmlFile, d->getProfileDir()->getPath() + child->realName.getNormal() + PATH_SEPARATOR, indent, tmp);
-					}
-					d->filesToXmlList(xmlFile, indent, tmp);
+					BufferedOutputStream<false> cacheFile(&ff);
 
-					xmlFile.write(LITERAL("</Share>"));
-					xmlFile.flush();
+					ShareCacheWriter(cacheFile).write(*d);
+					cacheFile.flush();
 					ff.close();
 
 					File::deleteFile(path);
 					File::renameFile(path + ".tmp", path);
+
+					// not needed after the first save
+					File::deleteFile(d->getProfileDir()->getCacheXmlPath());
 				} catch (Exception& e) {
 					LogManager::getInstance()->message("Error saving " + path + ": " + e.getError(), LogManager::LOG_WARNING);
 				}
@@ -3097,27 +3688,6 @@ void ShareManager::saveXmlList(bool verbose /*false*/, function<void(float)> pro
 		LogManager::getInstance()->message("Share cache saved.", LogManager::LOG_INFO);
 }
 
-void ShareManager::Directory::toXmlList(OutputStream& xmlFile, string&& path, string& indent, string& tmp) {
-	xmlFile.write(indent);
-	xmlFile.write(LITERAL("<Directory Name=\""));
-	xmlFile.write(SimpleXML::escape(realName.lowerCaseOnly() ? realName.getLower() : realName.getNormal(), tmp, true));
-
-	xmlFile.write(LITERAL("\" Date=\""));
-	xmlFile.write(SimpleXML::escape(Util::toString(lastWrite), tmp, true));
-	xmlFile.write(LITERAL("\">\r\n"));
-
-	indent += '\t';
-	filesToXmlList(xmlFile, indent, tmp);
-
-	for(const auto& d: directories) {
-		d->toXmlList(xmlFile, path + d->realName.getLower() + PATH_SEPARATOR, indent, tmp);
-	}
-
-	indent.erase(indent.length()-1);
-	xmlFile.write(indent);
-	xmlFile.write(LITERAL("</Directory>\r\n"));
-}
-
 MemoryInputStream* ShareManager::generateTTHList(const string& dir, bool recurse, ProfileToken aProfile) const noexcept {
 	
 	if(aProfile == SP_HIDDEN)
@@ -3222,7 +3792,7 @@ void ShareManager::nmdcSearch(SearchResultList& l, const string& nmdcString, int
 * but not the parents...
 */
 
-void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuery& aStrings, ProfileToken aProfile, int level) const noexcept{
+void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuery& aStrings, ProfileToken aProfile, int level, const IndexFilter* aFilter) const noexcept{
 	const auto& dirName = getVirtualNameLower(aProfile);
 	if (aStrings.isExcludedLower(dirName)) {
 		return;
@@ -3287,7 +3857,9 @@ void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuer
 	for(const auto& d: directories) {
 		if (d->isLevelExcluded(aProfile))
 			continue;
-		d->search(results_, aStrings, aProfile, level);
+		if (aFilter && !d->matchesIndexFilter(*aFilter, aStrings))
+			continue;
+		d->search(results_, aStrings, aProfile, level, aFilter);
 	}
 
 	// Moving to a lower level
@@ -3298,6 +3870,49 @@ void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuer
 	aStrings.recursion = old;
 }
 
+bool ShareManager::Directory::matchesIndexFilter(const IndexFilter& aFilter, const SearchQuery& aStrings) const noexcept {
+	// virtual names aren't indexed
+	if (profileDir && profileDir->hasRoots())
+		return true;
+
+	for (size_t j = 0; j < aFilter.size(); ++j) {
+		if (!aFilter[j])
+			continue;
+
+		// matched by a parent directory already?
+		if (aStrings.recursion && aStrings.recursion->positions[j].first != string::npos)
+			continue;
+
+		if (aFilter[j]->find(this) == aFilter[j]->end())
+			return false;
+	}
+
+	return true;
+}
+
+bool ShareManager::getIndexFilter(const SearchQuery& aSearch, IndexFilter& filter_) const noexcept {
+	bool hasFilters = false;
+	for (const auto& p : aSearch.include.getPatterns()) {
+		ShareIndex::Set candidates;
+		if (!searchIndex->getCandidates(p.str(), candidates)) {
+			filter_.emplace_back();
+			continue;
+		}
+
+		// add the parents so that the subtrees containing matches will be traversed
+		ShareIndex::Set dirs(candidates);
+		for (const auto& d : candidates) {
+			for (auto parent = d->getParent(); parent && dirs.insert(parent).second; parent = parent->getParent())
+				;
+		}
+
+		filter_.emplace_back(move(dirs));
+		hasFilters = true;
+	}
+
+	return hasFilters;
+}
+
 void ShareManager::search(SearchResultList& results, SearchQuery& srch, ProfileToken aProfile, const CID& cid, const string& aDir, bool isAutoSearch) throw(ShareException) {
 	totalSearches++;
 	if (aProfile == SP_HIDDEN) {
@@ -3348,6 +3963,15 @@ void ShareManager::search(SearchResultList& results, SearchQuery& srch, ProfileT
 		return;
 	}
 
+	// repeated searches are answered from the cache as long as the share hasn't changed
+	const auto cacheKey = SearchResultCache::getKey(srch, aProfile, aDir);
+	const auto resultsStart = results.size();
+	if (searchCache.get(cacheKey, results)) {
+		if (results.size() > resultsStart)
+			recursiveSearchesResponded++;
+		return;
+	}
+
 	// get the search roots
 	Directory::List roots;
 	if (aDir.empty() || aDir == "/") {
@@ -3358,22 +3982,57 @@ void ShareManager::search(SearchResultList& results, SearchQuery& srch, ProfileT
 
 	auto start = GET_TICK();
 
+	// find the directories that may contain matches
+	IndexFilter indexFilter;
+	bool useIndex = searchIndex && srch.matchType != SearchQuery::MATCH_EXACT && getIndexFilter(srch, indexFilter);
+
+	// parents of the matching files are added without duplicate checks so all results must be kept in that case
+	const auto resultLimit = srch.addParents ? 0 : srch.maxResults;
+
 	// go them through recursively
-	Directory::SearchResultInfo::Set resultInfos;
-	for (const auto& d: roots) {
-		d->search(resultInfos, srch, aProfile, 0);
+	Directory::SearchResultInfo::Set resultInfos(resultLimit);
+	if (roots.size() > 1 && SETTING(SHARE_SEARCH_PARALLEL)) {
+		// the query keeps the matching state so each root needs a copy of its own
+		struct SearchShard {
+			SearchShard(const Directory::Ptr& aRoot, const SearchQuery& aSearch, size_t aLimit) : root(aRoot), search(aSearch), results(aLimit) { }
+
+			Directory::Ptr root;
+			SearchQuery search;
+			Directory::SearchResultInfo::Set results;
+		};
+
+		vector<SearchShard> shards;
+		shards.reserve(roots.size());
+		for (const auto& d: roots)
+			shards.emplace_back(d, srch, resultLimit);
+
+		parallel_for_each(shards.begin(), shards.end(), [&](SearchShard& s) {
+			s.root->search(s.results, s.search, aProfile, 0, useIndex ? &indexFilter : nullptr);
+		});
+
+		for (const auto& s: shards)
+			resultInfos.merge(s.results);
+	} else {
+		for (const auto& d: roots) {
+			d->search(resultInfos, srch, aProfile, 0, useIndex ? &indexFilter : nullptr);
+		}
 	}
 
 	// update statistics
 	auto end = GET_TICK();
 	recursiveSearchTime += end - start;
+	if (useIndex) {
+		indexedSearches++;
+		indexedSearchTime += end - start;
+	}
 	searchTokenCount += srch.include.count();
 	for (const auto& p : srch.include.getPatterns()) 
 		searchTokenLength += p.size();
 
 
 	// pick the results to return
-	for (auto l = resultInfos.begin(); (l != resultInfos.end()) && (results.size() < srch.maxResults); ++l) {
+	const auto& sortedInfos = resultInfos.sort();
+	for (auto l = sortedInfos.begin(); (l != sortedInfos.end()) && (results.size() < srch.maxResults); ++l) {
 		auto& info = *l;
 		if (info.getType() == Directory::SearchResultInfo::DIRECTORY) {
 			addDirResult(info.directory->getFullName(aProfile), results, aProfile, srch);
@@ -3382,6 +4041,8 @@ void ShareManager::search(SearchResultList& results, SearchQuery& srch, ProfileT
 		}
 	}
 
+	searchCache.add(cacheKey, SearchResultList(results.begin() + resultsStart, results.end()));
+
 	if (!results.empty())
 		recursiveSearchesResponded++;
 }
@@ -3405,6 +4066,8 @@ void ShareManager::addDirName(Directory::Ptr& dir) noexcept {
 	dcassert(p.base() == directories.second);
 #endif
 	dirNameMap.emplace(const_cast<string*>(&dir->realName.getLower()), dir);
+	if (searchIndex)
+		searchIndex->add(dir->realName.getLower(), dir.get());
 }
 
 void ShareManager::removeDirName(Directory& dir) noexcept {
@@ -3414,6 +4077,9 @@ void ShareManager::removeDirName(Directory& dir) noexcept {
 		dirNameMap.erase(p.base());
 	else
 		dcassert(0);
+
+	if (searchIndex)
+		searchIndex->remove(&dir);
 }
 
 void ShareManager::cleanIndices(Directory& dir) noexcept {
@@ -3453,6 +4119,7 @@ void ShareManager::on(QueueManagerListener::BundleStatusChanged, const BundlePtr
 
 		{
 			WLock l(cs);
+			searchCache.invalidate();
 			handleDeletedFile(aBundle->getTarget(), true, dirty);
 		}
 
@@ -3532,6 +4199,7 @@ void ShareManager::onFileHashed(const string& fname, HashedFile& fileInfo) noexc
 	ProfileTokenSet dirtyProfiles;
 	{
 		WLock l(cs);
+		searchCache.invalidate();
 		Directory::Ptr d = findDirectory(Util::getFilePath(fname), true, false);
 		if (!d) {
 			return;
@@ -3553,7 +4221,7 @@ void ShareManager::addFile(const string& aName, Directory::Ptr& aDir, const Hash
 	}
 
 	auto it = aDir->files.insert_sorted(new Directory::File(move(dualName), aDir, fi)).first;
-	updateIndices(*aDir, *it, *bloom.get(), sharedSize, tthIndex);
+	updateIndices(*aDir, *it, *bloom.get(), sharedSize, tthIndex, searchIndex.get());
 
 	aDir->copyRootProfiles(dirtyProfiles_, true);
 }
@@ -3587,6 +4255,7 @@ void ShareManager::changeExcludedDirs(const ProfileTokenStringList& aAdd, const
 
 	{
 		WLock l (cs);
+		searchCache.invalidate();
 
 		//add new exludes
 		for(const auto i: aAdd) {
@@ -3613,6 +4282,12 @@ void ShareManager::changeExcludedDirs(const ProfileTokenStringList& aAdd, const
 				profileDirs.erase(pdPos);
 			}
 		}
+
+		//the root revisions don't cover the excludes
+		for (const auto& sp : shareProfiles) {
+			if (dirtyProfiles.find(sp->getToken()) != dirtyProfiles.end())
+				sp->getProfileList()->setPartsDirty(true);
+		}
 	}
 
 	setProfilesDirty(dirtyProfiles, true);
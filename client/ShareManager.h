@@ -34,8 +34,10 @@
 #include "HashedFile.h"
 #include "LogManager.h"
 #include "MerkleTree.h"
+#include "NgramIndex.h"
 #include "Pointer.h"
 #include "SearchManager.h"
+#include "SearchResultCache.h"
 #include "Singleton.h"
 #include "ShareProfile.h"
 #include "SortedVector.h"
@@ -181,7 +183,7 @@ public:
 	MemoryInputStream* generateTTHList(const string& dir, bool recurse, ProfileToken aProfile) const noexcept;
 	MemoryInputStream* getTree(const string& virtualFile, ProfileToken aProfile) const noexcept;
 
-	void saveXmlList(bool verbose=false, function<void (float)> progressF = nullptr) noexcept;	//for filelist caching
+	void saveShareCache(bool verbose=false, function<void (float)> progressF = nullptr) noexcept;	//for filelist caching
 
 	AdcCommand getFileInfo(const string& aFile, ProfileToken aProfile) throw(ShareException);
 
@@ -279,6 +281,7 @@ public:
 
 	int addRefreshTask(TaskType aTaskType, StringList& dirs, RefreshType aRefreshType, const string& displayName = Util::emptyString, function<void(float)> progressF = nullptr) noexcept;
 	struct ShareLoader;
+	struct ShareCacheWriter;
 
 	void rebuildMonitoring() noexcept;
 	void handleChangedFiles() noexcept;
@@ -294,8 +297,18 @@ private:
 	uint64_t searchTokenCount = 0;
 	uint64_t searchTokenLength = 0;
 	uint64_t autoSearches = 0;
+	uint64_t indexedSearches = 0;
+	uint64_t indexedSearchTime = 0;
+
+	SearchResultCache searchCache;
 	typedef BloomFilter<5> ShareBloom;
 
+	class Directory;
+	typedef NgramIndex<3, const Directory*> ShareIndex;
+
+	// Directories containing each include pattern in their subtree (not set for patterns that can't be looked up from the index)
+	typedef vector<optional<ShareIndex::Set>> IndexFilter;
+
 	class ProfileDirectory : public intrusive_ptr_base<ProfileDirectory>, boost::noncopyable, public Flags {
 		public:
 			typedef boost::intrusive_ptr<ProfileDirectory> Ptr;
@@ -309,7 +322,12 @@ private:
 			//lists the profiles where this directory is set as root and virtual names
 			GETSET(ProfileNameMap, rootProfiles, RootProfiles);
 			GETSET(ProfileTokenSet, excludedProfiles, ExcludedProfiles);
-			GETSET(bool, cacheDirty, CacheDirty);
+
+			bool getCacheDirty() const noexcept { return cacheDirty; }
+			void setCacheDirty(bool aDirty) noexcept;
+
+			// Changed every time when the content of the directory tree is modified (unique between all directories)
+			uint64_t getRevision() const noexcept { return revision; }
 
 			~ProfileDirectory() { }
 
@@ -338,10 +356,20 @@ private:
 				return rootProfiles.at(aProfile).getLower();
 			}
 
+			// binary cache
+			string getCachePath() const noexcept;
+
+			// the old XML cache, only loaded if there is no binary one
 			string getCacheXmlPath() const noexcept;
+		private:
+			bool cacheDirty;
+			uint64_t revision;
+
+			static atomic<uint64_t> nextRevision;
 	};
 
 	unique_ptr<ShareBloom> bloom;
+	unique_ptr<ShareIndex> searchIndex;
 
 	struct FileListDir;
 	class Directory : public intrusive_ptr_base<Directory>, boost::noncopyable {
@@ -401,7 +429,56 @@ private:
 				//init(aSearch, aLevel);
 			}
 
-			typedef multiset<SearchResultInfo, Sort> Set;
+			// Keeps the most relevant file results up to the given limit (0 = unlimited)
+			// Directory results may still be rejected when the results are picked (duplicate paths or dates) so all of them are kept
+			class Set {
+			public:
+				explicit Set(size_t aLimit = 0) : limit(aLimit) { }
+
+				void insert(const SearchResultInfo& aInfo) noexcept {
+					if (aInfo.getType() == DIRECTORY) {
+						directories.push_back(aInfo);
+						return;
+					}
+
+					if (limit > 0 && files.size() >= limit) {
+						// the least relevant result is on top of the heap
+						if (!Sort()(aInfo, files.front()))
+							return;
+
+						pop_heap(files.begin(), files.end(), Sort());
+						files.back() = aInfo;
+					} else {
+						files.push_back(aInfo);
+					}
+
+					push_heap(files.begin(), files.end(), Sort());
+				}
+
+				void merge(const Set& aSet) noexcept {
+					for (const auto& i: aSet.files)
+						insert(i);
+					directories.insert(directories.end(), aSet.directories.begin(), aSet.directories.end());
+				}
+
+				// Sorts the results by relevancy, no more items can be inserted after this
+				const vector<SearchResultInfo>& sort() noexcept {
+					sort_heap(files.begin(), files.end(), Sort());
+					stable_sort(directories.begin(), directories.end(), Sort());
+
+					results.reserve(files.size() + directories.size());
+					std::merge(directories.begin(), directories.end(), files.begin(), files.end(), back_inserter(results), Sort());
+					return results;
+				}
+
+				size_t size() const noexcept { return files.size() + directories.size(); }
+			private:
+				vector<SearchResultInfo> files;
+				vector<SearchResultInfo> directories;
+				vector<SearchResultInfo> results;
+				size_t limit;
+			};
+
 			enum Type {
 				FILE,
 				DIRECTORY
@@ -456,16 +533,15 @@ private:
 		int64_t getTotalSize() const noexcept;
 		void getProfileInfo(ProfileToken aProfile, int64_t& totalSize, size_t& filesCount) const noexcept;
 
-		void search(SearchResultInfo::Set& aResults, SearchQuery& aStrings, ProfileToken aProfile, int level) const noexcept;
+		void search(SearchResultInfo::Set& aResults, SearchQuery& aStrings, ProfileToken aProfile, int level, const IndexFilter* aFilter) const noexcept;
+
+		// Returns false if the subtree can't contain all unmatched include patterns
+		bool matchesIndexFilter(const IndexFilter& aFilter, const SearchQuery& aStrings) const noexcept;
 
 		void toFileList(FileListDir* aListDir, ProfileToken aProfile, bool isFullList);
 		void toXml(SimpleXML& aXml, bool fullList, ProfileToken aProfile) const;
 		void toTTHList(OutputStream& tthList, string& tmp2, bool recursive) const;
 
-		//for file list caching
-		void toXmlList(OutputStream& xmlFile, string&& path, string& indent, string& tmp);
-		void filesToXmlList(OutputStream& xmlFile, string& indent, string& tmp2) const;
-
 		GETSET(uint64_t, lastWrite, LastWrite);
 		GETSET(Directory*, parent, Parent);
 		GETSET(ProfileDirectory::Ptr, profileDir, ProfileDir);
@@ -482,6 +558,9 @@ private:
 		void addBloom(ShareBloom& aBloom) const noexcept;
 
 		void countStats(uint64_t& totalAge_, size_t& totalDirs_, int64_t& totalSize_, size_t& totalFiles, size_t& lowerCaseFiles, size_t& totalStrLen_) const noexcept;
+
+		// Approximate number of bytes used by the directory tree (excluding the indices)
+		size_t getMemoryUsage() const noexcept;
 		DualString realName;
 
 		// check for an updated modify date from filesystem
@@ -540,6 +619,9 @@ private:
 
 	bool addDirResult(const string& aPath, SearchResultList& aResults, ProfileToken aProfile, SearchQuery& srch) const noexcept;
 
+	// Returns false if none of the include patterns can be looked up from the search index
+	bool getIndexFilter(const SearchQuery& aSearch, IndexFilter& filter_) const noexcept;
+
 	typedef unordered_map<string, ProfileDirectory::Ptr, noCaseStringHash, noCaseStringEq> ProfileDirMap;
 	ProfileDirMap profileDirs;
 
@@ -548,6 +630,9 @@ private:
 	TaskQueue tasks;
 
 	FileList* generateXmlList(ProfileToken aProfile, bool forced = false) throw(ShareException);
+
+	// Writes the list by joining the compressed parts of each virtual root directory (only the changed parts are regenerated)
+	void writeXmlList(FileList* aList, ProfileToken aProfile) throw(Exception);
 	FileList* getFileList(ProfileToken aProfile) const throw(ShareException);
 
 	volatile bool aShutdown = false;
@@ -574,7 +659,7 @@ private:
 
 	class RefreshInfo : boost::noncopyable {
 	public:
-		RefreshInfo(const string& aPath, const Directory::Ptr& aOldRoot, uint64_t aLastWrite);
+		RefreshInfo(const string& aPath, const Directory::Ptr& aOldRoot, uint64_t aLastWrite, bool aBuildIndex);
 		~RefreshInfo();
 
 		Directory::Ptr oldRoot;
@@ -585,6 +670,7 @@ private:
 		DirMultiMap dirNameMapNew;
 		HashFileMap tthIndexNew;
 		DirMap rootPathsNew;
+		unique_ptr<ShareIndex> searchIndexNew;
 
 		string path;
 	};
@@ -592,15 +678,32 @@ private:
 	typedef shared_ptr<RefreshInfo> RefreshInfoPtr;
 	typedef vector<RefreshInfoPtr> RefreshInfoList;
 
+	// refreshed directories located on the same volume
+	struct VolumeRefresh : boost::noncopyable {
+		VolumeRefresh(const string& aVolume) : volume(aVolume) { }
+
+		// mount path
+		string volume;
+		RefreshInfoList dirs;
+
+		// the directories are taken in order by the threads scanning the volume
+		atomic<size_t> nextDir { 0 };
+		atomic<size_t> runningThreads { 0 };
+
+		void reportStats(uint64_t aTime, bool aLog) const noexcept;
+	};
+
 	bool handleRefreshedDirectory(RefreshInfoPtr& ri, TaskType aTaskType);
 
 	template<typename T>
-	void mergeRefreshChanges(T& aList, DirMultiMap& aDirNameMap, DirMap& aRootPaths, HashFileMap& aTTHIndex, int64_t& totalHash, int64_t& totalAdded, ProfileTokenSet* dirtyProfiles) noexcept {
+	void mergeRefreshChanges(T& aList, DirMultiMap& aDirNameMap, DirMap& aRootPaths, HashFileMap& aTTHIndex, ShareIndex* aSearchIndex, int64_t& totalHash, int64_t& totalAdded, ProfileTokenSet* dirtyProfiles) noexcept {
 		for (const auto& i: aList) {
 			auto& ri = *i;
 			aDirNameMap.insert(ri.dirNameMapNew.begin(), ri.dirNameMapNew.end());
 			aRootPaths.insert(ri.rootPathsNew.begin(), ri.rootPathsNew.end());
 			aTTHIndex.insert(ri.tthIndexNew.begin(), ri.tthIndexNew.end());
+			if (aSearchIndex && ri.searchIndexNew)
+				aSearchIndex->merge(*ri.searchIndexNew);
 
 			totalHash += ri.hashSize;
 			totalAdded += ri.addedSize;
@@ -610,11 +713,11 @@ private:
 		}
 	}
 
-	void buildTree(string& aPath, string& aPathLower, const Directory::Ptr& aDir, const ProfileDirMap& aSubRoots, DirMultiMap& aDirs, DirMap& newShares, int64_t& hashSize, int64_t& addedSize, HashFileMap& tthIndexNew, ShareBloom& aBloom);
+	void buildTree(string& aPath, string& aPathLower, const Directory::Ptr& aDir, const ProfileDirMap& aSubRoots, DirMultiMap& aDirs, DirMap& newShares, int64_t& hashSize, int64_t& addedSize, HashFileMap& tthIndexNew, ShareBloom& aBloom, ShareIndex* aSearchIndex);
 	void addFile(const string& aName, Directory::Ptr& aDir, const HashedFile& fi, ProfileTokenSet& dirtyProfiles_) noexcept;
 
-	static void updateIndices(Directory::Ptr& aDirectory, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, DirMultiMap& aDirNames) noexcept;
-	static void updateIndices(Directory& dir, const Directory::File* f, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex) noexcept;
+	static void updateIndices(Directory::Ptr& aDirectory, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, DirMultiMap& aDirNames, ShareIndex* aSearchIndex) noexcept;
+	static void updateIndices(Directory& dir, const Directory::File* f, ShareBloom& aBloom, int64_t& sharedSize, HashFileMap& tthIndex, ShareIndex* aSearchIndex) noexcept;
 	void cleanIndices(Directory& dir) noexcept;
 	void addDirName(Directory::Ptr& dir) noexcept;
 	void removeDirName(Directory& dir) noexcept;
@@ -50,6 +50,20 @@ void FileList::generationFinished(bool failed) {
 		listN--;
 }
 
+string FileList::getPartFileName(int aNumber, bool aCompressed) const {
+	return Util::getPath(Util::PATH_USER_CONFIG) + "filelistpart_" + Util::toString(profile) + "_" + Util::toString(aNumber) + (aCompressed ? ".xml.part.bz2" : ".xml.part");
+}
+
+void FileList::clearParts() {
+	for (const auto& p : parts | map_values) {
+		File::deleteFile(getPartFileName(p.number, true));
+		File::deleteFile(getPartFileName(p.number, false));
+	}
+
+	parts.clear();
+	partsDirty = false;
+}
+
 void FileList::saveList() {
 	bzXmlRef.reset(new File(getFileName(), File::READ, File::OPEN, File::BUFFER_SEQUENTIAL, false));
 	bzXmlListLen = File::getSize(getFileName());
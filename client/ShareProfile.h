@@ -22,6 +22,7 @@
 #include <string>
 #include "forward.h"
 
+#include "BZUtils.h"
 #include "File.h"
 #include "GetSet.h"
 #include "HashValue.h"
@@ -54,6 +55,25 @@ class FileList {
 		unique_ptr<File> bzXmlRef;
 		string getFileName();
 
+		// Part of the list that contains a single virtual root directory
+		// The compressed parts can be reused as long as the content of their roots stays the same
+		struct ListPart {
+			vector<uint64_t> revisions;
+			BZStreamJoiner::StreamInfo bzInfo;
+			int64_t xmlLen = 0;
+			int number = 0;
+		};
+
+		typedef unordered_map<string, ListPart> PartMap;
+		PartMap parts;
+
+		// Discard the parts when the next list is generated (e.g. because the excluded directories have changed)
+		IGETSET(bool, partsDirty, PartsDirty, false);
+
+		string getPartFileName(int aNumber, bool aCompressed) const;
+		int getNextPartNumber() { return ++partN; }
+		void clearParts();
+
 		bool allowGenerateNew(bool force=false);
 		void generationFinished(bool failed);
 		void saveList();
@@ -61,6 +81,7 @@ class FileList {
 		int getCurrentNumber() const { return listN; }
 	private:
 		int listN = 0;
+		int partN = 0;
 };
 
 class ShareProfileInfo;
@@ -24,6 +24,14 @@
 #include "Text.h"
 #include "Streams.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define XML_SSE2
+# include <emmintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+# endif
+#endif
+
 namespace dcpp {
 
 static bool isSpace(int c) {
@@ -67,6 +75,35 @@ static bool isNameChar(int c) {
 		;
 }
 
+/// Returns the first occurrence of c1 or c2 in [p, end), or end if neither one is found
+static const char* findAny(const char* p, const char* end, char c1, char c2) {
+#ifdef XML_SSE2
+	// compare 16 bytes at a time, the rest is handled below
+	const __m128i v1 = _mm_set1_epi8(c1), v2 = _mm_set1_epi8(c2);
+	for(; end - p >= 16; p += 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1), _mm_cmpeq_epi8(chunk, v2)));
+		if(mask != 0) {
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			return p + bit;
+#else
+			return p + __builtin_ctz(mask);
+#endif
+		}
+	}
+#endif
+
+	for(; p != end; ++p) {
+		if(*p == c1 || *p == c2) {
+			return p;
+		}
+	}
+
+	return end;
+}
+
 SimpleXMLReader::ThreadedCallBack::ThreadedCallBack(const string& path) {
 	file.reset(new File(path, dcpp::File::READ, dcpp::File::OPEN, File::BUFFER_SEQUENTIAL, false));
 	size = file->getSize();
@@ -85,7 +122,7 @@ void SimpleXMLReader::ThreadedCallBackLoader::parse(ProgressFunction prog) {
 }*/
 
 SimpleXMLReader::SimpleXMLReader(SimpleXMLReader::CallBack* callback) :
-	bufPos(0), pos(0), cb(callback), state(STATE_START)
+	bufPos(0), pos(0), decodedCount(0), cb(callback), state(STATE_START)
 {
 	elements.reserve(64);
 	attribs.reserve(16);
@@ -127,6 +164,40 @@ const string& SimpleXMLReader::CallBack::getAttrib(StringPairList& attribs, cons
 	}
 }
 
+SimpleXMLReader::StringRef SimpleXMLReader::CallBack::getAttrib(const AttribRefList& attribs, const string& name, size_t hint) {
+	hint = min(hint, attribs.size());
+
+	auto matches = [&name](const AttribRef& a) { return a.name == name; };
+	auto i = find_if(attribs.begin() + hint, attribs.end(), matches);
+	if(i == attribs.end()) {
+		i = find_if(attribs.begin(), attribs.begin() + hint, matches);
+		return ((i == (attribs.begin() + hint)) ? StringRef() : i->value);
+	} else {
+		return i->value;
+	}
+}
+
+void SimpleXMLReader::CallBack::startTagRefs(const string& name, const AttribRefList& attribs, bool simple) {
+	stringAttribs.clear();
+	for(const auto& a: attribs) {
+		stringAttribs.emplace_back(a.name.str(), a.value.str());
+	}
+
+	startTag(name, stringAttribs, simple);
+}
+
+void SimpleXMLReader::startTag(bool simple) {
+	attribRefs.clear();
+	for(const auto& a: attribs) {
+		attribRefs.emplace_back(StringRef(&buf[a.name], a.nameLen), a.decoded < 0 ? StringRef(&buf[a.value], a.valueLen) : StringRef(decodedValues[a.decoded]));
+	}
+
+	cb->startTagRefs(elements.back(), attribRefs, simple);
+
+	attribs.clear();
+	decodedCount = 0;
+}
+
 bool SimpleXMLReader::literal(const char* lit, size_t len, bool withSpace, ParseState newState) {
 	string::size_type n = 0, nend = bufSize();
 	for(; n < nend && n < len; ++n) {
@@ -195,8 +266,7 @@ bool SimpleXMLReader::elementName() {
 		} else if(c == '>') {
 			append(elements.back(), MAX_NAME_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
 
-			cb->startTag(elements.back(), attribs, false);
-			attribs.clear();
+			startTag(false);
 
 			state = STATE_CONTENT;
 			advancePos(i + 1);
@@ -219,8 +289,7 @@ bool SimpleXMLReader::elementAttr() {
 
 	int c = charAt(0);
 	if(isNameStartChar(c)) {
-		attribs.emplace_back();
-		append(attribs.back().first, MAX_NAME_SIZE, c);
+		attribs.emplace_back(bufPos);
 
 		state = STATE_ELEMENT_ATTR_NAME;
 		advancePos(1);
@@ -232,18 +301,20 @@ bool SimpleXMLReader::elementAttr() {
 }
 
 bool SimpleXMLReader::elementAttrName() {
+	auto& a = attribs.back();
+
 	size_t i = 0;
 	for(size_t iend = bufSize(); i < iend; ++i) {
 		int c = charAt(i);
 
 		if(isSpace(c)) {
-			append(attribs.back().first, MAX_NAME_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
+			a.nameLen = bufPos + i - a.name;
 
 			state = STATE_ELEMENT_ATTR_EQ;
 			advancePos(i + 1);
 			return true;
 		} else if(c == '=') {
-			append(attribs.back().first, MAX_NAME_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
+			a.nameLen = bufPos + i - a.name;
 
 			state = STATE_ELEMENT_ATTR_VALUE;
 			advancePos(i + 1);
@@ -253,36 +324,62 @@ bool SimpleXMLReader::elementAttrName() {
 		}
 	}
 
-	append(attribs.back().first, MAX_NAME_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
+	if(bufPos + i - a.name > MAX_NAME_SIZE) {
+		error("Buffer overflow");
+	}
+
 	advancePos(i);
 	return true;
 }
 
-bool SimpleXMLReader::elementAttrValue() {
-	size_t i = 0;
-	for(size_t iend = bufSize(); i < iend; ++i) {
-		int c = charAt(i);
+string& SimpleXMLReader::decodeValue(AttribSlice& aAttrib) {
+	if(aAttrib.decoded < 0) {
+		if(decodedCount == decodedValues.size()) {
+			decodedValues.emplace_back();
+		}
 
-		if((state == STATE_ELEMENT_ATTR_VALUE_APOS && c == '\'') || (state == STATE_ELEMENT_ATTR_VALUE_QUOT && c == '"')) {
-			append(attribs.back().second, MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
+		aAttrib.decoded = decodedCount++;
+		decodedValues[aAttrib.decoded].assign(buf, aAttrib.value, aAttrib.valueLen);
+	}
 
-			if(!encoding.empty() && compare(encoding, Text::utf8) != 0) {
-				attribs.back().second = Text::toUtf8(attribs.back().second, encoding);
-			}
+	return decodedValues[aAttrib.decoded];
+}
 
-			state = STATE_ELEMENT_ATTR;
-			advancePos(i + 1);
-			return true;
-		} else if(c == '&') {
-			append(attribs.back().second, MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
-			advancePos(i);
-			return entref(attribs.back().second);
+bool SimpleXMLReader::elementAttrValue() {
+	auto& a = attribs.back();
+	if(a.value == string::npos) {
+		a.value = bufPos;
+	}
+
+	// the value is only copied if it contains entity references
+	const char* start = buf.data() + bufPos;
+	size_t i = findAny(start, buf.data() + buf.size(), state == STATE_ELEMENT_ATTR_VALUE_QUOT ? '"' : '\'', '&') - start;
+	if(a.decoded < 0) {
+		a.valueLen += i;
+		if(a.valueLen > MAX_VALUE_SIZE) {
+			error("Buffer overflow");
 		}
+	} else {
+		append(decodedValues[a.decoded], MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
 	}
 
-	append(attribs.back().second, MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + i);
-	advancePos(i);
+	if(i == bufSize()) {
+		advancePos(i);
+		return true;
+	}
 
+	if(charAt(i) == '&') {
+		advancePos(i);
+		return entref(decodeValue(a));
+	}
+
+	if(!encoding.empty() && compare(encoding, Text::utf8) != 0) {
+		auto& d = decodeValue(a);
+		d = Text::toUtf8(d, encoding);
+	}
+
+	state = STATE_ELEMENT_ATTR;
+	advancePos(i + 1);
 	return true;
 }
 
@@ -292,9 +389,8 @@ bool SimpleXMLReader::elementEndSimple() {
 	}
 
 	if(charAt(0) == '>') {
-		cb->startTag(elements.back(), attribs, true);
+		startTag(true);
 		elements.pop_back();
-		attribs.clear();
 
 		state = STATE_CONTENT;
 		advancePos(1);
@@ -310,8 +406,7 @@ bool SimpleXMLReader::elementEndComplex() {
 	}
 
 	if(charAt(0) == '>') {
-		cb->startTag(elements.back(), attribs, false);
-		attribs.clear();
+		startTag(false);
 
 		state = STATE_CONTENT;
 		advancePos(1);
@@ -392,18 +487,23 @@ bool SimpleXMLReader::declEncodingValue() {
 
 bool SimpleXMLReader::comment() {
 	while(bufSize() > 0) {
-		int c = charAt(0);
+		// skip to the next possible end
+		auto p = static_cast<const char*>(memchr(&buf[bufPos], '-', bufSize()));
+		if(!p) {
+			advancePos(bufSize());
+			return true;
+		}
+
+		advancePos(p - &buf[bufPos]);
 
 		// TODO We shouldn't allow ---> to end a comment
-		if(c == '-') {
-			if(!needChars(3)) {
-				return true;
-			}
-			if(charAt(1) == '-' && charAt(2) == '>') {
-				state = STATE_CONTENT;
-				advancePos(3);
-				return true;
-			}
+		if(!needChars(3)) {
+			return true;
+		}
+		if(charAt(1) == '-' && charAt(2) == '>') {
+			state = STATE_CONTENT;
+			advancePos(3);
+			return true;
 		}
 
 		advancePos(1);
@@ -414,20 +514,25 @@ bool SimpleXMLReader::comment() {
 
 bool SimpleXMLReader::cdata() {
 	while (bufSize() > 0) {
-		int c = charAt(0);
+		// copy everything before the next possible end at once
+		auto p = static_cast<const char*>(memchr(&buf[bufPos], ']', bufSize()));
+		size_t n = p ? p - &buf[bufPos] : bufSize();
+		append(value, MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + n);
+		advancePos(n);
+		if (!p) {
+			return true;
+		}
 
-		if (c == ']') {
-			if (!needChars(3)) {
-				return true;
-			}
-			if (charAt(1) == ']' && charAt(2) == '>') {
-				state = STATE_CONTENT;
-				advancePos(3);
-				return true;
-			}
+		if (!needChars(3)) {
+			return true;
+		}
+		if (charAt(1) == ']' && charAt(2) == '>') {
+			state = STATE_CONTENT;
+			advancePos(3);
+			return true;
 		}
 
-		append(value, MAX_VALUE_SIZE, c);
+		append(value, MAX_VALUE_SIZE, ']');
 		advancePos(1);
 	}
 
@@ -439,7 +544,9 @@ bool SimpleXMLReader::entref(string& d) {
 		error("Buffer overflow");
 	}
 
-	if(bufSize() > 6) {
+	// the longest recognized reference is "&#x0000;", wait for more data unless the terminating ';' is already there
+	const size_t MAX_REF_SIZE = 8;
+	if(bufSize() >= MAX_REF_SIZE || buf.find(';', bufPos + 1) != string::npos) {
 		if(charAt(1) == 'l' && charAt(2) == 't' && charAt(3) == ';') {
 			d.append(1, '<');
 			advancePos(4);
@@ -509,9 +616,12 @@ bool SimpleXMLReader::content() {
 		return entref(value);
 	}
 
-	append(value, MAX_VALUE_SIZE, c);
+	// append the text until the next tag or entity reference at once (a '<' that didn't start any markup is kept as text)
+	const char* start = buf.data() + bufPos;
+	size_t n = findAny(start + 1, buf.data() + buf.size(), '<', '&') - start;
+	append(value, MAX_VALUE_SIZE, buf.begin() + bufPos, buf.begin() + bufPos + n);
 
-	advancePos(1);
+	advancePos(n);
 
 	return true;
 }
@@ -579,8 +689,9 @@ void SimpleXMLReader::parse(InputStream& stream, size_t maxSize) {
 	const size_t BUF_SIZE = 64*1024;
 	size_t bytesRead = 0;
 	do {
+		// the buffer may contain an incomplete tag from the previous read
 		size_t old = buf.size();
-		buf.resize(BUF_SIZE);
+		buf.resize(old + BUF_SIZE);
 
 		size_t n = buf.size() - old;
 		size_t len = stream.read(&buf[old], n);
@@ -744,10 +855,17 @@ bool SimpleXMLReader::process() {
 		}
 
 		if(oldState == state && oldPos == bufPos) {
-			// Need more data...
-			if(bufPos > 0) {
-				buf.erase(buf.begin(), buf.begin() + bufPos);
-				bufPos = 0;
+			// Need more data... (the attributes of an incomplete tag point to the buffer)
+			auto n = attribs.empty() ? bufPos : attribs.front().name;
+			if(n > 0) {
+				buf.erase(buf.begin(), buf.begin() + n);
+				bufPos -= n;
+				for(auto& a: attribs) {
+					a.name -= n;
+					if(a.value != string::npos) {
+						a.value -= n;
+					}
+				}
 			}
 			return true;
 		}
@@ -28,6 +28,34 @@ namespace dcpp {
 
 class SimpleXMLReader {
 public:
+	/** Slice of the parse buffer (or of a decoded attribute value). The data is always followed by a character
+	that can't be part of a number (the closing quote or a null character), but it isn't null-terminated. */
+	struct StringRef {
+		StringRef() : data(nullptr), size(0) { }
+		StringRef(const char* aData, size_t aSize) : data(aData), size(aSize) { }
+		explicit StringRef(const std::string& aStr) : data(aStr.c_str()), size(aStr.size()) { }
+
+		bool empty() const { return size == 0; }
+		std::string str() const { return std::string(data, size); }
+
+		bool operator==(const std::string& aStr) const { return size == aStr.size() && memcmp(data, aStr.data(), size) == 0; }
+		bool operator!=(const std::string& aStr) const { return !(*this == aStr); }
+
+		int64_t toInt64() const { return size == 0 ? 0 : strtoll(data, nullptr, 10); }
+		uint32_t toUInt32() const { return size == 0 ? 0 : static_cast<uint32_t>(strtoul(data, nullptr, 10)); }
+
+		const char* data;
+		size_t size;
+	};
+
+	struct AttribRef {
+		AttribRef(const StringRef& aName, const StringRef& aValue) : name(aName), value(aValue) { }
+
+		StringRef name;
+		StringRef value;
+	};
+	typedef std::vector<AttribRef> AttribRefList;
+
 	struct CallBack : private boost::noncopyable {
 		virtual ~CallBack() { }
 
@@ -38,6 +66,11 @@ public:
 		@param simple Whether this tag is void of any data (<example/>). */
 		virtual void startTag(const std::string& /*name*/, StringPairList& /*attribs*/, bool /*simple*/) { }
 
+		/** Same as startTag but the attributes point to the parser's buffer, which saves copying them for
+		each tag. The slices are valid only until this function returns. The default implementation copies
+		the attributes and calls startTag. */
+		virtual void startTagRefs(const std::string& name, const AttribRefList& attribs, bool simple);
+
 		/** Contents of an XML tag have been read.
 		@param data Contents of the tag.
 		@note This may be called several times per tag with partial contents in mixed content
@@ -51,6 +84,9 @@ public:
 
 	protected:
 		static const std::string& getAttrib(StringPairList& attribs, const std::string& name, size_t hint);
+		static StringRef getAttrib(const AttribRefList& attribs, const std::string& name, size_t hint);
+	private:
+		StringPairList stringAttribs;
 	};
 
 	struct ThreadedCallBack : public CallBack {
@@ -174,7 +210,24 @@ private:
 	std::string::size_type bufPos;
 	uint64_t pos;
 
-	StringPairList attribs;
+	/** Attributes of the current tag as offsets to buf, the tag is kept in the buffer until it has been
+	passed to the callback. Values containing entities or using other encodings than UTF-8 are stored in
+	decodedValues. */
+	struct AttribSlice {
+		AttribSlice(size_t aName) : name(aName), nameLen(0), value(std::string::npos), valueLen(0), decoded(-1) { }
+
+		size_t name;
+		size_t nameLen;
+		size_t value;
+		size_t valueLen;
+		int decoded;
+	};
+
+	std::vector<AttribSlice> attribs;
+	StringList decodedValues;
+	size_t decodedCount;
+	AttribRefList attribRefs;
+
 	std::string value;
 
 	CallBack* cb;
@@ -208,6 +261,8 @@ private:
 	bool elementAttr();
 	bool elementAttrName();
 	bool elementAttrValue();
+	std::string& decodeValue(AttribSlice& aAttrib);
+	void startTag(bool simple);
 
 	bool comment();
 
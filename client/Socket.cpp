@@ -20,11 +20,16 @@
 #include "Socket.h"
 
 #include "ConnectivityManager.h"
+#include "File.h"
 #include "format.h"
 #include "SettingsManager.h"
 #include "TimerManager.h"
 #include "ResourceManager.h"
 
+#ifdef HAVE_SOCKET_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 /// @todo remove when MinGW has this
 #ifdef __MINGW32__
 #ifndef EADDRNOTAVAIL
@@ -553,6 +558,68 @@ int Socket::read(void* aBuffer, int aBufLen, string &aIP) {
 	return len;
 }
 
+int Socket::readBatch(Datagram* aPackets, int aCount) {
+	dcassert(type == TYPE_UDP);
+	aCount = min(aCount, static_cast<int>(MAX_BATCH));
+
+	int n = 0;
+	for(auto s: { sock4.get(), sock6.get() }) {
+		if(s == INVALID_SOCKET)
+			continue;
+
+#ifdef HAVE_SOCKET_MMSG
+		if(n == aCount)
+			break;
+
+		mmsghdr msgs[MAX_BATCH];
+		iovec iovs[MAX_BATCH];
+		addr addrs[MAX_BATCH];
+
+		auto count = aCount - n;
+		for(int i = 0; i < count; ++i) {
+			iovs[i].iov_base = aPackets[n + i].buf;
+			iovs[i].iov_len = aPackets[n + i].bufLen;
+
+			memset(&msgs[i], 0, sizeof(mmsghdr));
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		auto read = check([&] { return ::recvmmsg(s, msgs, count, MSG_DONTWAIT, nullptr); }, true);
+		for(int i = 0; i < read; ++i) {
+			auto& p = aPackets[n + i];
+			p.len = msgs[i].msg_len;
+			p.ip = resolveName(&addrs[i].sa, msgs[i].msg_hdr.msg_namelen);
+			stats.totalDown += p.len;
+		}
+
+		if(read > 0)
+			n += read;
+#else
+		while(n < aCount) {
+			auto& p = aPackets[n];
+
+			addr remote_addr = { { 0 } };
+			socklen_t addr_length = sizeof(remote_addr);
+			p.len = check([&] {
+				return ::recvfrom(s, (char*)p.buf, p.bufLen, 0, &remote_addr.sa, &addr_length);
+			}, true);
+
+			if(p.len < 0)
+				break;
+
+			p.ip = resolveName(&remote_addr.sa, addr_length);
+			stats.totalDown += p.len;
+			n++;
+		}
+#endif
+	}
+
+	return n;
+}
+
 int Socket::readAll(void* aBuffer, int aBufLen, uint32_t timeout) {
 	uint8_t* buf = (uint8_t*)aBuffer;
 	int i = 0;
@@ -597,6 +664,18 @@ int Socket::write(const void* aBuffer, int aLen) {
 	return sent;
 }
 
+#ifdef HAVE_SOCKET_SENDFILE
+int Socket::sendFile(File& aFile, size_t aLen) {
+	dcassert(!isSecure());
+	// the file offset is advanced by the kernel
+	auto sent = check([&] { return static_cast<int>(::sendfile(getSock(), aFile.getNativeHandle(), nullptr, aLen)); }, true);
+	if(sent > 0) {
+		stats.totalUp += sent;
+	}
+	return sent;
+}
+#endif
+
 /**
  * Sends data, will block until all data has been sent or an exception occurs
  * @param aBuffer Buffer with data
@@ -661,6 +740,63 @@ void Socket::writeTo(const string& aAddr, const string& aPort, const void* aBuff
 	stats.totalUp += sent;
 }
 
+void Socket::writeBatchTo(const string& aAddr, const string& aPort, const StringList& aPackets) {
+	if(aPackets.empty())
+		return;
+
+	if(aAddr.empty() || aPort.empty()) {
+		throw SocketException(EADDRNOTAVAIL);
+	}
+
+	if(CONNSETTING(OUTGOING_CONNECTIONS) == SettingsManager::OUTGOING_SOCKS5) {
+		// each packet needs its own header
+		for(const auto& p: aPackets) {
+			writeTo(aAddr, aPort, p);
+		}
+		return;
+	}
+
+	auto ai = resolveAddr(aAddr, aPort);
+	if((ai->ai_family == AF_INET && !sock4.valid()) || (ai->ai_family == AF_INET6 && !sock6.valid())) {
+		create(*ai);
+	}
+
+	auto s = ai->ai_family == AF_INET ? sock4.get() : sock6.get();
+
+#ifdef HAVE_SOCKET_MMSG
+	mmsghdr msgs[MAX_BATCH];
+	iovec iovs[MAX_BATCH];
+
+	size_t pos = 0;
+	while(pos < aPackets.size()) {
+		auto count = min(aPackets.size() - pos, static_cast<size_t>(MAX_BATCH));
+		for(size_t i = 0; i < count; ++i) {
+			const auto& p = aPackets[pos + i];
+			iovs[i].iov_base = const_cast<char*>(p.data());
+			iovs[i].iov_len = p.size();
+
+			memset(&msgs[i], 0, sizeof(mmsghdr));
+			msgs[i].msg_hdr.msg_name = ai->ai_addr;
+			msgs[i].msg_hdr.msg_namelen = ai->ai_addrlen;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		auto sent = check([&] { return ::sendmmsg(s, msgs, count, 0); });
+		for(int i = 0; i < sent; ++i) {
+			stats.totalUp += msgs[i].msg_len;
+		}
+
+		pos += sent;
+	}
+#else
+	for(const auto& p: aPackets) {
+		auto sent = check([&] { return ::sendto(s, p.data(), (int)p.size(), 0, ai->ai_addr, ai->ai_addrlen); });
+		stats.totalUp += sent;
+	}
+#endif
+}
+
 /**
  * Blocks until timeout is reached one of the specified conditions have been fulfilled
  * @param millis Max milliseconds to block.
@@ -48,6 +48,11 @@ const int INVALID_SOCKET = -1;
 #include <boost/noncopyable.hpp>
 #include <memory>
 
+#ifdef __linux__
+#define HAVE_SOCKET_SENDFILE
+#define HAVE_SOCKET_MMSG
+#endif
+
 namespace dcpp {
 
 class SocketException : public Exception {
@@ -89,6 +94,19 @@ public:
 		TYPE_UDP = IPPROTO_UDP
 	};
 
+	enum {
+		/** The maximum number of datagrams for readBatch and writeBatchTo calls */
+		MAX_BATCH = 32
+	};
+
+	/** Received datagram */
+	struct Datagram {
+		uint8_t* buf;
+		int bufLen;
+		int len;
+		string ip;
+	};
+
 	explicit Socket(SocketType type) : type(type) { }
 
 	virtual ~Socket() { }
@@ -117,8 +135,22 @@ public:
 	void writeAll(const void* aBuffer, int aLen, uint32_t timeout = 0);
 	virtual int write(const void* aBuffer, int aLen);
 	int write(const string& aData) { return write(aData.data(), (int)aData.length()); }
+#ifdef HAVE_SOCKET_SENDFILE
+	/**
+	 * Sends data from the current position of the file without copying it to userspace.
+	 * Can't be used with encrypted sockets.
+	 * @return Number of bytes sent, 0 if the file has ended or -1 if the call would block
+	 * @throw SocketException Send failed.
+	 */
+	int sendFile(File& aFile, size_t aLen);
+#endif
 	virtual void writeTo(const string& aIp, const string& aPort, const void* aBuffer, int aLen, bool proxy = true);
 	void writeTo(const string& aIp, const string& aPort, const string& aData) { writeTo(aIp, aPort, aData.data(), (int)aData.length()); }
+	/**
+	 * Sends multiple datagrams to the same address with as few system calls as possible
+	 * @throw SocketException Send failed.
+	 */
+	void writeBatchTo(const string& aIp, const string& aPort, const StringList& aPackets);
 	virtual void shutdown() noexcept;
 	virtual void close() noexcept;
 	void disconnect() noexcept;
@@ -143,6 +175,14 @@ public:
 	 * @throw SocketException On any failure.
 	 */
 	virtual int read(void* aBuffer, int aBufLen, string &aIP);
+
+	/**
+	 * Reads the datagrams that are available without blocking (UDP only)
+	 * @param aPackets Buffers to read into (up to MAX_BATCH)
+	 * @return Number of datagrams read
+	 * @throw SocketException Read failed.
+	 */
+	int readBatch(Datagram* aPackets, int aCount);
 	/**
 	 * Reads data until aBufLen bytes have been read or an error occurs.
 	 * If the socket is closed, or the timeout is reached, the number of bytes read
@@ -190,6 +230,9 @@ public:
 	GETSET(bool, v4only, V4only);
 
 	bool isV6Valid() const noexcept;
+
+	/** The handle of the connected socket */
+	socket_t getSock() const;
 protected:
 	typedef union {
 		sockaddr sa;
@@ -198,8 +241,6 @@ protected:
 		sockaddr_storage sas;
 	} addr;
 
-	socket_t getSock() const;
-
 	mutable SocketHandle sock4;
 	mutable SocketHandle sock6;
 
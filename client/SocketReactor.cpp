@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+#include "SocketReactor.h"
+
+#ifdef HAVE_SOCKET_REACTOR
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "TimerManager.h"
+
+namespace dcpp {
+
+SocketReactor::SocketReactor() : workers(0), minWorkers(max(static_cast<int>(std::thread::hardware_concurrency()), 4)) {
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = 0;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+	start();
+}
+
+SocketReactor::~SocketReactor() {
+	{
+		Lock l(cs);
+		stopping = true;
+		dcassert(handlers.empty());
+	}
+
+	// stop the epoll thread
+	eventfd_write(wakeFd, 1);
+	join();
+
+	// and the workers (no new ones can be started anymore)
+	for(size_t i = 0; i < workerThreads.size(); ++i) {
+		jobSem.signal();
+	}
+
+	for(auto& w: workerThreads) {
+		w->join();
+	}
+
+	::close(wakeFd);
+	::close(epollFd);
+}
+
+void SocketReactor::add(Handler* aHandler) noexcept {
+	Lock l(cs);
+	aHandler->id = ++nextId;
+	handlers.emplace(aHandler->id, aHandler);
+}
+
+void SocketReactor::schedule(Handler* aHandler) noexcept {
+	Lock l(cs);
+	if(aHandler->scheduled) {
+		// make the running worker check the handler once more
+		aHandler->pending = true;
+		return;
+	}
+
+	queue(aHandler);
+}
+
+void SocketReactor::queue(Handler* aHandler) noexcept {
+	// always locked
+	aHandler->scheduled = true;
+	jobs.push_back(aHandler);
+
+	if(idleWorkers <= 0 && workers < minWorkers) {
+		startWorker();
+	}
+
+	idleWorkers--;
+	jobSem.signal();
+}
+
+void SocketReactor::startWorker() noexcept {
+	// always locked
+	if(stopping)
+		return;
+
+	workerThreads.remove_if([](const unique_ptr<Worker>& w) {
+		if(!w->finished)
+			return false;
+
+		w->join();
+		return true;
+	});
+
+	workers++;
+	idleWorkers++;
+
+	workerThreads.emplace_back(new Worker(*this));
+	try {
+		workerThreads.back()->start();
+	} catch(const ThreadException& e) {
+		dcdebug("Failed to start a reactor worker: %s\n", e.getError().c_str());
+		workerThreads.pop_back();
+		workers--;
+		idleWorkers--;
+	}
+}
+
+int SocketReactor::run() {
+	const int MAX_EVENTS = 64;
+	epoll_event events[MAX_EVENTS];
+	int timeout = STARVATION_TIMEOUT;
+
+	for(;;) {
+		int n = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+
+			dcdebug("epoll_wait failed: %s\n", Util::translateError(errno).c_str());
+			break;
+		}
+
+		Lock l(cs);
+		if(stopping)
+			break;
+
+		for(int i = 0; i < n; ++i) {
+			if(events[i].data.u64 == 0) {
+				// woken up because of an earlier wake time
+				eventfd_t value;
+				eventfd_read(wakeFd, &value);
+				continue;
+			}
+
+			// the handler may have been removed after the event was received
+			auto h = handlers.find(events[i].data.u64);
+			if(h != handlers.end() && !h->second->scheduled) {
+				queue(h->second);
+			}
+		}
+
+		auto tick = GET_TICK();
+		while(!timers.empty() && timers.begin()->first <= tick) {
+			auto h = handlers.find(timers.begin()->second);
+			if(h != handlers.end() && h->second->wakeTime == timers.begin()->first && !h->second->scheduled) {
+				queue(h->second);
+			}
+			timers.erase(timers.begin());
+		}
+
+		if(idleWorkers < 0 && lastJobTaken + STARVATION_TIMEOUT < tick) {
+			// all workers are blocked
+			startWorker();
+			lastJobTaken = tick;
+		}
+
+		timeout = timers.empty() ? STARVATION_TIMEOUT : static_cast<int>(min(timers.begin()->first - tick, static_cast<uint64_t>(STARVATION_TIMEOUT)));
+	}
+
+	return 0;
+}
+
+void SocketReactor::runWorker() noexcept {
+	for(;;) {
+		bool hasJob = jobSem.wait(WORKER_IDLE_TIMEOUT);
+
+		Handler* h = nullptr;
+		{
+			Lock l(cs);
+			if(!hasJob) {
+				// exit if there are enough idle workers without us
+				if(stopping || idleWorkers > MIN_IDLE_WORKERS) {
+					idleWorkers--;
+					break;
+				}
+				continue;
+			}
+
+			if(jobs.empty()) {
+				dcassert(stopping);
+				break;
+			}
+
+			h = jobs.front();
+			jobs.pop_front();
+			lastJobTaken = GET_TICK();
+		}
+
+		runHandler(h);
+	}
+
+	workers--;
+}
+
+void SocketReactor::runHandler(Handler* aHandler) noexcept {
+	for(;;) {
+		auto result = aHandler->handleEvents();
+
+		Lock l(cs);
+		if(result == RESULT_REMOVE) {
+			handlers.erase(aHandler->id);
+			idleWorkers++;
+			break;
+		}
+
+		if(aHandler->pending || result == RESULT_AGAIN) {
+			aHandler->pending = false;
+			if(result == RESULT_AGAIN && !jobs.empty()) {
+				// give the others a turn, this worker will pick it up later
+				jobs.push_back(aHandler);
+				jobSem.signal();
+				return;
+			}
+			continue;
+		}
+
+		aHandler->scheduled = false;
+		arm(aHandler);
+		idleWorkers++;
+		return;
+	}
+
+	// removed from the map and unscheduled, no one can have a reference to it anymore
+	delete aHandler;
+}
+
+void SocketReactor::arm(Handler* aHandler) noexcept {
+	// always locked
+	aHandler->wakeTime = aHandler->getWakeTime();
+	if(aHandler->wakeTime > 0) {
+		if(timers.empty() || aHandler->wakeTime < timers.begin()->first) {
+			// the epoll thread may be sleeping past it
+			eventfd_write(wakeFd, 1);
+		}
+		timers.emplace(aHandler->wakeTime, aHandler->id);
+	}
+
+	auto s = aHandler->getPollSocket();
+	if(s == INVALID_SOCKET) {
+		// the old socket has been closed, which also removed it from epoll
+		aHandler->pollSocket = INVALID_SOCKET;
+		return;
+	}
+
+	auto pollEvents = aHandler->getPollEvents();
+	if(pollEvents == 0) {
+		// the one-shot registration has been disabled already
+		return;
+	}
+
+	epoll_event ev = {};
+	ev.events = EPOLLONESHOT;
+	if(pollEvents & POLL_READ)
+		ev.events |= EPOLLIN | EPOLLRDHUP;
+	if(pollEvents & POLL_WRITE)
+		ev.events |= EPOLLOUT;
+	ev.data.u64 = aHandler->id;
+
+	auto ret = epoll_ctl(epollFd, s != aHandler->pollSocket ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, s, &ev);
+	if(ret != 0 && (errno == ENOENT || errno == EEXIST)) {
+		// the socket was closed (and the descriptor possibly reused) without us noticing,
+		// or it has been registered already
+		ret = epoll_ctl(epollFd, errno == ENOENT ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, s, &ev);
+	}
+
+	if(ret == 0) {
+		aHandler->pollSocket = s;
+	} else {
+		dcdebug("Failed to watch socket %d: %s\n", s, Util::translateError(errno).c_str());
+	}
+}
+
+} // namespace dcpp
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_SOCKET_REACTOR_H
+#define DCPLUSPLUS_DCPP_SOCKET_REACTOR_H
+
+#ifdef __linux__
+#define HAVE_SOCKET_REACTOR
+#endif
+
+#ifdef HAVE_SOCKET_REACTOR
+
+#include <deque>
+#include <list>
+#include <map>
+
+#include "typedefs.h"
+
+#include "CriticalSection.h"
+#include "Semaphore.h"
+#include "Singleton.h"
+#include "Socket.h"
+#include "Thread.h"
+#include "atomic.h"
+
+namespace dcpp {
+
+/**
+* Waits for socket events on all registered sockets with a single epoll thread and runs the
+* socket handlers in a shared pool of worker threads.
+*
+* A handler is run by one worker at a time. Instead of blocking, handlers should return
+* RESULT_WAIT and tell which events of the socket (and optionally a time) to wait for.
+* Handlers that still block (DNS lookups, SOCKS5 negotiation) keep their worker for that time.
+* When the queued handlers haven't been picked up for a while because all workers are blocked,
+* new workers are started, so the number of threads follows the number of busy sockets instead
+* of all sockets.
+*/
+class SocketReactor : public Singleton<SocketReactor>, private Thread {
+public:
+	enum Result {
+		/** Remove and delete the handler */
+		RESULT_REMOVE,
+		/** Wait for the socket events, the wake time or a new schedule call */
+		RESULT_WAIT,
+		/** Run the handler again after the other queued ones */
+		RESULT_AGAIN
+	};
+
+	enum PollEvents {
+		POLL_READ = 0x01,
+		POLL_WRITE = 0x02
+	};
+
+	class Handler {
+	public:
+		Handler() { }
+		virtual ~Handler() { }
+
+		virtual Result handleEvents() noexcept = 0;
+		/** Socket to wait for events, INVALID_SOCKET if there's nothing to wait for */
+		virtual socket_t getPollSocket() noexcept = 0;
+		/** PollEvents to wait for in the socket, 0 to wait for the wake time only */
+		virtual int getPollEvents() noexcept = 0;
+		/** Tick when the handler should be run even if there are no socket events, 0 if never */
+		virtual uint64_t getWakeTime() noexcept = 0;
+	private:
+		friend class SocketReactor;
+
+		uint64_t id = 0;
+		socket_t pollSocket = INVALID_SOCKET;
+		uint64_t wakeTime = 0;
+		bool scheduled = false;
+		bool pending = false;
+	};
+
+	SocketReactor();
+	~SocketReactor();
+
+	void add(Handler* aHandler) noexcept;
+	/** Run the handler as soon as possible (safe to call from any thread) */
+	void schedule(Handler* aHandler) noexcept;
+
+	int getWorkerCount() const noexcept { return workers; }
+private:
+	enum {
+		MIN_IDLE_WORKERS = 2,
+		WORKER_IDLE_TIMEOUT = 60*1000,
+		/** How long the queued handlers may wait before a new worker is started */
+		STARVATION_TIMEOUT = 100
+	};
+
+	class Worker : public Thread {
+	public:
+		Worker(SocketReactor& aReactor) : reactor(aReactor) { }
+
+		/** Set when the thread is about to exit and can be joined without waiting */
+		atomic<bool> finished { false };
+	private:
+		int run() {
+			reactor.runWorker();
+			finished = true;
+			return 0;
+		}
+
+		SocketReactor& reactor;
+	};
+
+	int run();
+	void runWorker() noexcept;
+	void runHandler(Handler* aHandler) noexcept;
+	void arm(Handler* aHandler) noexcept;
+	void queue(Handler* aHandler) noexcept;
+	void startWorker() noexcept;
+
+	CriticalSection cs;
+	unordered_map<uint64_t, Handler*> handlers;
+	uint64_t nextId = 0;
+
+	/** Wake time -> handler id, the entries of removed and rearmed handlers are skipped */
+	std::multimap<uint64_t, uint64_t> timers;
+
+	std::deque<Handler*> jobs;
+	Semaphore jobSem;
+	/** Idle workers minus the queued handlers (negative when handlers are waiting for a worker) */
+	int idleWorkers = 0;
+	atomic<int> workers;
+	/** The exited workers are joined when the next one is started */
+	std::list<unique_ptr<Worker>> workerThreads;
+	const int minWorkers;
+	uint64_t lastJobTaken = 0;
+
+	int epollFd;
+	int wakeFd;
+	bool stopping = false;
+};
+
+} // namespace dcpp
+
+#endif
+
+#endif // !defined(DCPLUSPLUS_DCPP_SOCKET_REACTOR_H)
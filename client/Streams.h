@@ -84,6 +84,15 @@ public:
 	/* This only works for file streams */
 	virtual void setPos(int64_t /*pos*/) noexcept { }
 	virtual InputStream* releaseRootStream() { return this; }
+
+	/**
+	 * Returns the file that the remaining data can be read from without this stream (or nullptr if the data is modified).
+	 * aMaxBytes is set to the number of bytes that may still be read from it (-1 if there is no limit).
+	 */
+	virtual File* getDirectFile(int64_t& /*aMaxBytes*/) noexcept { return nullptr; }
+
+	/* Called after the bytes have been read directly from the file returned by getDirectFile */
+	virtual void directRead(size_t /*len*/) noexcept { }
 };
 
 class MemoryInputStream : public InputStream {
@@ -171,6 +180,17 @@ public:
 		auto as = s.release();
 		return as->releaseRootStream();
 	}
+
+	File* getDirectFile(int64_t& aMaxBytes) noexcept {
+		auto f = s->getDirectFile(aMaxBytes);
+		aMaxBytes = aMaxBytes < 0 ? maxBytes : min(aMaxBytes, maxBytes);
+		return f;
+	}
+
+	void directRead(size_t len) noexcept {
+		maxBytes -= len;
+		s->directRead(len);
+	}
 private:
 	unique_ptr<InputStream> s;
 	int64_t maxBytes;
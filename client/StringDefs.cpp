@@ -1842,6 +1842,17 @@ std::string dcpp::ResourceManager::strings[] = {
 "Locations", 
 "All files", 
 "Type/Content", 
+"Use a search index for incoming searches (uses more memory, applied after a full refresh)", 
+"Search the shared directories in parallel (multiple CPU cores are used for a single search)", 
+"Read files ahead bypassing the system cache when hashing", 
+"Memory for caching files uploaded to several users at once (MiB, 0 = disabled)", 
+"Upload limit per user (KiB/s, 0 = disabled)", 
+"Download limit per user (KiB/s, 0 = disabled)", 
+"The maximum number of watched folders has been reached (increase fs.inotify.max_user_watches)", 
+"Continuing the interrupted hash database maintenance...", 
+"Hash database maintenance was interrupted, it will continue from the same position when it's started the next time", 
+"Maximum number of directories refreshed at once from the same volume (0 = unlimited)", 
+"Volume %1%: %2% directories (%3%) refreshed in %4% (%5%/s)", 
 };
 std::string dcpp::ResourceManager::names[] = {
 "Active", 
@@ -3684,4 +3695,15 @@ std::string dcpp::ResourceManager::names[] = {
 "Locations", 
 "AllFiles", 
 "TypeContent", 
+"ShareSearchIndex", 
+"ShareSearchParallel", 
+"HashDirectRead", 
+"UploadCacheSize", 
+"UploadLimitUser", 
+"DownloadLimitUser", 
+"MonitorWatchLimit", 
+"HashdbMaintenanceResumed", 
+"HashdbMaintenanceInterrupted", 
+"RefreshThreadsPerVolume", 
+"VolumeRefreshed", 
 };
@@ -1846,5 +1846,16 @@ enum Strings { // @DontAdd
 	LOCATIONS, // "Locations"
 	ALL_FILES, // "All files"
 	TYPE_CONTENT, // "Type/Content"
+	SHARE_SEARCH_INDEX, // "Use a search index for incoming searches (uses more memory, applied after a full refresh)"
+	SHARE_SEARCH_PARALLEL, // "Search the shared directories in parallel (multiple CPU cores are used for a single search)"
+	HASH_DIRECT_READ, // "Read files ahead bypassing the system cache when hashing"
+	UPLOAD_CACHE_SIZE, // "Memory for caching files uploaded to several users at once (MiB, 0 = disabled)"
+	UPLOAD_LIMIT_USER, // "Upload limit per user (KiB/s, 0 = disabled)"
+	DOWNLOAD_LIMIT_USER, // "Download limit per user (KiB/s, 0 = disabled)"
+	MONITOR_WATCH_LIMIT, // "The maximum number of watched folders has been reached (increase fs.inotify.max_user_watches)"
+	HASHDB_MAINTENANCE_RESUMED, // "Continuing the interrupted hash database maintenance..."
+	HASHDB_MAINTENANCE_INTERRUPTED, // "Hash database maintenance was interrupted, it will continue from the same position when it's started the next time"
+	REFRESH_THREADS_PER_VOLUME, // "Maximum number of directories refreshed at once from the same volume (0 = unlimited)"
+	VOLUME_REFRESHED, // "Volume %1%: %2% directories (%3%) refreshed in %4% (%5%/s)"
 	LAST // @DontAdd
 };
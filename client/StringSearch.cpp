@@ -87,10 +87,177 @@ size_t StringSearch::Pattern::matchLower(const string& aText, int aStartPos) con
 	return string::npos;
 }
 
+/**
+* Aho-Corasick automaton with a full transition table (the failure links are
+* resolved when building it so that each character is handled with a single lookup)
+*/
+class StringSearch::Automaton {
+public:
+	explicit Automaton(const PatternList& aPatterns) noexcept;
+
+	/** Returns true if any of the patterns is found from the text */
+	bool matchAny(const string& aText) const noexcept;
+
+	/**
+	* Finds the first match position of each pattern
+	* Returns a mask of the found patterns
+	*/
+	uint64_t findFirst(const string& aText, size_t* positions_) const noexcept;
+private:
+	typedef uint16_t State;
+	enum { ASIZE = 256 };
+
+	inline State step(State aState, uint8_t aChar) const noexcept { return next[aState * ASIZE + aChar]; }
+
+	vector<State> next;
+
+	// mask of patterns ending in each state
+	vector<uint64_t> output;
+
+	vector<size_t> lengths;
+	uint64_t allMask = 0;
+};
+
+StringSearch::Automaton::Automaton(const PatternList& aPatterns) noexcept {
+	dcassert(aPatterns.size() <= AUTOMATON_MAX_PATTERNS);
+
+	// build the trie (no transitions lead to the root state at this point)
+	next.assign(ASIZE, 0);
+	output.assign(1, 0);
+	for (size_t i = 0; i < aPatterns.size(); ++i) {
+		const auto& pattern = aPatterns[i].str();
+
+		State s = 0;
+		for (auto c: pattern) {
+			auto& t = next[s * ASIZE + static_cast<uint8_t>(c)];
+			if (t == 0) {
+				t = static_cast<State>(output.size());
+				next.resize(next.size() + ASIZE, 0);
+				output.push_back(0);
+			}
+
+			s = next[s * ASIZE + static_cast<uint8_t>(c)];
+		}
+
+		output[s] |= static_cast<uint64_t>(1) << i;
+		lengths.push_back(pattern.size());
+		allMask |= static_cast<uint64_t>(1) << i;
+	}
+
+	// add the failure transitions in breadth-first order
+	vector<State> fail(output.size(), 0);
+	deque<State> queue;
+	for (int c = 0; c < ASIZE; ++c) {
+		if (next[c] != 0)
+			queue.push_back(next[c]);
+	}
+
+	while (!queue.empty()) {
+		auto s = queue.front();
+		queue.pop_front();
+
+		output[s] |= output[fail[s]];
+		for (int c = 0; c < ASIZE; ++c) {
+			auto& t = next[s * ASIZE + c];
+			if (t != 0) {
+				fail[t] = step(fail[s], static_cast<uint8_t>(c));
+				queue.push_back(t);
+			} else {
+				t = step(fail[s], static_cast<uint8_t>(c));
+			}
+		}
+	}
+}
+
+bool StringSearch::Automaton::matchAny(const string& aText) const noexcept {
+	State s = 0;
+	for (auto c: aText) {
+		s = step(s, static_cast<uint8_t>(c));
+		if (output[s] != 0)
+			return true;
+	}
+
+	return false;
+}
+
+uint64_t StringSearch::Automaton::findFirst(const string& aText, size_t* positions_) const noexcept {
+	fill_n(positions_, lengths.size(), string::npos);
+
+	uint64_t found = 0;
+	State s = 0;
+	for (size_t i = 0; i < aText.size(); ++i) {
+		s = step(s, static_cast<uint8_t>(aText[i]));
+
+		auto newMatches = output[s] & ~found;
+		if (newMatches == 0)
+			continue;
+
+		for (size_t j = 0; j < lengths.size(); ++j) {
+			if (newMatches & (static_cast<uint64_t>(1) << j))
+				positions_[j] = i + 1 - lengths[j];
+		}
+
+		found |= newMatches;
+		if (found == allMask)
+			break;
+	}
+
+	return found;
+}
+
+StringSearch::StringSearch(const StringSearch& rhs) : patterns(rhs.patterns), automatonStates(rhs.automatonStates) {
+	// build it before sharing so that the copies don't need to do it separately
+	rhs.getAutomaton();
+	automaton = rhs.automaton;
+}
+
+StringSearch& StringSearch::operator=(const StringSearch& rhs) {
+	if (this != &rhs) {
+		patterns = rhs.patterns;
+		automatonStates = rhs.automatonStates;
+
+		rhs.getAutomaton();
+		automaton = rhs.automaton;
+		automatonOnce.reset();
+	}
+
+	return *this;
+}
+
+const StringSearch::Automaton* StringSearch::getAutomaton() const noexcept {
+	if (automatonOnce) {
+		call_once(*automatonOnce, [this] {
+			if (patterns.size() >= AUTOMATON_MIN_PATTERNS && patterns.size() <= AUTOMATON_MAX_PATTERNS && automatonStates <= numeric_limits<uint16_t>::max()) {
+				automaton = make_shared<const Automaton>(patterns);
+			}
+		});
+	}
+
+	return automaton.get();
+}
+
+void StringSearch::setPatternsChanged() noexcept {
+	automaton = nullptr;
+	automatonOnce.reset(new once_flag());
+}
 
 void StringSearch::addString(const string& aStr) {
-	if (!aStr.empty())
+	if (!aStr.empty()) {
 		patterns.emplace_back(Text::toLower(aStr));
+		automatonStates += patterns.back().str().size();
+		setPatternsChanged();
+	}
+}
+
+void StringSearch::addStrings(const StringList& aPatterns) {
+	for (const auto& p: aPatterns) {
+		if (!p.empty()) {
+			patterns.emplace_back(Text::toLower(p));
+			automatonStates += patterns.back().str().size();
+		}
+	}
+
+	setPatternsChanged();
 }
 
 bool StringSearch::match_all(const string& aText) const {
@@ -105,6 +272,10 @@ bool StringSearch::match_all(const string& aText) const {
 }
 
 bool StringSearch::match_any_lower(const string& aText) const {
+	auto automaton = getAutomaton();
+	if (automaton)
+		return automaton->matchAny(aText);
+
 	for (const auto& p : patterns) {
 		if (p.matchLower(aText) != string::npos) {
 			return true;
@@ -119,11 +290,20 @@ bool StringSearch::match_any(const string& aText) const {
 }
 
 int StringSearch::matchLower(const string& aText, bool aResumeOnNoMatch, ResultList* results_) const {
+	// all patterns need to be searched for when resuming, find their first positions at once
+	// (otherwise matching each pattern separately is faster as the first missing one ends the search)
+	size_t firstPositions[AUTOMATON_MAX_PATTERNS];
+	auto automaton = aResumeOnNoMatch ? getAutomaton() : nullptr;
+	const bool useAutomaton = automaton != nullptr;
+	if (useAutomaton) {
+		automaton->findFirst(aText, firstPositions);
+	}
+
 	int matches = 0, listPos = 0;
 	for (const auto& p: patterns) {
 		size_t addPos = string::npos;
 		for (;;) {
-			size_t curPos = p.matchLower(aText, addPos == string::npos ? 0 : addPos + 1);
+			size_t curPos = (useAutomaton && addPos == string::npos) ? firstPositions[listPos] : p.matchLower(aText, addPos == string::npos ? 0 : addPos + 1);
 			if (curPos != string::npos) {
 				if (results_ && listPos > 0) {
 					// prefer sequential match order if this isn't the first pattern
@@ -157,8 +337,28 @@ int StringSearch::matchLower(const string& aText, bool aResumeOnNoMatch, ResultL
 	return matches;
 }
 
+uint64_t StringSearch::matchMaskLower(const string& aText) const {
+	dcassert(patterns.size() <= MAX_MASK_PATTERNS);
+	auto automaton = getAutomaton();
+	if (automaton) {
+		size_t positions[AUTOMATON_MAX_PATTERNS];
+		return automaton->findFirst(aText, positions);
+	}
+
+	uint64_t found = 0;
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		if (patterns[i].matchLower(aText) != string::npos)
+			found |= static_cast<uint64_t>(1) << i;
+	}
+
+	return found;
+}
+
 void StringSearch::clear() {
 	patterns.clear();
+	automatonStates = 1;
+	automaton = nullptr;
+	automatonOnce.reset();
 }
 
 }
\ No newline at end of file
@@ -22,6 +22,8 @@
 #include "typedefs.h"
 #include "noexcept.h"
 
+#include <mutex>
+
 namespace dcpp {
 
 /**
@@ -29,7 +31,9 @@ namespace dcpp {
 * one pattern against many strings (currently Quick Search, a variant of
 * Boyer-Moore. Code based on "A very fast substring search algorithm" by
 * D. Sunday).
-* @todo Perhaps find an algo suitable for matching multiple substrings.
+*
+* When there are multiple patterns, an Aho-Corasick automaton is used for
+* finding the first matches of all patterns with a single pass over the text.
 */
 class StringSearch {
 public:
@@ -65,19 +69,47 @@ public:
 
 	typedef vector<Pattern> PatternList;
 
+	StringSearch() { }
+	StringSearch(const StringSearch& rhs);
+	StringSearch& operator=(const StringSearch& rhs);
+
+	// Maximum number of patterns for matchMaskLower
+	enum { MAX_MASK_PATTERNS = 64 };
+
 	bool match_all(const string& aText) const;
 	bool match_any(const string& aText) const;
 	bool match_any_lower(const string& aText) const;
 
 	int matchLower(const string& aText, bool aResumeOnNoMatch, ResultList* results_ = nullptr) const;
+
+	/** Returns a mask of the patterns that are found from the text (with a single pass if possible) */
+	uint64_t matchMaskLower(const string& aText) const;
+
 	void addString(const string& aPattern);
+	void addStrings(const StringList& aPatterns);
 	void clear();
 
 	inline size_t count() const { return patterns.size(); }
 	inline bool empty() const { return patterns.empty(); }
 	inline const PatternList& getPatterns() const { return patterns; }
 private:
+	class Automaton;
+
+	// Quick Search is faster for small pattern counts
+	enum { AUTOMATON_MIN_PATTERNS = 3, AUTOMATON_MAX_PATTERNS = 64 };
+
 	PatternList patterns;
+
+	// Shared between the copies, a new one is built when the patterns are matched for the first time after they have changed
+	mutable shared_ptr<const Automaton> automaton;
+
+	// Set while the automaton for the current patterns hasn't been built, the patterns must not be changed while matching
+	unique_ptr<once_flag> automatonOnce;
+	size_t automatonStates = 1;
+
+	// Returns nullptr if the automaton isn't used for the current patterns
+	const Automaton* getAutomaton() const noexcept;
+	void setPatternsChanged() noexcept;
 };
 
 } // namespace dcpp
@@ -33,79 +33,225 @@ namespace dcpp {
  * Inspired by Token Bucket algorithm: http://en.wikipedia.org/wiki/Token_bucket
  */
 
-/*
- * Throttles traffic and reads a packet from the network
- */
-int ThrottleManager::read(Socket* sock, void* buffer, size_t len)
+ThrottleManager::ThrottleManager() : global(make_shared<Limiter>(nullptr)), stopping(false)
+{
+	updateLimits();
+	TimerManager::getInstance()->addListener(this);
+}
+
+int64_t ThrottleManager::Bucket::getBurst() const noexcept
 {
-	int64_t readSize = -1;
-	size_t downs = DownloadManager::getInstance()->getDownloadCount();
-	auto downLimit = getDownLimit(); // avoid even intra-function races
-	if(!getCurThrottling() || downLimit == 0 || downs == 0)
-		return sock->read(buffer, len);
+	return max(rate * BURST_TIME / 1000, static_cast<int64_t>(MIN_SLICE));
+}
 
-	{
-		Lock l(downCS);
+void ThrottleManager::Bucket::refill(uint64_t aTick) noexcept
+{
+	auto last = lastRefill.load();
+	if(aTick <= last || !lastRefill.compare_exchange_strong(last, aTick))
+		return; // refilled by someone else
 
-		if(downTokens > 0)
-		{
-			int64_t slice = (downLimit * 1024) / downs;
-			readSize = min(slice, min(static_cast<int64_t>(len), downTokens));
+	auto add = rate * static_cast<int64_t>(aTick - last);
+	auto capacity = getBurst() * 1000;
 
-			// read from socket
-			readSize = sock->read(buffer, static_cast<size_t>(readSize));
+	auto cur = tokens.load();
+	while(!tokens.compare_exchange_weak(cur, min(cur + add, capacity)))
+		;
+}
 
-			if(readSize > 0)
-				downTokens -= readSize;
+int64_t ThrottleManager::Bucket::take(int64_t aBytes, uint64_t aTick) noexcept
+{
+	refill(aTick);
+
+	auto cur = tokens.load();
+	for(;;) {
+		auto n = min(aBytes, cur / 1000);
+		if(n <= 0)
+			return 0;
+
+		if(tokens.compare_exchange_weak(cur, cur - n * 1000))
+			return n;
+	}
+}
+
+uint64_t ThrottleManager::Bucket::getWaitTime(int64_t aBytes) const noexcept
+{
+	int64_t r = rate;
+	if(r <= 0)
+		return 0;
+
+	auto missing = aBytes * 1000 - tokens;
+	return missing <= 0 ? 0 : static_cast<uint64_t>(missing / r) + 1;
+}
+
+int64_t ThrottleManager::acquire(Limiter* aLimiter, Bucket Limiter::*aBucket, size_t aTransfers, int64_t aBytes, uint64_t* aWait_) noexcept
+{
+	if(stopping)
+		return aBytes;
+
+	// share the global limit evenly between the transfers
+	auto& globalBucket = global.get()->*aBucket;
+	if(globalBucket.isLimited() && aTransfers > 0) {
+		aBytes = min(aBytes, max(globalBucket.getBurst() / static_cast<int64_t>(aTransfers), static_cast<int64_t>(MIN_SLICE)));
+	}
+
+	auto tick = GET_TICK();
+	for(auto l = aLimiter; l; l = l->parent.get()) {
+		auto& b = l->*aBucket;
+		if(!b.isLimited())
+			continue;
+
+		auto n = b.take(aBytes, tick);
+		if(n < aBytes) {
+			release(aLimiter, aBucket, aBytes - n, l);
+		}
+
+		if(n == 0) {
+			// no tokens, wait for them (no need to hold any locks)
+			auto wait = max(min(b.getWaitTime(min(aBytes, static_cast<int64_t>(MIN_SLICE))), static_cast<uint64_t>(MAX_WAIT)), static_cast<uint64_t>(1));
+			if(aWait_) {
+				*aWait_ = wait;
+			} else {
+				Thread::sleep(static_cast<uint32_t>(wait));
+			}
+			return 0;
 		}
+
+		aBytes = n;
 	}
 
-	if(readSize != -1)
-	{
-		Thread::yield(); // give a chance to other transfers to get a token
-		return readSize;
+	return aBytes;
+}
+
+void ThrottleManager::release(Limiter* aLimiter, Bucket Limiter::*aBucket, int64_t aBytes, const Limiter* aEnd) noexcept
+{
+	for(auto l = aLimiter; l != aEnd; l = l->parent.get()) {
+		auto& b = l->*aBucket;
+		if(b.isLimited())
+			b.giveBack(aBytes);
 	}
+}
+
+/*
+ * Throttles traffic and reads a packet from the network
+ */
+int ThrottleManager::read(Socket* sock, Limiter* aLimiter, void* buffer, size_t len, uint64_t* aWait_)
+{
+	auto tokens = acquire(aLimiter, &Limiter::down, DownloadManager::getInstance()->getDownloadCount(), len, aWait_);
+	if(tokens == 0)
+		return -1;	// from BufferedSocket: -1 = retry, 0 = connection close
 
-	waitToken();
-	return -1;	// from BufferedSocket: -1 = retry, 0 = connection close
+	int readSize = sock->read(buffer, static_cast<int>(tokens));
+	if(readSize < tokens)
+		release(aLimiter, &Limiter::down, tokens - max(readSize, 0));
+
+	return readSize;
 }
 
 /*
  * Throttles traffic and writes a packet to the network
  * Handle this a little bit differently than downloads due to OpenSSL stupidity 
  */
-int ThrottleManager::write(Socket* sock, void* buffer, size_t& len)
+int ThrottleManager::write(Socket* sock, Limiter* aLimiter, void* buffer, size_t& len, uint64_t* aWait_)
 {
-	bool gotToken = false;
-	size_t ups = UploadManager::getInstance()->getUploadCount();
-	auto upLimit = getUpLimit(); // avoid even intra-function races
-	if(!getCurThrottling() || upLimit == 0 || ups == 0)
-		return sock->write(buffer, len);
+	auto tokens = acquire(aLimiter, &Limiter::up, UploadManager::getInstance()->getUploadCount(), len, aWait_);
+	if(tokens == 0)
+		return 0;	// from BufferedSocket: -1 = failed, 0 = retry
 
-	{
-		Lock l(upCS);
+	// the same amount of data must be written again if this fails so the tokens are kept for that
+	len = static_cast<size_t>(tokens);
+	int sent = sock->write(buffer, static_cast<int>(len));
+	if(sent >= 0 && sent < tokens)
+		release(aLimiter, &Limiter::up, tokens - sent);
 
-		if(upTokens > 0)
-		{
-			size_t slice = (upLimit * 1024) / ups;
-			len = min(slice, min(len, static_cast<size_t>(upTokens)));
-			upTokens -= len;
+	return sent;
+}
 
-			gotToken = true; // token successfuly assigned
-		}
+#ifdef HAVE_SOCKET_SENDFILE
+/*
+ * Throttles traffic and sends a part of the file to the network without copying it
+ */
+int ThrottleManager::sendFile(Socket* sock, Limiter* aLimiter, File& aFile, size_t& len, uint64_t* aWait_)
+{
+	auto tokens = acquire(aLimiter, &Limiter::up, UploadManager::getInstance()->getUploadCount(), len, aWait_);
+	if(tokens == 0)
+		return 0;
+
+	len = static_cast<size_t>(tokens);
+	int sent = sock->sendFile(aFile, len);
+	if(sent < tokens)
+		release(aLimiter, &Limiter::up, tokens - max(sent, 0));
+
+	return sent;
+}
+#endif
+
+ThrottleManager::LimiterPtr ThrottleManager::getLimiter(const string& aHubUrl, const UserPtr& aUser) noexcept
+{
+	Lock l(cs);
+	auto& hub = hubs[aHubUrl];
+	auto hubLimiter = hub.limiter.lock();
+	if(!hubLimiter) {
+		hubLimiter = make_shared<Limiter>(global);
+		hubLimiter->up.setRate(static_cast<int64_t>(hub.upLimit) * 1024);
+		hubLimiter->down.setRate(static_cast<int64_t>(hub.downLimit) * 1024);
+		hub.limiter = hubLimiter;
 	}
 
-	if(gotToken)
-	{
-		// write to socket			
-		int sent = sock->write(buffer, len);
+	auto& user = hub.users[aUser];
+	auto userLimiter = user.lock();
+	if(!userLimiter) {
+		userLimiter = make_shared<Limiter>(hubLimiter);
+		userLimiter->up.setRate(static_cast<int64_t>(SETTING(MAX_UPLOAD_SPEED_USER)) * 1024);
+		userLimiter->down.setRate(static_cast<int64_t>(SETTING(MAX_DOWNLOAD_SPEED_USER)) * 1024);
+		user = userLimiter;
+	}
 
-		Thread::yield(); // give a chance to other transfers get a token
-		return sent;
+	return userLimiter;
+}
+
+void ThrottleManager::setHubLimits(const string& aHubUrl, int aUpLimit, int aDownLimit) noexcept
+{
+	Lock l(cs);
+	auto& hub = hubs[aHubUrl];
+	hub.upLimit = max(aUpLimit, 0);
+	hub.downLimit = max(aDownLimit, 0);
+
+	auto hubLimiter = hub.limiter.lock();
+	if(hubLimiter) {
+		hubLimiter->up.setRate(static_cast<int64_t>(hub.upLimit) * 1024);
+		hubLimiter->down.setRate(static_cast<int64_t>(hub.downLimit) * 1024);
 	}
+}
+
+void ThrottleManager::updateLimits() noexcept
+{
+	global->up.setRate(static_cast<int64_t>(getUpLimit()) * 1024);
+	global->down.setRate(static_cast<int64_t>(getDownLimit()) * 1024);
+
+	auto userUp = static_cast<int64_t>(SETTING(MAX_UPLOAD_SPEED_USER)) * 1024;
+	auto userDown = static_cast<int64_t>(SETTING(MAX_DOWNLOAD_SPEED_USER)) * 1024;
+
+	Lock l(cs);
+	for(auto i = hubs.begin(); i != hubs.end();) {
+		auto& hub = i->second;
+		for(auto u = hub.users.begin(); u != hub.users.end();) {
+			auto userLimiter = u->second.lock();
+			if(!userLimiter) {
+				u = hub.users.erase(u);
+				continue;
+			}
+
+			userLimiter->up.setRate(userUp);
+			userLimiter->down.setRate(userDown);
+			++u;
+		}
 
-	waitToken();
-	return 0;	// from BufferedSocket: -1 = failed, 0 = retry
+		if(hub.limiter.expired() && hub.upLimit == 0 && hub.downLimit == 0) {
+			i = hubs.erase(i);
+		} else {
+			++i;
+		}
+	}
 }
 
 SettingsManager::IntSetting ThrottleManager::getCurSetting(SettingsManager::IntSetting setting) {
@@ -155,27 +301,6 @@ void ThrottleManager::setSetting(SettingsManager::IntSetting setting, int value)
 	ClientManager::getInstance()->infoUpdated();
 }
 
-bool ThrottleManager::getCurThrottling() {
-	Lock l(stateCS);
-	return activeWaiter != -1;
-}
-
-void ThrottleManager::waitToken() {
-	// no tokens, wait for them, so long as throttling still active
-	// avoid keeping stateCS lock on whole function
-	CriticalSection *curCS = 0;
-	{
-		Lock l(stateCS);
-		if (activeWaiter != -1)
-			curCS = &waitCS[activeWaiter];
-	}
-	// possible post-CS aW shifts: 0->1/1->0: lock lands in wrong place, will
-	// either fall through immediately or wait depending on whether in
-	// stateCS-protected transition elsewhere; 0/1-> -1: falls through. Both harmless.
-	if (curCS)
-		Lock l(*curCS);
-}
-
 ThrottleManager::~ThrottleManager(void)
 {
 	shutdown();
@@ -183,11 +308,7 @@ ThrottleManager::~ThrottleManager(void)
 }
 
 void ThrottleManager::shutdown() {
-	Lock l(stateCS);
-	if (activeWaiter != -1) {
-		waitCS[activeWaiter].unlock();
-		activeWaiter = -1;
-	}
+	stopping = true;
 }
 
 // TimerManagerListener
@@ -198,36 +319,8 @@ void ThrottleManager::on(TimerManagerListener::Second, uint64_t /* aTick */) noe
 	//	setSetting(SettingsManager::SLOTS, newSlots);
 	//}
 
-	{
-		Lock l(stateCS);
-		if (activeWaiter == -1)
-			// This will create slight weirdness for the read/write calls between
-			// here and the first activeWaiter-toggle below.
-			waitCS[activeWaiter = 0].lock();
-	}
-
-	// readd tokens
-	{
-		Lock l(downCS);
-		downTokens = getDownLimit() * 1024;
-	}
-
-	{
-		Lock l(upCS);
-		upTokens = getUpLimit() * 1024;
-	}
-
-	// let existing events drain out (fairness).
-	// www.cse.wustl.edu/~schmidt/win32-cv-1.html documents various
-	// fairer strategies, but when only broadcasting, irrelevant
-	{
-		Lock l(stateCS);
-
-		dcassert(activeWaiter == 0 || activeWaiter == 1);
-		waitCS[1-activeWaiter].lock();
-		activeWaiter = 1-activeWaiter;
-		waitCS[1-activeWaiter].unlock();
-	}
+	// the tokens are refilled when they are taken, only pick up the changed limits here
+	updateLimits();
 }
 
 }	// namespace dcpp
@@ -23,28 +23,92 @@
 #include "Socket.h"
 #include "TimerManager.h"
 #include "SettingsManager.h"
+#include "User.h"
+#include "atomic.h"
 
 namespace dcpp
 {
 	/**
 	 * Manager for throttling traffic flow.
 	 * Inspired by Token Bucket algorithm: http://en.wikipedia.org/wiki/Token_bucket
+	 *
+	 * The limits are hierarchical: all throttled transfers share the global buckets, the
+	 * connections of a hub share the hub's buckets and the connections of a user share the
+	 * user's buckets. The buckets are refilled based on the time elapsed since the previous
+	 * refill and the tokens are taken without locking, so the traffic is spread evenly
+	 * instead of being released once per second.
 	 */
 	class ThrottleManager :
 		public Singleton<ThrottleManager>, private TimerManagerListener
 	{
 	public:
+		/** Token bucket that can be used from several threads at once */
+		class Bucket {
+		public:
+			Bucket() : tokens(0), rate(0), lastRefill(0) { }
+
+			/* Bytes per second, 0 = unlimited */
+			void setRate(int64_t aRate) noexcept { rate = aRate; }
+			bool isLimited() const noexcept { return rate > 0; }
+			/* The maximum number of tokens that can be stored */
+			int64_t getBurst() const noexcept;
+
+			/* Takes up to aBytes tokens, returns the number of tokens taken */
+			int64_t take(int64_t aBytes, uint64_t aTick) noexcept;
+			void giveBack(int64_t aBytes) noexcept { tokens += aBytes * 1000; }
+			/* Milliseconds until aBytes tokens are available */
+			uint64_t getWaitTime(int64_t aBytes) const noexcept;
+		private:
+			void refill(uint64_t aTick) noexcept;
+
+			// in thousandths of a byte so that refilling every millisecond doesn't lose precision
+			atomic<int64_t> tokens;
+			atomic<int64_t> rate;
+			atomic<uint64_t> lastRefill;
+		};
+
+		/** Traffic class */
+		class Limiter {
+		public:
+			Limiter(const shared_ptr<Limiter>& aParent) : parent(aParent) { }
+
+			Bucket up;
+			Bucket down;
+			const shared_ptr<Limiter> parent;
+		};
+
+		typedef shared_ptr<Limiter> LimiterPtr;
+
+		/*
+		 * Returns the traffic class for the connections of a user
+		 */
+		LimiterPtr getLimiter(const string& aHubUrl, const UserPtr& aUser) noexcept;
+
+		/*
+		 * Sets the limits for the connections of a hub (KiB/s, 0 = unlimited)
+		 */
+		void setHubLimits(const string& aHubUrl, int aUpLimit, int aDownLimit) noexcept;
 
 		/*
 		 * Throttles traffic and reads a packet from the network
+		 * When there are no tokens, the call sleeps until they are available unless aWait_ is given,
+		 * in which case it returns immediately and sets aWait_ to the milliseconds to wait instead.
+		 * This applies to all the calls below.
 		 */
-		int read(Socket* sock, void* buffer, size_t len);
+		int read(Socket* sock, Limiter* aLimiter, void* buffer, size_t len, uint64_t* aWait_ = nullptr);
 
 		/*
 		 * Throttles traffic and writes a packet to the network
 		 * Handle this a little bit differently than downloads due to OpenSSL stupidity 
 		 */
-		int write(Socket* sock, void* buffer, size_t& len);
+		int write(Socket* sock, Limiter* aLimiter, void* buffer, size_t& len, uint64_t* aWait_ = nullptr);
+
+#ifdef HAVE_SOCKET_SENDFILE
+		/*
+		 * Throttles traffic and sends a part of the file to the network without copying it
+		 */
+		int sendFile(Socket* sock, Limiter* aLimiter, File& aFile, size_t& len, uint64_t* aWait_ = nullptr);
+#endif
 
 		void shutdown();
 
@@ -58,30 +122,38 @@ namespace dcpp
 		static const int MAX_LIMIT = 1024 * 1024; // 1 GiB/s
 
 	private:
-		// stack up throttled read & write threads
-		CriticalSection stateCS;
-		CriticalSection waitCS[2];
-		long activeWaiter;
-
-		// download limiter
-		CriticalSection	downCS;
-		int64_t			downTokens;
-
-		// upload limiter
-		CriticalSection	upCS;
-		int64_t			upTokens;
+		enum {
+			/** Milliseconds of traffic that the buckets can store */
+			BURST_TIME = 100,
+			/** The smallest packet that is worth sending */
+			MIN_SLICE = 4096,
+			/** The maximum time to sleep before retrying */
+			MAX_WAIT = 50
+		};
+
+		struct HubClass {
+			int upLimit = 0;
+			int downLimit = 0;
+			weak_ptr<Limiter> limiter;
+			unordered_map<UserPtr, weak_ptr<Limiter>, User::Hash> users;
+		};
+
+		CriticalSection cs;
+		unordered_map<string, HubClass> hubs;
+		const LimiterPtr global;
+		atomic<bool> stopping;
 
 		friend class Singleton<ThrottleManager>;
 
-		ThrottleManager() : activeWaiter(-1), downTokens(0), upTokens(0)
-		{
-			TimerManager::getInstance()->addListener(this);
-		}
-
+		ThrottleManager();
 		virtual ~ThrottleManager();
 
-		bool getCurThrottling();
-		void waitToken();
+		/* Takes tokens from all levels, returns 0 after waiting (or setting aWait_) if there weren't any */
+		int64_t acquire(Limiter* aLimiter, Bucket Limiter::*aBucket, size_t aTransfers, int64_t aBytes, uint64_t* aWait_) noexcept;
+		/* Returns unused tokens to the levels below aEnd */
+		static void release(Limiter* aLimiter, Bucket Limiter::*aBucket, int64_t aBytes, const Limiter* aEnd = nullptr) noexcept;
+
+		void updateLimits() noexcept;
 
 		// TimerManagerListener
 		void on(TimerManagerListener::Second, uint64_t /* aTick */) noexcept;
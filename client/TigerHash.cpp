@@ -249,6 +249,143 @@ uint8_t* TigerHash::finalize() {
 	return getResult();
 }
 
+#ifndef TIGER_BIG_ENDIAN
+
+/* The rounds of two compress functions interleaved. The lanes use separate variables so that everything stays in registers. */
+#define round2(a,b,c,x,a2,b2,c2,y,mul) \
+	c ^= x; \
+	c2 ^= y; \
+	a -= t1[((c)>>(0*8))&0xFF] ^ t2[((c)>>(2*8))&0xFF] ^ \
+	     t3[((c)>>(4*8))&0xFF] ^ t4[((c)>>(6*8))&0xFF] ; \
+	a2 -= t1[((c2)>>(0*8))&0xFF] ^ t2[((c2)>>(2*8))&0xFF] ^ \
+	      t3[((c2)>>(4*8))&0xFF] ^ t4[((c2)>>(6*8))&0xFF] ; \
+	b += t4[((c)>>(1*8))&0xFF] ^ t3[((c)>>(3*8))&0xFF] ^ \
+	     t2[((c)>>(5*8))&0xFF] ^ t1[((c)>>(7*8))&0xFF] ; \
+	b2 += t4[((c2)>>(1*8))&0xFF] ^ t3[((c2)>>(3*8))&0xFF] ^ \
+	      t2[((c2)>>(5*8))&0xFF] ^ t1[((c2)>>(7*8))&0xFF] ; \
+	b *= mul; \
+	b2 *= mul;
+
+#define pass2(a,b,c,a2,b2,c2,mul) \
+	round2(a,b,c,x0,a2,b2,c2,y0,mul) \
+	round2(b,c,a,x1,b2,c2,a2,y1,mul) \
+	round2(c,a,b,x2,c2,a2,b2,y2,mul) \
+	round2(a,b,c,x3,a2,b2,c2,y3,mul) \
+	round2(b,c,a,x4,b2,c2,a2,y4,mul) \
+	round2(c,a,b,x5,c2,a2,b2,y5,mul) \
+	round2(a,b,c,x6,a2,b2,c2,y6,mul) \
+	round2(b,c,a,x7,b2,c2,a2,y7,mul)
+
+#define key_schedule2 \
+	key_schedule \
+	y0 -= y7 ^ _ULL(0xA5A5A5A5A5A5A5A5); \
+	y1 ^= y0; \
+	y2 += y1; \
+	y3 -= y2 ^ ((~y1)<<19); \
+	y4 ^= y3; \
+	y5 += y4; \
+	y6 -= y5 ^ ((~y4)>>23); \
+	y7 ^= y6; \
+	y0 += y7; \
+	y1 -= y0 ^ ((~y7)<<19); \
+	y2 ^= y1; \
+	y3 += y2; \
+	y4 -= y3 ^ ((~y2)>>23); \
+	y5 ^= y4; \
+	y6 += y5; \
+	y7 -= y6 ^ _ULL(0x0123456789ABCDEF);
+
+/* Same as tiger_compress_macro with PASSES == 3 for two blocks */
+void TigerHash::tigerCompress2(const uint64_t* str, const uint64_t* str2, uint64_t state[3], uint64_t state2[3]) {
+	uint64_t a = state[0], b = state[1], c = state[2];
+	uint64_t a2 = state2[0], b2 = state2[1], c2 = state2[2];
+	uint64_t x0=str[0], x1=str[1], x2=str[2], x3=str[3], x4=str[4], x5=str[5], x6=str[6], x7=str[7];
+	uint64_t y0=str2[0], y1=str2[1], y2=str2[2], y3=str2[3], y4=str2[4], y5=str2[5], y6=str2[6], y7=str2[7];
+
+	pass2(a,b,c,a2,b2,c2,5)
+	key_schedule2
+	pass2(c,a,b,c2,a2,b2,7)
+	key_schedule2
+	pass2(b,c,a,b2,c2,a2,9)
+
+	state[0] ^= a;
+	state[1] = b - state[1];
+	state[2] += c;
+	state2[0] ^= a2;
+	state2[1] = b2 - state2[1];
+	state2[2] += c2;
+}
+
+void TigerHash::hashLanes(uint8_t aPrefix, const uint8_t* const* aData, size_t aLen, uint8_t* aResults) {
+	static_assert(PASSES == 3 && LANES == 2, "Unsupported lane configuration");
+
+	uint64_t state[LANES][3];
+	for(size_t l = 0; l < LANES; ++l) {
+		state[l][0] = _ULL(0x0123456789ABCDEF);
+		state[l][1] = _ULL(0xFEDCBA9876543210);
+		state[l][2] = _ULL(0xF096A5B4C3B2E187);
+	}
+
+	// the prefix shifts the data by one byte so it needs to be copied to aligned blocks in any case
+	const uint64_t len = aLen + 1;
+	uint64_t blocks[LANES][BLOCK_SIZE / 8];
+
+	size_t pos = 0;
+	for(; pos + BLOCK_SIZE <= len; pos += BLOCK_SIZE) {
+		for(size_t l = 0; l < LANES; ++l) {
+			if(pos == 0) {
+				((uint8_t*)blocks[l])[0] = aPrefix;
+				memcpy((uint8_t*)blocks[l] + 1, aData[l], BLOCK_SIZE - 1);
+			} else {
+				memcpy(blocks[l], aData[l] + pos - 1, BLOCK_SIZE);
+			}
+		}
+		tigerCompress2(blocks[0], blocks[1], state[0], state[1]);
+	}
+
+	// padding, see finalize
+	size_t tmppos = static_cast<size_t>(len - pos);
+	bool extraBlock = tmppos + 1 > BLOCK_SIZE - sizeof(uint64_t);
+	for(size_t l = 0; l < LANES; ++l) {
+		uint8_t* tmp = (uint8_t*)blocks[l];
+		if(pos == 0) {
+			tmp[0] = aPrefix;
+			memcpy(tmp + 1, aData[l], tmppos - 1);
+		} else {
+			memcpy(tmp, aData[l] + pos - 1, tmppos);
+		}
+		tmp[tmppos] = 0x01;
+		memzero(tmp + tmppos + 1, BLOCK_SIZE - tmppos - 1);
+		if(!extraBlock)
+			blocks[l][7] = len << 3;
+	}
+	tigerCompress2(blocks[0], blocks[1], state[0], state[1]);
+
+	if(extraBlock) {
+		memzero(blocks, sizeof(blocks));
+		for(size_t l = 0; l < LANES; ++l)
+			blocks[l][7] = len << 3;
+		tigerCompress2(blocks[0], blocks[1], state[0], state[1]);
+	}
+
+	for(size_t l = 0; l < LANES; ++l) {
+		memcpy(aResults + l * BYTES, state[l], BYTES);
+	}
+}
+
+#else
+
+void TigerHash::hashLanes(uint8_t aPrefix, const uint8_t* const* aData, size_t aLen, uint8_t* aResults) {
+	for(size_t l = 0; l < LANES; ++l) {
+		TigerHash h;
+		h.update(&aPrefix, 1);
+		h.update(aData[l], aLen);
+		memcpy(aResults + l * BYTES, h.finalize(), BYTES);
+	}
+}
+
+#endif
+
 uint64_t TigerHash::table[4*256] = {
 	_ULL(0x02AAB17CF7E90C5E)   /*    0 */,    _ULL(0xAC424B03E243A8EC)   /*    1 */,
 		_ULL(0x72CD5BE30DD5FCD3)   /*    2 */,    _ULL(0x6D019B93F6F97F3A)   /*    3 */,
@@ -57,6 +57,18 @@ public:
 	uint8_t* finalize();
 
 	uint8_t* getResult() { return (uint8_t*) res; }
+
+	/** Number of messages hashed at once by hashLanes */
+	static const size_t LANES = 2;
+
+	/**
+	 * Calculates the Tiger hashes of LANES messages of equal length, each consisting of
+	 * aPrefix followed by aLen bytes of aData. The rounds of the independent messages
+	 * are interleaved, which keeps more S-box lookups in flight than hashing them one by one
+	 * (each Tiger round waits for the lookups of the previous one).
+	 * @param aResults LANES * BYTES bytes for the hashes
+	 */
+	static void hashLanes(uint8_t aPrefix, const uint8_t* const* aData, size_t aLen, uint8_t* aResults);
 private:
 	enum { BLOCK_SIZE = 512/8 };
 	/** 512 bit blocks for the compress function */
@@ -69,6 +81,7 @@ private:
 	static uint64_t table[];
 
 	void tigerCompress(const uint64_t* data, uint64_t state[3]);
+	static void tigerCompress2(const uint64_t* str, const uint64_t* str2, uint64_t state[3], uint64_t state2[3]);
 };
 
 } // namespace dcpp
@@ -41,6 +41,7 @@ void UDPServer::listen() {
 		socket->setLocalIp6(CONNSETTING(BIND_ADDRESS6));
 		socket->setV4only(false);
 		port = socket->listen(Util::toString(CONNSETTING(UDP_PORT)));
+		listenTime = GET_TICK();
 		start();
 	} catch(...) {
 		socket.reset();
@@ -62,7 +63,7 @@ void UDPServer::disconnect() {
 	}
 }
 
-UDPServer::UDPServer() : stop(false), pp(true) { }
+UDPServer::UDPServer() : stop(false), pp(true), receivedPackets(0), receivedBatches(0), droppedPackets(0) { }
 UDPServer::~UDPServer() {
 	/*if(socket.get()) {
 		stop = true;
@@ -73,11 +74,26 @@ UDPServer::~UDPServer() {
 	}*/
 }
 
-#define BUFSIZE 8192
+UDPServer::PacketBatch::PacketBatch() {
+	for(int i = 0; i < Socket::MAX_BATCH; ++i) {
+		packets[i].buf = &data[i * BUFSIZE];
+		packets[i].bufLen = BUFSIZE;
+	}
+}
+
+UDPServer::PacketBatch* UDPServer::getFreeBatch() {
+	PacketBatch* batch = nullptr;
+	if(!freeBatches.try_pop(batch) && batches.size() < MAX_BATCHES) {
+		// only the reader thread allocates them
+		batches.emplace_back(new PacketBatch);
+		batch = batches.back().get();
+	}
+
+	return batch;
+}
+
 int UDPServer::run() {
-	uint8_t* buf = nullptr;
-	int len;
-	string remoteAddr;
+	unique_ptr<PacketBatch> dropBatch;
 
 	while(!stop) {
 		try {
@@ -85,13 +101,48 @@ int UDPServer::run() {
 				continue;
 			}
 
-			buf = new uint8_t[BUFSIZE];
-			if((len = socket->read(buf, BUFSIZE, remoteAddr)) > 0) {
-				pp.addTask([=] { handlePacket(buf, len, remoteAddr); });
-				continue;
+			// read everything that is available
+			int received = 0;
+			for(;;) {
+				auto batch = getFreeBatch();
+				if(!batch) {
+					// the packets can't be handled as fast as they arrive
+					if(!dropBatch)
+						dropBatch.reset(new PacketBatch);
+
+					auto dropped = socket->readBatch(dropBatch->packets, Socket::MAX_BATCH);
+					droppedPackets += dropped;
+					received += dropped;
+					if(dropped < Socket::MAX_BATCH)
+						break;
+					continue;
+				}
+
+				try {
+					batch->count = socket->readBatch(batch->packets, Socket::MAX_BATCH);
+				} catch(...) {
+					// don't lose the batch from the pool
+					freeBatches.push(batch);
+					throw;
+				}
+
+				if(batch->count == 0) {
+					freeBatches.push(batch);
+					break;
+				}
+
+				received += batch->count;
+				receivedPackets += batch->count;
+				receivedBatches++;
+				pp.addTask([=] { handleBatch(batch); });
+
+				if(batch->count < Socket::MAX_BATCH)
+					break;
 			}
 
-			delete buf;
+			if(received > 0) {
+				continue;
+			}
 		} catch(const SocketException& e) {
 			dcdebug("SearchManager::run Error: %s\n", e.getError().c_str());
 		}
@@ -125,6 +176,28 @@ int UDPServer::run() {
 	return 0;
 }
 
+string UDPServer::getStats() const {
+	auto packets = receivedPackets.load();
+	auto seconds = listenTime == 0 ? 0 : (GET_TICK() - listenTime) / 1000;
+
+	return boost::str(boost::format("Received packets: %d (%.1f per batch, %.1f/s), dropped: %d")
+		% packets
+		% (receivedBatches == 0 ? 0 : static_cast<double>(packets) / static_cast<double>(receivedBatches))
+		% (seconds == 0 ? 0 : static_cast<double>(packets) / static_cast<double>(seconds))
+		% droppedPackets);
+}
+
+void UDPServer::handleBatch(PacketBatch* aBatch) {
+	for(int i = 0; i < aBatch->count; ++i) {
+		const auto& p = aBatch->packets[i];
+		if(p.len > 0) {
+			handlePacket(p.buf, p.len, p.ip);
+		}
+	}
+
+	freeBatches.push(aBatch);
+}
+
 void UDPServer::handlePacket(uint8_t* aBuf, size_t aLen, const string& aRemoteIp) {
 	string x((char*) aBuf, aLen);
 
@@ -133,7 +206,6 @@ void UDPServer::handlePacket(uint8_t* aBuf, size_t aLen, const string& aRemoteIp
 		SearchManager::getInstance()->decryptPacket(x, aLen, aBuf, BUFSIZE);
 	}
 			
-	delete aBuf;
 	if (x.empty())
 		return;
 
@@ -21,6 +21,8 @@
 
 #include "DispatcherQueue.h"
 #include "Socket.h"
+#include "atomic.h"
+#include "concurrency.h"
 
 namespace dcpp {
 
@@ -32,14 +34,43 @@ public:
 	const string& getPort() const { return port; }
 	void disconnect();
 	void listen();
+
+	string getStats() const;
 private:
+	enum {
+		BUFSIZE = 8192,
+		/** Maximum number of batches waiting to be handled */
+		MAX_BATCHES = 8
+	};
+
+	/** Datagrams read with a single call, handled together in the dispatcher thread */
+	struct PacketBatch {
+		PacketBatch();
+
+		uint8_t data[Socket::MAX_BATCH * BUFSIZE];
+		Socket::Datagram packets[Socket::MAX_BATCH];
+		int count = 0;
+	};
+
 	virtual int run();
 
 	std::unique_ptr<Socket> socket;
 	string port;
 	bool stop;
 
+	// destroyed after the dispatcher thread has stopped
+	vector<unique_ptr<PacketBatch>> batches;
+	concurrent_queue<PacketBatch*> freeBatches;
+	PacketBatch* getFreeBatch();
+
 	DispatcherQueue pp;
+
+	atomic<uint64_t> receivedPackets;
+	atomic<uint64_t> receivedBatches;
+	atomic<uint64_t> droppedPackets;
+	uint64_t listenTime = 0;
+
+	void handleBatch(PacketBatch* aBatch);
 	void handlePacket(uint8_t* aBuf, size_t aLen, const string& aRemoteIp);
 };
 
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+#include "UploadCache.h"
+
+#include "SettingsManager.h"
+#include "Streams.h"
+
+namespace dcpp {
+
+/** File that is uploaded directly, only keeps count of the readers */
+class UploadCache::DirectFile : public File {
+public:
+	DirectFile(UploadCache& aCache, const FileId& aId) : File(aId.path, File::READ, File::OPEN | File::SHARED_WRITE), cache(aCache), id(aId) {
+		cache.addReader(id);
+	}
+
+	~DirectFile() {
+		cache.removeReader(id);
+	}
+private:
+	UploadCache& cache;
+	const FileId id;
+};
+
+class UploadCache::CachedStream : public InputStream {
+public:
+	CachedStream(UploadCache& aCache, const FileId& aId, int64_t aPos) : cache(aCache), file(aCache.getSharedFile(aId)), id(aId), pos(aPos) {
+		cache.addReader(id);
+	}
+
+	~CachedStream() {
+		cache.removeReader(id);
+	}
+
+	size_t read(void* buf, size_t& len) {
+		auto index = pos / BLOCK_SIZE;
+		if(!block || index != blockIndex) {
+			if(pos >= file->size) {
+				len = 0;
+				return 0;
+			}
+
+			block = cache.getBlock(file, BlockKey(id, index));
+			blockIndex = index;
+
+			for(int64_t i = index + 1; i <= index + READ_AHEAD && i * BLOCK_SIZE < file->size; ++i) {
+				cache.readAhead(file, BlockKey(id, i));
+			}
+		}
+
+		auto offset = static_cast<size_t>(pos - index * BLOCK_SIZE);
+		if(offset >= block->size()) {
+			// end of file
+			len = 0;
+			return 0;
+		}
+
+		len = min(len, block->size() - offset);
+		memcpy(buf, &(*block)[offset], len);
+		pos += len;
+		return len;
+	}
+
+	void setPos(int64_t aPos) noexcept {
+		pos = aPos;
+	}
+private:
+	UploadCache& cache;
+	SharedFilePtr file;
+	const FileId id;
+	int64_t pos;
+
+	BlockPtr block;
+	int64_t blockIndex = -1;
+};
+
+UploadCache::UploadCache() {
+	start();
+}
+
+UploadCache::~UploadCache() {
+	{
+		Lock l(cs);
+		stopping = true;
+	}
+
+	readAheadSem.signal();
+	join();
+}
+
+unique_ptr<InputStream> UploadCache::open(const string& aPath, int64_t aStartPos) {
+	FileId id(aPath, File::getLastModified(aPath));
+	if(SETTING(UPLOAD_CACHE_SIZE) > 0) {
+		bool shared = false;
+		{
+			Lock l(cs);
+			shared = readers.find(id) != readers.end() || blocks.find(BlockKey(id, aStartPos / BLOCK_SIZE)) != blocks.end();
+		}
+
+		if(shared) {
+			return unique_ptr<InputStream>(new CachedStream(*this, id, aStartPos));
+		}
+	}
+
+	unique_ptr<File> f(new DirectFile(*this, id));
+	f->setPos(aStartPos);
+	return f;
+}
+
+UploadCache::Stats UploadCache::getStats() const noexcept {
+	Lock l(cs);
+
+	Stats ret;
+	ret.hits = hits;
+	ret.misses = misses;
+	ret.bytesSaved = bytesSaved;
+	ret.cacheSize = cacheSize;
+	return ret;
+}
+
+void UploadCache::addReader(const FileId& aId) noexcept {
+	Lock l(cs);
+	readers[aId].count++;
+}
+
+void UploadCache::removeReader(const FileId& aId) noexcept {
+	Lock l(cs);
+	auto i = readers.find(aId);
+	if(i != readers.end() && --i->second.count <= 0) {
+		readers.erase(i);
+	}
+}
+
+UploadCache::SharedFilePtr UploadCache::getSharedFile(const FileId& aId) {
+	{
+		Lock l(cs);
+		auto i = readers.find(aId);
+		if(i != readers.end() && i->second.file) {
+			return i->second.file;
+		}
+	}
+
+	// open it without holding the lock
+	auto f = make_shared<SharedFile>(aId.path);
+
+	Lock l(cs);
+	auto& r = readers[aId];
+	if(!r.file) {
+		r.file = f;
+	}
+	return r.file;
+}
+
+UploadCache::BlockPtr UploadCache::findBlock(const BlockKey& aKey) noexcept {
+	Lock l(cs);
+	auto i = blocks.find(aKey);
+	if(i == blocks.end()) {
+		return nullptr;
+	}
+
+	lru.splice(lru.begin(), lru, i->second.lruPos);
+	return i->second.data;
+}
+
+UploadCache::BlockPtr UploadCache::useBlock(const BlockKey& aKey) noexcept {
+	Lock l(cs);
+	auto i = blocks.find(aKey);
+	if(i == blocks.end()) {
+		return nullptr;
+	}
+
+	lru.splice(lru.begin(), lru, i->second.lruPos);
+
+	auto& b = i->second;
+	if(b.used) {
+		hits++;
+		bytesSaved += b.data->size();
+	} else {
+		// read ahead for this reader, the disk read wasn't saved
+		b.used = true;
+		misses++;
+	}
+
+	return b.data;
+}
+
+UploadCache::BlockPtr UploadCache::readBlock(SharedFile& aFile, const BlockKey& aKey) {
+	// always called with the file locked
+	auto start = aKey.index * BLOCK_SIZE;
+	auto data = make_shared<ByteVector>(static_cast<size_t>(max(min(static_cast<int64_t>(BLOCK_SIZE), aFile.size - start), static_cast<int64_t>(0))));
+
+	aFile.file.setPos(start);
+
+	size_t pos = 0;
+	while(pos < data->size()) {
+		size_t len = data->size() - pos;
+		if(aFile.file.read(&(*data)[pos], len) == 0) {
+			break;
+		}
+
+		pos += len;
+	}
+
+	data->resize(pos);
+	return data;
+}
+
+UploadCache::BlockPtr UploadCache::addBlock(const BlockKey& aKey, const BlockPtr& aData, bool aUsed) noexcept {
+	auto maxSize = static_cast<int64_t>(SETTING(UPLOAD_CACHE_SIZE)) * 1024 * 1024;
+
+	Lock l(cs);
+	auto i = blocks.find(aKey);
+	if(i != blocks.end()) {
+		return i->second.data;
+	}
+
+	lru.push_front(aKey);
+	blocks.emplace(aKey, Block { aData, lru.begin(), aUsed });
+	cacheSize += aData->size();
+
+	// keep the new block even if the cache is smaller than that
+	while(cacheSize > maxSize && lru.size() > 1) {
+		auto b = blocks.find(lru.back());
+		cacheSize -= b->second.data->size();
+		blocks.erase(b);
+		lru.pop_back();
+	}
+
+	return aData;
+}
+
+UploadCache::BlockPtr UploadCache::getBlock(const SharedFilePtr& aFile, const BlockKey& aKey) {
+	auto b = useBlock(aKey);
+	if(!b) {
+		Lock fl(aFile->cs);
+
+		// the read-ahead thread may have read it while we were waiting for the file
+		b = useBlock(aKey);
+		if(!b) {
+			b = addBlock(aKey, readBlock(*aFile, aKey), true);
+
+			Lock l(cs);
+			misses++;
+		}
+	}
+
+	return b;
+}
+
+void UploadCache::readAhead(const SharedFilePtr& aFile, const BlockKey& aKey) noexcept {
+	{
+		Lock l(cs);
+		if(blocks.find(aKey) != blocks.end())
+			return;
+
+		if(find_if(readAheadQueue.begin(), readAheadQueue.end(), [&aKey](const pair<SharedFilePtr, BlockKey>& p) { return p.second == aKey; }) != readAheadQueue.end())
+			return;
+
+		readAheadQueue.emplace_back(aFile, aKey);
+	}
+
+	readAheadSem.signal();
+}
+
+int UploadCache::run() {
+	for(;;) {
+		readAheadSem.wait();
+
+		SharedFilePtr f;
+		BlockKey key(FileId(Util::emptyString, 0), 0);
+		{
+			Lock l(cs);
+			if(stopping)
+				break;
+
+			if(readAheadQueue.empty())
+				continue;
+
+			f = move(readAheadQueue.front().first);
+			key = readAheadQueue.front().second;
+			readAheadQueue.pop_front();
+		}
+
+		try {
+			Lock fl(f->cs);
+			if(!findBlock(key)) {
+				addBlock(key, readBlock(*f, key), false);
+			}
+		} catch(const FileException& e) {
+			dcdebug("UploadCache: failed to read ahead (%s)\n", e.getError().c_str());
+		}
+	}
+
+	return 0;
+}
+
+} // namespace dcpp
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_UPLOAD_CACHE_H
+#define DCPLUSPLUS_DCPP_UPLOAD_CACHE_H
+
+#include <deque>
+#include <list>
+
+#include "typedefs.h"
+
+#include "CriticalSection.h"
+#include "File.h"
+#include "Semaphore.h"
+#include "Singleton.h"
+#include "Thread.h"
+
+namespace dcpp {
+
+/**
+* Cache of file blocks shared by the uploads of the same file.
+*
+* The first upload of a file is sent directly from the file. Uploads that start while the
+* same file is being uploaded to someone else are read through the cache so that the disk only
+* needs to serve a single sequential stream for them. The following blocks are read ahead by a
+* background thread and the least recently used blocks are dropped when the cache is full.
+*/
+class UploadCache : public Singleton<UploadCache>, private Thread {
+public:
+	enum {
+		BLOCK_SIZE = 1024*1024,
+		READ_AHEAD = 2
+	};
+
+	UploadCache();
+	~UploadCache();
+
+	/**
+	* Opens a stream for uploading the file from aStartPos
+	* @throw FileException
+	*/
+	unique_ptr<InputStream> open(const string& aPath, int64_t aStartPos);
+
+	/** Hits are the blocks that were served without reading them from the disk again */
+	struct Stats {
+		int64_t hits = 0;
+		int64_t misses = 0;
+		int64_t bytesSaved = 0;
+		int64_t cacheSize = 0;
+	};
+
+	Stats getStats() const noexcept;
+private:
+	class DirectFile;
+	class CachedStream;
+
+	/** File shared by the cached readers and the read-ahead thread */
+	struct SharedFile {
+		SharedFile(const string& aPath) : file(aPath, File::READ, File::OPEN | File::SHARED_WRITE), size(file.getSize()) { }
+
+		CriticalSection cs;
+		File file;
+		const int64_t size;
+	};
+
+	typedef shared_ptr<SharedFile> SharedFilePtr;
+	typedef shared_ptr<const ByteVector> BlockPtr;
+
+	/** The modification time is included so that blocks of replaced files won't be used */
+	struct FileId {
+		FileId(const string& aPath, uint64_t aModified) : path(aPath), modified(aModified) { }
+		bool operator==(const FileId& rhs) const { return modified == rhs.modified && path == rhs.path; }
+
+		string path;
+		uint64_t modified;
+	};
+
+	struct FileIdHash {
+		size_t operator()(const FileId& aId) const { return std::hash<string>()(aId.path) ^ static_cast<size_t>(aId.modified); }
+	};
+
+	struct BlockKey {
+		BlockKey(const FileId& aFile, int64_t aIndex) : file(aFile), index(aIndex) { }
+		bool operator==(const BlockKey& rhs) const { return index == rhs.index && file == rhs.file; }
+
+		FileId file;
+		int64_t index;
+	};
+
+	struct BlockKeyHash {
+		size_t operator()(const BlockKey& aKey) const { return FileIdHash()(aKey.file) ^ static_cast<size_t>(aKey.index * 0x9e3779b97f4a7c15ULL); }
+	};
+
+	struct Block {
+		BlockPtr data;
+		std::list<BlockKey>::iterator lruPos;
+
+		/** Whether the block has been served to a reader (read-ahead blocks aren't at first) */
+		bool used;
+	};
+
+	struct Reader {
+		int count = 0;
+		SharedFilePtr file;
+	};
+
+	int run();
+
+	void addReader(const FileId& aId) noexcept;
+	void removeReader(const FileId& aId) noexcept;
+	SharedFilePtr getSharedFile(const FileId& aId);
+
+	BlockPtr getBlock(const SharedFilePtr& aFile, const BlockKey& aKey);
+	BlockPtr findBlock(const BlockKey& aKey) noexcept;
+	BlockPtr useBlock(const BlockKey& aKey) noexcept;
+	BlockPtr addBlock(const BlockKey& aKey, const BlockPtr& aData, bool aUsed) noexcept;
+	static BlockPtr readBlock(SharedFile& aFile, const BlockKey& aKey);
+	void readAhead(const SharedFilePtr& aFile, const BlockKey& aKey) noexcept;
+
+	mutable CriticalSection cs;
+
+	unordered_map<FileId, Reader, FileIdHash> readers;
+
+	unordered_map<BlockKey, Block, BlockKeyHash> blocks;
+	/** Most recently used blocks first */
+	std::list<BlockKey> lru;
+	int64_t cacheSize = 0;
+
+	std::deque<pair<SharedFilePtr, BlockKey>> readAheadQueue;
+	Semaphore readAheadSem;
+	bool stopping = false;
+
+	int64_t hits = 0;
+	int64_t misses = 0;
+	int64_t bytesSaved = 0;
+};
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_DCPP_UPLOAD_CACHE_H)
@@ -33,6 +33,7 @@
 #include "ShareManager.h"
 #include "Upload.h"
 #include "UploadBundle.h"
+#include "UploadCache.h"
 #include "UserConnection.h"
 
 namespace dcpp {
@@ -294,10 +295,14 @@ checkslots:
 					fileSize = size = xml.size();
 				} else {
 					countFilePositions();
-					unique_ptr<File> f(new File(sourceFile, File::READ, File::OPEN | File::SHARED_WRITE)); // write for partial sharing
+					if (partialFileSharing) {
+						unique_ptr<File> f(new File(sourceFile, File::READ, File::OPEN | File::SHARED_WRITE)); // write for partial sharing
 			
-					f->setPos(start);
-					is = move(f);
+						f->setPos(start);
+						is = move(f);
+					} else {
+						is = UploadCache::getInstance()->open(sourceFile, start);
+					}
 					if((start + size) < fileSize) {
 						is.reset(new LimitedInputStream<true>(is.release(), size));
 					}
@@ -168,14 +168,29 @@ int64_t UserConnection::getChunkSize() const {
 
 void UserConnection::setUser(const UserPtr& aUser) {
 	user = aUser;
-	if (aUser && socket) {
-		socket->setUseLimiter(true);
-		if (aUser->isSet(User::FAVORITE)) {
-			auto u = FavoriteManager::getInstance()->getFavoriteUser(aUser);
+	updateLimiter();
+}
+
+void UserConnection::setHubUrl(const string& aHubUrl) {
+	if (hubUrl == aHubUrl)
+		return;
+
+	// the hub hint may be corrected after the user has been set
+	hubUrl = aHubUrl;
+	updateLimiter();
+}
+
+void UserConnection::updateLimiter() {
+	if (user && socket) {
+		bool useLimiter = true;
+		if (user->isSet(User::FAVORITE)) {
+			auto u = FavoriteManager::getInstance()->getFavoriteUser(user);
 			if (u) {
-				socket->setUseLimiter(!u->isSet(FavoriteUser::FLAG_SUPERUSER));
+				useLimiter = !u->isSet(FavoriteUser::FLAG_SUPERUSER);
 			}
 		}
+
+		socket->setLimiter(useLimiter ? ThrottleManager::getInstance()->getLimiter(hubUrl, user) : nullptr);
 	}
 }
 
@@ -184,7 +184,9 @@ public:
 	void updateChunkSize(int64_t leafSize, int64_t lastChunk, uint64_t ticks);
 	bool supportsTrees() const { return isSet(FLAG_SUPPORTS_TTHL); }
 	
-	GETSET(string, hubUrl, HubUrl);
+	const string& getHubUrl() const { return hubUrl; }
+	void setHubUrl(const string& aHubUrl);
+
 	GETSET(string, token, Token);
 	GETSET(string, lastBundle, LastBundle);
 	GETSET(int64_t, speed, Speed);
@@ -200,6 +202,7 @@ private:
 	BufferedSocket* socket;
 	bool secure;
 	UserPtr user;
+	string hubUrl;
 
 	static const string UPLOAD, DOWNLOAD;
 	
@@ -219,6 +222,9 @@ private:
 
 	void setUser(const UserPtr& aUser);
 
+	// the limiter depends on both the user and the hub
+	void updateLimiter();
+
 	void onLine(const string& aLine) noexcept;
 	
 	void send(const string& aString);
@@ -30,7 +30,18 @@ namespace events {
 Manager::Manager():
     m_running(true)
 {
-    //pthread_cond_init(&m_queueCond, NULL);
+    static const char* builtinNames[BUILTIN_EVENT_LAST] = {
+        "window updated",
+        "window status updated",
+        "window changed",
+        "window closed",
+        "statusbar updated",
+        "key pressed",
+        "bytes transferred"
+    };
+
+    for(auto name: builtinNames)
+        get_id(name);
 }
 
 void Manager::main_loop()
@@ -40,12 +51,18 @@ void Manager::main_loop()
         /* wait until there's events to process */
 		s.wait();
 		if (tasks.try_pop(callback)) {
-			m_args = &callback->args;
+			EventSig* sig;
+			{
+				dcpp::RLock l(m_cs);
+				sig = m_signals[callback->event];
+			}
+
+			m_args = callback;
 
 			/* stopping the current event works
 			* by throwing StopEvent exception */
 			try {
-				(*callback->sig)();
+				(*sig)();
 			} catch (StopEvent &e) {
 				/* do nothing.. */
 			}
@@ -57,52 +74,57 @@ void Manager::main_loop()
 void Manager::create_event(const std::string &event)
     throw(std::logic_error)
 {
-    if(m_events.find(event) != m_events.end())
-        throw std::logic_error("Event already exists");
+    {
+        dcpp::RLock l(m_cs);
+        if(m_ids.find(event) != m_ids.end())
+            throw std::logic_error("Event already exists");
+    }
 
-    m_events[event] = new EventSig();
+    get_id(event);
+}
+
+EventId Manager::get_id(const std::string &event) noexcept {
+    dcpp::WLock l(m_cs);
+    auto i = m_ids.find(event);
+    if(i != m_ids.end())
+        return i->second;
+
+    EventId id = m_signals.size();
+    m_signals.push_back(new EventSig());
+    m_ids.emplace(event, id);
+    return id;
+}
+
+bool Manager::find_id(const std::string &event, EventId& id_) const noexcept {
+    dcpp::RLock l(m_cs);
+    auto i = m_ids.find(event);
+    if(i == m_ids.end())
+        return false;
+
+    id_ = i->second;
+    return true;
 }
 
 boost::signals2::connection
-Manager::add_listener(const std::string &event, const EventFunc &func, Priority priority) noexcept {
-    if(m_events.find(event) == m_events.end()) {
-        m_events[event] = new EventSig();
+Manager::add_listener(EventId event, const EventFunc &func, Priority priority) noexcept {
+    EventSig* sig;
+    {
+        dcpp::RLock l(m_cs);
+        sig = m_signals[event];
     }
 
-    return m_events[event]->connect(priority, func);
+    return sig->connect(priority, func);
 }
 
-void Manager::emit(const std::string &event, boost::any a1,
-        boost::any a2, boost::any a3,
-        boost::any a4, boost::any a5,
-        boost::any a6, boost::any a7)
-{
-    if(m_events.find(event) == m_events.end())
-        return;
-
-    AnyList args;
-    if(!a1.empty())
-        args.push_back(a1);
-    if(!a2.empty())
-        args.push_back(a2);
-    if(!a3.empty())
-        args.push_back(a3);
-    if(!a4.empty())
-        args.push_back(a4);
-    if(!a5.empty())
-        args.push_back(a5);
-    if(!a6.empty())
-        args.push_back(a6);
-    if(!a7.empty())
-        args.push_back(a7);
-
-	tasks.push(new Callback({ m_events[event], std::move(args) }));
+void Manager::queue(Callback* aCallback) noexcept {
+	tasks.push(aCallback);
 	s.signal();
 }
 
 Manager::~Manager()
 {
-    //pthread_cond_destroy(&m_queueCond);
+    for(auto sig: m_signals)
+        delete sig;
 }
 
 } // namespace events
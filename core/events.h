@@ -26,22 +26,38 @@
 
 #include <pthread.h>
 #include <list>
+#include <map>
+#include <tuple>
 #include <vector>
+#include <typeinfo>
+#include <type_traits>
 #include <functional>
 #include <boost/signals2.hpp>
-#include <boost/any.hpp>
 #include <utils/instance.h>
 #include <string>
 
 #include <client/concurrency.h>
+#include <client/CriticalSection.h>
 #include <client/Semaphore.h>
 
 namespace events {
 
-typedef std::vector<boost::any> AnyList;
 typedef std::function<void ()> EventFunc;
 typedef boost::signals2::signal<void ()> EventSig;
-typedef std::map<std::string, EventSig*> EventMap;
+typedef unsigned int EventId;
+
+/** Events that are known at compile time. Their names are registered
+ * when the manager is created so the string API maps to the same events. */
+enum BuiltinEvent {
+    WINDOW_UPDATED,
+    WINDOW_STATUS_UPDATED,
+    WINDOW_CHANGED,
+    WINDOW_CLOSED,
+    STATUSBAR_UPDATED,
+    KEY_PRESSED,
+    BYTES_TRANSFERRED,
+    BUILTIN_EVENT_LAST
+};
 
 /** Event priorities. */
 enum Priority {
@@ -52,6 +68,12 @@ enum Priority {
 
 class StopEvent { };
 
+/** Thrown when an argument is requested with a wrong type. */
+class BadArgument: public std::logic_error {
+public:
+    BadArgument(): std::logic_error("Invalid event argument") { }
+};
+
 class Manager:
     public utils::Instance<events::Manager>
 {
@@ -62,26 +84,46 @@ public:
      * @throw std::logic_error If the event already exists. */
     void create_event(const std::string &event) throw(std::logic_error);
 
-    /** Add a listener for a specific event.
-     * @throw std::logic_error If event is not created. */
-    boost::signals2::connection add_listener(const std::string &event,
-		const EventFunc &func, Priority priority = DEFAULT) noexcept;
+    /** Returns the id of the event named \c event, creating the event if needed.
+     * Ids of events with dynamic names should be looked up once and stored. */
+    EventId get_id(const std::string &event) noexcept;
 
-    /** Emit the event named \c event. */
-    void emit(const std::string &event, boost::any a1=boost::any(),
-            boost::any a2=boost::any(), boost::any a3=boost::any(),
-            boost::any a4=boost::any(), boost::any a5=boost::any(),
-            boost::any a6=boost::any(), boost::any a7=boost::any());
+    /** Add a listener for a specific event. */
+    boost::signals2::connection add_listener(EventId event,
+		const EventFunc &func, Priority priority = DEFAULT) noexcept;
 
-    /** Get the nth argument of current event. */
+    boost::signals2::connection add_listener(const std::string &event,
+		const EventFunc &func, Priority priority = DEFAULT) noexcept {
+        return add_listener(get_id(event), func, priority);
+    }
+
+    /** Emit the event \c event. The arguments are stored with their own
+     * types and handled in the main loop. */
+    template <class... Args>
+    void emit(EventId event, Args&&... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "Too many event arguments");
+        queue(new TypedCallback<typename std::decay<Args>::type...>(event, std::forward<Args>(args)...));
+    }
+
+    /** Emit the event named \c event. Nothing is done if the event has no listeners. */
+    template <class... Args>
+    void emit(const std::string &event, Args&&... args) {
+        EventId id;
+        if(find_id(event, id))
+            emit(id, std::forward<Args>(args)...);
+    }
+
+    /** Get the nth argument of current event.
+     * @throw BadArgument If the argument doesn't exist or has a different type. */
     template <class T>
-	T arg(unsigned int n) { return boost::any_cast<T>((*m_args)[n]); }
-
-    /** Return a reference to nth argument. */
-    boost::any& arg(unsigned int n) { return (*m_args)[n]; }
+	T& arg(unsigned int n) {
+        if(n >= m_args->count || *m_args->types[n] != typeid(T))
+            throw BadArgument();
+        return *static_cast<T*>(m_args->values[n]);
+    }
 
     /** Return the number of arguments. */
-    unsigned int args() { return m_args->size(); }
+    unsigned int args() { return m_args->count; }
 
     /** Stop handling current event. */
     void stop() { throw StopEvent(); }
@@ -94,20 +136,52 @@ public:
 
     ~Manager();
 private:
-    EventMap m_events;
-    //std::vector<std::pair<EventSig*, AnyList> > m_queue;
-    //utils::Mutex m_queueMutex;
+    enum { MAX_ARGS = 7 };
 
+    /** Queued event, the arguments point to the storage of TypedCallback. */
 	struct Callback {
-		EventSig* sig;
-		AnyList args;
+		Callback(EventId aEvent, unsigned int aCount) : event(aEvent), count(aCount) { }
+		virtual ~Callback() { }
+
+		EventId event;
+		unsigned int count;
+		void* values[MAX_ARGS];
+		const std::type_info* types[MAX_ARGS];
 	};
 
+	template <class... Args>
+	struct TypedCallback: public Callback {
+		template <class... Params>
+		TypedCallback(EventId aEvent, Params&&... aParams) :
+			Callback(aEvent, sizeof...(Args)), storage(std::forward<Params>(aParams)...) {
+			bind_args<0>();
+		}
+
+		template <size_t I>
+		typename std::enable_if<I == sizeof...(Args)>::type bind_args() { }
+
+		template <size_t I>
+		typename std::enable_if<I < sizeof...(Args)>::type bind_args() {
+			values[I] = &std::get<I>(storage);
+			types[I] = &typeid(typename std::tuple_element<I, std::tuple<Args...>>::type);
+			bind_args<I + 1>();
+		}
+
+		std::tuple<Args...> storage;
+	};
+
+    bool find_id(const std::string &event, EventId& id_) const noexcept;
+    void queue(Callback* aCallback) noexcept;
+
+    /** Signals indexed by the event id. */
+    std::vector<EventSig*> m_signals;
+    std::map<std::string, EventId> m_ids;
+    mutable dcpp::SharedMutex m_cs;
+
 	dcpp::concurrent_queue<Callback*> tasks;
 
-    AnyList* m_args = nullptr;
+    Callback* m_args = nullptr;
     bool m_running = true;
-    //pthread_cond_t m_queueCond;
 	dcpp::Semaphore s;
 };
 
@@ -118,40 +192,44 @@ void stop()
 }
 
 inline
-boost::signals2::connection add_listener(const std::string &event, const EventFunc& func)
+EventId id(const std::string &event)
+{
+    return events::Manager::get()->get_id(event);
+}
+
+template <class E>
+boost::signals2::connection add_listener(const E &event, const EventFunc& func)
 {
     return events::Manager::get()->add_listener(event, func);
 }
 
-inline
-boost::signals2::connection add_listener_last(const std::string &event, const EventFunc& func)
+template <class E>
+boost::signals2::connection add_listener_last(const E &event, const EventFunc& func)
 {
     return events::Manager::get()->add_listener(event, func, LAST);
 }
 
-inline
-boost::signals2::connection add_listener_first(const std::string &event, const EventFunc& func)
+template <class E>
+boost::signals2::connection add_listener_first(const E &event, const EventFunc& func)
 {
     return events::Manager::get()->add_listener(event, func, FIRST);
 }
 
-inline
-void emit(const std::string &event, boost::any a1=boost::any(),
-        boost::any a2=boost::any(), boost::any a3=boost::any(),
-        boost::any a4=boost::any(), boost::any a5=boost::any(),
-        boost::any a6=boost::any(), boost::any a7=boost::any())
+template <class... Args>
+void emit(EventId event, Args&&... args)
 {
-    events::Manager::get()->emit(event, a1, a2, a3, a4, a5, a6, a7);
+    events::Manager::get()->emit(event, std::forward<Args>(args)...);
 }
 
-template <class T>
-T arg(unsigned int n) {
-    return events::Manager::get()->arg<T>(n);
+template <class... Args>
+void emit(const std::string &event, Args&&... args)
+{
+    events::Manager::get()->emit(event, std::forward<Args>(args)...);
 }
 
-inline
-boost::any& arg(unsigned int n) {
-    return events::Manager::get()->arg(n);
+template <class T>
+T& arg(unsigned int n) {
+    return events::Manager::get()->arg<T>(n);
 }
 
 inline
@@ -77,10 +77,10 @@ public:
 				msg += " (" + Util::toString(min) + "-" + Util::toString(max) + ")";
 		}
 
-		events::emit("window updated", display::Manager::get()->get_current_window());
+		events::emit(events::WINDOW_UPDATED, display::Manager::get()->get_current_window());
 		while (true) {
 			bool ready = false;
-			auto conn = events::add_listener_first("key pressed", [&] {
+			auto conn = events::add_listener_first(events::KEY_PRESSED, [&] {
 				// detect enter
 				wint_t key = events::arg<wint_t>(1);
 				if (key == 0xA) {
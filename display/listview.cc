@@ -41,6 +41,61 @@ using namespace dcpp;
 
 namespace display {
 
+void Column::build_index()
+{
+    m_index.clear();
+    for(int i = m_rows.size()-1; i >= 0; --i) {
+        if(!m_rows[i].empty())
+            m_index[m_rows[i]] = i;
+    }
+    m_indexed = true;
+}
+
+void Column::unindex(const std::string &content, int row)
+{
+    if(content.empty())
+        return;
+
+    auto p = m_index.find(content);
+    if(p == m_index.end() || p->second != row)
+        return;
+
+    // duplicates are rare, look for the next one only when needed
+    auto it = std::find(m_rows.begin()+row+1, m_rows.end(), content);
+    if(it == m_rows.end())
+        m_index.erase(p);
+    else
+        p->second = std::distance(m_rows.begin(), it);
+}
+
+void Column::delete_row(int row)
+{
+    if(m_indexed) {
+        unindex(m_rows.at(row), row);
+        for(auto& i: m_index) {
+            if(i.second > row)
+                i.second--;
+        }
+    }
+
+    m_rows.erase(m_rows.begin()+row);
+}
+
+void Column::set_text(int row, const std::string &text)
+{
+    auto& cur = m_rows.at(row);
+    if(m_indexed && cur != text) {
+        unindex(cur, row);
+        if(!text.empty()) {
+            auto p = m_index.emplace(text, row);
+            if(!p.second && p.first->second > row)
+                p.first->second = row;
+        }
+    }
+
+    cur = text;
+}
+
 ListView::ListView(display::Type aType, const std::string& aID, bool allowMove) :
     m_rowCount(0),
     m_currentItem(std::numeric_limits<int>::min()),
@@ -75,7 +130,7 @@ void ListView::handleMove() {
 		set_prompt("Move mode enabled. Press 'm' when you are ready.");
 	}
 
-	//events::emit("window updated", this);
+	//events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::setInsertMode(bool enable) {
@@ -177,13 +232,15 @@ void ListView::delete_all()
     std::for_each(m_columns.begin(), m_columns.end(),
         std::mem_fun(&Column::clear));
     m_rowCount = 0;
-    events::emit("window updated", this);
+    events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::set_text(int column, int row, const std::string &text) {
 	auto c = m_columns[column];
     c->set_text(row, text);
-    events::emit("window updated", this);
+
+    if(is_visible(row))
+        events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::handle(wint_t key)
@@ -193,14 +250,14 @@ void ListView::handle(wint_t key)
 			setInsertMode(false);
 			set_prompt("");
 			handleEscape();
-			events::emit("window updated", static_cast<display::Window*>(this));
+			events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 		} else if (m_input.pressed(key)) {
-			events::emit("window updated", static_cast<display::Window*>(this));
+			events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 		} else if (key >= 0x20) {
 			string tmp;
 			Text::wcToUtf8(key, tmp);
 			m_input.text_insert(tmp);
-			events::emit("window updated", static_cast<display::Window*>(this));
+			events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 		}
 		return;
     }
@@ -208,7 +265,7 @@ void ListView::handle(wint_t key)
     try {
 		if (m_bindings.find(key) != m_bindings.end()) {
 			m_bindings[key]();
-			events::emit("window updated", static_cast<display::Window*>(this));
+			events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 		}
     }
     catch(std::out_of_range &) {
@@ -227,13 +284,13 @@ void ListView::scroll_list(int items)
 
 	if (moving) {
 		for (auto& c : m_columns) {
-			utils::slide(c->m_rows, m_currentItem, newPos);
+			c->slide_row(m_currentItem, newPos);
 		}
 		onListMove(m_currentItem, newPos);
 	}
 
 	m_currentItem = newPos;
-    //events::emit("window updated", this);
+    //events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::redraw()
@@ -256,11 +313,14 @@ void ListView::redraw()
     clear_flags();
 
     if(m_rowCount == 0) {
+        m_firstVisible = m_lastVisible = 0;
         refresh();
         return;
     }
 
     auto range = rak::advance_bidirectional<unsigned int>(0, m_currentItem, m_rowCount, get_height()-1-m_infoboxHeight);
+    m_firstVisible = range.first;
+    m_lastVisible = range.second;
     while(range.first != range.second) {
         x = 0;
         y++;
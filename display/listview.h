@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <vector>
+#include <unordered_map>
 #include <utils/utils.h>
 #include <display/window.h>
 #include <display/item.h>
@@ -60,17 +61,29 @@ public:
 
     void insert_row() { m_rows.push_back(""); }
 
+    /** Returns the first row containing \c content or the number of rows
+     * if there is no such row. The content index is built on the first
+     * lookup and maintained after that, so columns that are never searched
+     * don't pay for it. */
     int find_row(const std::string &content) {
-        auto it = std::find(m_rows.begin(), m_rows.end(), content);
-        return std::distance(m_rows.begin(), it);
+        if(content.empty()) {
+            auto it = std::find(m_rows.begin(), m_rows.end(), content);
+            return std::distance(m_rows.begin(), it);
+        }
+
+        if(!m_indexed)
+            build_index();
+
+        auto p = m_index.find(content);
+        return p != m_index.end() ? p->second : m_rows.size();
     }
 
-    void delete_row(int row) { m_rows.erase(m_rows.begin()+row); }
+    void delete_row(int row);
 
-    void set_text(int row, const std::string &text) { m_rows.at(row) = text; }
+    void set_text(int row, const std::string &text);
 	const std::string& get_text(int row) { return m_rows[row]; }
 
-    void clear() { m_rows.clear(); }
+    void clear() { m_rows.clear(); m_index.clear(); }
 
     /** Used to calculate the total width of all columns. */
     static int calc_width(int width, Column *column) {
@@ -80,8 +93,24 @@ public:
 	virtual void handleMove(int /*prevPos*/, int /*diff*/) { }
 	virtual ~Column() { }
 private:
+    void build_index();
+
+    /** Moves the row and drops the index, the positions between the
+     * rows change. */
+    void slide_row(int oldPos, int newPos) {
+        utils::slide(m_rows, oldPos, newPos);
+        m_index.clear();
+        m_indexed = false;
+    }
+
+    /** Called before \c row stops containing \c content. */
+    void unindex(const std::string &content, int row);
+
     std::string m_name;
     std::vector<std::string> m_rows;
+    /** Content -> first row, empty contents are not indexed. */
+    std::unordered_map<std::string, int> m_index;
+    bool m_indexed = false;
     int m_minWidth;
     int m_preferredWidth;
     int m_maxWidth;
@@ -146,6 +175,14 @@ public:
 
     virtual std::string get_infobox_line(unsigned int n) { return std::string(); }
 
+    /** Whether \c row was inside the viewport on the last redraw of the
+     * active window. The row after the last drawn one is included so that
+     * rows appended to a list that doesn't fill the window are shown.
+     * Updates to other rows are drawn by the next redraw. */
+    bool is_visible(int row) const {
+        return m_state == STATE_IS_ACTIVE && row >= m_firstVisible && row <= m_lastVisible;
+    }
+
     /** Get the number of currently selected item.
      * @return index or -1 if nothing is selected */
     int get_current() const { return m_currentItem; }
@@ -168,6 +205,9 @@ protected:
     //utils::Mutex m_itemLock;
     int m_currentItem;
     unsigned int m_infoboxHeight;
+    /** Rows drawn by the last redraw, m_lastVisible is one past the last one. */
+    int m_firstVisible = 0;
+    int m_lastVisible = 0;
 };
 
 } // namespace display
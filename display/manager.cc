@@ -43,15 +43,15 @@ Manager::Manager():
     m_statusbar(display::StatusBar::create()),
     m_altPressed(false)
 {
-    events::add_listener("key pressed",
+    events::add_listener(events::KEY_PRESSED,
             std::bind(&display::Window::handle,
                 std::bind(&display::Manager::get_current_window, this),
                 std::bind(&events::arg<wint_t>, 1)));
 
-    events::add_listener_first("key pressed",
+    events::add_listener_first(events::KEY_PRESSED,
             std::bind(&display::Manager::handle_key, this));
 
-    events::add_listener_last("window closed",
+    events::add_listener_last(events::WINDOW_CLOSED,
             std::bind(&display::Manager::window_closed, this));
 
     m_inputWindow.set_input(&display::Window::m_input);
@@ -94,9 +94,9 @@ void Manager::set_current_impl(Windows::iterator newCur, Window* oldCur) {
 	(*m_current)->refresh();
 	(*m_current)->redraw();
 
-	events::emit("window status updated", *newCur, STATE_IS_ACTIVE);
-	events::emit("window updated", *newCur);
-	events::emit("window changed", oldCur, *newCur);
+	events::emit(events::WINDOW_STATUS_UPDATED, *newCur, STATE_IS_ACTIVE);
+	events::emit(events::WINDOW_UPDATED, *newCur);
+	events::emit(events::WINDOW_CHANGED, oldCur, *newCur);
 }
 
 void Manager::handle_key()
@@ -185,7 +185,7 @@ void Manager::remove(display::Window *window)
 		set_current_impl(newWin == m_windows->end() ? m_windows->end()-1 : newWin, window);
 	}
 
-	events::emit("window closed", window);
+	events::emit(events::WINDOW_CLOSED, window);
 }
 
 void Manager::next() {
@@ -66,10 +66,10 @@ void ScrolledWindow::handle(wint_t key) {
 		m_bindings[key]();
 	} else if (m_input.pressed(key)) {
 		/* backspace, arrow keys.. */
-		events::emit("window updated", static_cast<display::Window*>(this));
+		events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 	} else if (key >= 0x20) {
         m_input.key_insert(key);
-        events::emit("window updated", static_cast<display::Window*>(this));
+        events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
     }
 }
 
@@ -83,7 +83,7 @@ void ScrolledWindow::add_line(const display::LineEntry &line_,
 	m_lines.push_back(line);
 
     if(redraw_screen && m_state == STATE_IS_ACTIVE) {
-        events::emit("window updated", this);
+        events::emit(events::WINDOW_UPDATED, this);
     } else if(m_state != STATE_IS_ACTIVE) {
         if(line.m_type == LineEntry::HIGHLIGHT || line.m_type == LineEntry::ACTIVITY_ERROR) {
             m_state = STATE_HIGHLIGHT;
@@ -96,7 +96,7 @@ void ScrolledWindow::add_line(const display::LineEntry &line_,
         {
             m_state = STATE_ACTIVITY;
         }
-        events::emit("window status updated", static_cast<Window*>(this), m_state);
+        events::emit(events::WINDOW_STATUS_UPDATED, static_cast<Window*>(this), m_state);
     }
 }
 
@@ -176,7 +176,7 @@ void ScrolledWindow::scroll_window(int aLines)
 		m_scrollPosition = -1;
 	}
 
-    events::emit("window updated", this);
+    events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ScrolledWindow::redraw()
@@ -37,7 +37,7 @@ const std::string& StatusItem::get_name() const {
 }
 
 void StatusItem::callAsync(std::function<void()> aF) {
-	events::emit("asyncbar" + m_id, aF);
+	events::emit(asyncEvent, std::move(aF));
 }
 
 void StatusItem::handleAsync() {
@@ -45,7 +45,8 @@ void StatusItem::handleAsync() {
 }
 
 StatusItem::StatusItem(const std::string& aID) : m_id(aID),
-asyncConn(events::add_listener("asyncbar" + aID, std::bind(&StatusItem::handleAsync, this)))
+asyncEvent(events::id("asyncbar" + aID)),
+asyncConn(events::add_listener(asyncEvent, std::bind(&StatusItem::handleAsync, this)))
 {
 
 }
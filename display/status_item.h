@@ -27,6 +27,7 @@
 #include <string>
 
 #include <boost/signals2.hpp>
+#include <core/events.h>
 
 namespace display {
 
@@ -59,6 +60,7 @@ protected:
 
 private:
 	void handleAsync();
+	const events::EventId asyncEvent;
 	boost::signals2::scoped_connection asyncConn;
 };
 
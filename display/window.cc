@@ -47,7 +47,8 @@ Window::Window(const std::string& aID, Type aType, bool aAllowCommands) :
     m_insertMode(true),
     m_drawTitle(true),
 	allowCommands(aAllowCommands),
-	asyncConn(events::add_listener("async" + id, std::bind(&Window::handleAsync, this)))
+	asyncEvent(events::id("async" + id)),
+	asyncConn(events::add_listener(asyncEvent, std::bind(&Window::handleAsync, this)))
 {
     // ^X
     m_bindings['X' - '@'] = std::bind(&display::Manager::remove,
@@ -209,7 +210,7 @@ void Window::setInsertMode(bool enable) {
 }
 
 void Window::callAsync(std::function<void()> aF) {
-	events::emit("async" + id, aF);
+	events::emit(asyncEvent, std::move(aF));
 }
 
 void Window::handleAsync() {
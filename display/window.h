@@ -173,6 +173,7 @@ private:
 
 	bool m_insertMode;
 
+	const events::EventId asyncEvent;
 	boost::signals2::scoped_connection asyncConn;
 };
 
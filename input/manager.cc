@@ -108,7 +108,7 @@ void Manager::handle_char(wint_t ch)
         str[2] = 0;
     }
 
-    events::emit("key pressed", std::string(str), ch);
+    events::emit(events::KEY_PRESSED, std::string(str), ch);
 }
 
 Manager::~Manager()
@@ -45,7 +45,7 @@ public:
 	HelpHandler help;
 
 	Away() : help(&commands, "Away mode") {
-		events::add_listener("key pressed",
+		events::add_listener(events::KEY_PRESSED,
 			std::bind(&Away::key_pressed, this));
 		events::add_listener("client created", [this] { TimerManager::getInstance()->addListener(this); });
 		events::add_listener("command quit", [this] { TimerManager::getInstance()->removeListener(this); });
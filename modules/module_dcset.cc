@@ -304,10 +304,13 @@ static NamedSettingItem settings [] = {
 	{ "ul_slots", SettingsManager::SLOTS, ResourceManager::SETTINGS_UPLOADS_SLOTS, NamedSettingItem::TYPE_LIMITS_UL },
 	{ "ul_minislot_size", SettingsManager::SET_MINISLOT_SIZE, ResourceManager::SETCZDC_SMALL_FILES },
 	{ "ul_minislot_ext", SettingsManager::FREE_SLOTS_EXTENSIONS, ResourceManager::ST_MINISLOTS_EXT },
+	{ "ul_cache_size", SettingsManager::UPLOAD_CACHE_SIZE, ResourceManager::UPLOAD_CACHE_SIZE },
 
 	{ ResourceManager::TRASFER_RATE_LIMITING },
 	{ "limit_ul_max", SettingsManager::MAX_UPLOAD_SPEED_MAIN, ResourceManager::UPLOAD_LIMIT },
 	{ "limit_dl_max", SettingsManager::MAX_DOWNLOAD_SPEED_MAIN, ResourceManager::DOWNLOAD_LIMIT },
+	{ "limit_ul_user", SettingsManager::MAX_UPLOAD_SPEED_USER, ResourceManager::UPLOAD_LIMIT_USER },
+	{ "limit_dl_user", SettingsManager::MAX_DOWNLOAD_SPEED_USER, ResourceManager::DOWNLOAD_LIMIT_USER },
 	{ "limit_use_alt", SettingsManager::TIME_DEPENDENT_THROTTLE, ResourceManager::ALTERNATE_LIMITING },
 	{ "limit_alt_start_hour", SettingsManager::BANDWIDTH_LIMIT_START, ResourceManager::SET_ALTERNATE_LIMITING },
 	{ "limit_alt_end_hour", SettingsManager::BANDWIDTH_LIMIT_END, ResourceManager::SET_ALTERNATE_LIMITING },
@@ -325,12 +328,14 @@ static NamedSettingItem settings [] = {
 	{ "max_total_hashers", SettingsManager::MAX_HASHING_THREADS, ResourceManager::MAX_HASHING_THREADS },
 	{ "max_vol_hashers", SettingsManager::HASHERS_PER_VOLUME, ResourceManager::MAX_VOL_HASHERS },
 	{ "report_each_hashed_file", SettingsManager::LOG_HASHING, ResourceManager::LOG_HASHING },
+	{ "hash_direct_read", SettingsManager::HASH_DIRECT_READ, ResourceManager::HASH_DIRECT_READ },
 
 	{ ResourceManager::REFRESH_OPTIONS },
 	{ "refresh_time", SettingsManager::AUTO_REFRESH_TIME, ResourceManager::SETTINGS_AUTO_REFRESH_TIME },
 	{ "refresh_time_incoming", SettingsManager::INCOMING_REFRESH_TIME, ResourceManager::SETTINGS_INCOMING_REFRESH_TIME },
 	{ "refresh_startup", SettingsManager::STARTUP_REFRESH, ResourceManager::SETTINGS_STARTUP_REFRESH },
 	{ "refresh_report_scheduled_refreshes", SettingsManager::LOG_SCHEDULED_REFRESHES, ResourceManager::SETTINGS_LOG_SCHEDULED_REFRESHES },
+	{ "refresh_volume_threads", SettingsManager::REFRESH_THREADS_PER_VOLUME, ResourceManager::REFRESH_THREADS_PER_VOLUME },
 
 	{ ResourceManager::SETTINGS_SHARING_OPTIONS },
 	{ "share_skiplist", SettingsManager::SKIPLIST_SHARE, ResourceManager::ST_SKIPLIST_SHARE },
@@ -342,6 +347,8 @@ static NamedSettingItem settings [] = {
 	{ "share_follow_symlinks", SettingsManager::SHARE_FOLLOW_SYMLINKS, ResourceManager::FOLLOW_SYMLINKS },
 	{ "share_report_duplicates", SettingsManager::FL_REPORT_FILE_DUPES, ResourceManager::REPORT_DUPLICATE_FILES },
 	{ "share_report_skiplist", SettingsManager::REPORT_SKIPLIST, ResourceManager::REPORT_SKIPLIST },
+	{ "share_search_index", SettingsManager::SHARE_SEARCH_INDEX, ResourceManager::SHARE_SEARCH_INDEX },
+	{ "share_search_parallel", SettingsManager::SHARE_SEARCH_PARALLEL, ResourceManager::SHARE_SEARCH_PARALLEL },
 
 	{ ResourceManager::SETTINGS_LOGGING },
 	{ "log_dir", SettingsManager::LOG_DIRECTORY, ResourceManager::SETTINGS_LOG_DIR, NamedSettingItem::TYPE_GENERAL, SETTINGCOMP(input::Completion::getDiskPathSuggestions) },
@@ -33,7 +33,7 @@ class KeyPressed
 {
 public:
     KeyPressed() {
-        events::add_listener("key pressed",
+        events::add_listener(events::KEY_PRESSED,
                 std::bind(&KeyPressed::key_pressed, this));
     }
 
@@ -39,7 +39,7 @@ public:
     LineHandler():
         m_commandChar('/')
     {
-        events::add_listener_first("key pressed",
+        events::add_listener_first(events::KEY_PRESSED,
                 std::bind(&LineHandler::key_pressed, this));
     }
 
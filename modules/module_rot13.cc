@@ -34,7 +34,7 @@ class Rot13
 {
 public:
     Rot13() {
-//        events::add_listener_first("key pressed",
+//        events::add_listener_first(events::KEY_PRESSED,
 //                std::bind(&Rot13::key_pressed, this));
     }
 
@@ -48,7 +48,7 @@ public:
             else
                 ch -= 13;
         }
-        events::arg(1) = ch;
+        events::arg<wint_t>(1) = ch;
         std::ostringstream oss;
         oss << (char)ch << " - " << (char)events::arg<wint_t>(1);
 
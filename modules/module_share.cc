@@ -65,7 +65,7 @@ namespace modules {
 
 		HelpHandler help;
 		Share() : help(&commands, "Share") {
-			events::add_listener("key pressed", std::bind(&Share::keyPressed, this));
+			events::add_listener(events::KEY_PRESSED, std::bind(&Share::keyPressed, this));
 		}
 
 		void keyPressed() {
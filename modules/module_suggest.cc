@@ -75,7 +75,7 @@ namespace modules {
 	class Suggest {
 	public:
 		Suggest() {
-			events::add_listener("key pressed",
+			events::add_listener(events::KEY_PRESSED,
 				std::bind(&Suggest::key_pressed, this));
 		}
 
@@ -117,7 +117,7 @@ namespace modules {
 			lastLen = add.length();
 			display::Window::m_input.setText(line, false);
 			display::Window::m_input.set_pos(startPos + lastLen);
-			events::emit("window updated", cur);
+			events::emit(events::WINDOW_UPDATED, cur);
 		}
 
 		void createComparator(const string& aLine, int pos, display::Window* cur) noexcept {
@@ -66,7 +66,7 @@ public:
 	HelpHandler help;
 
     Window() : help(&commands, "Window") {
-		events::add_listener("key pressed", std::bind(&Window::keyPressed, this));
+		events::add_listener(events::KEY_PRESSED, std::bind(&Window::keyPressed, this));
 	}
 
 	void keyPressed() {
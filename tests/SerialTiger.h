@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_TESTS_SERIAL_TIGER_H
+#define DCPLUSPLUS_TESTS_SERIAL_TIGER_H
+
+#include <client/TigerHash.h>
+#include <client/MerkleTree.h>
+
+namespace dcpp {
+
+/** Hashes the tree leaves one at a time with the plain TigerHash, as was done before TigerHash::hashLanes */
+class SerialTiger : public TigerHash {
+public:
+	static const size_t LANES = 1;
+
+	static void hashLanes(uint8_t aPrefix, const uint8_t* const* aData, size_t aLen, uint8_t* aResults) {
+		TigerHash h;
+		h.update(&aPrefix, 1);
+		h.update(aData[0], aLen);
+		memcpy(aResults, h.finalize(), BYTES);
+	}
+};
+
+typedef MerkleTree<SerialTiger> SerialTigerTree;
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_TESTS_SERIAL_TIGER_H)
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Measures the rate of emitting and dispatching events through events::Manager, by id and by
+ * name, compared to the previous implementation that looked the events up by name and passed
+ * the arguments as boost::any values.
+ *
+ * Usage: events_bench [events per run] [runs]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/concurrency.h>
+#include <client/Semaphore.h>
+#include <client/Util.h>
+
+#include <core/events.h>
+
+#include <boost/any.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+using namespace dcpp;
+
+namespace {
+
+/** The previous event manager */
+class AnyManager {
+public:
+	typedef std::vector<boost::any> AnyList;
+
+	~AnyManager() {
+		for(auto& e: events)
+			delete e.second;
+	}
+
+	boost::signals2::connection add_listener(const string& event, const events::EventFunc& func) {
+		if(events.find(event) == events.end()) {
+			events[event] = new events::EventSig();
+		}
+
+		return events[event]->connect(events::DEFAULT, func);
+	}
+
+	void emit(const string& event, boost::any a1 = boost::any(), boost::any a2 = boost::any(), boost::any a3 = boost::any(),
+		boost::any a4 = boost::any(), boost::any a5 = boost::any(), boost::any a6 = boost::any(), boost::any a7 = boost::any())
+	{
+		if(events.find(event) == events.end())
+			return;
+
+		AnyList args;
+		for(auto a: { &a1, &a2, &a3, &a4, &a5, &a6, &a7 }) {
+			if(!a->empty())
+				args.push_back(*a);
+		}
+
+		tasks.push(new Callback({ events[event], std::move(args) }));
+		s.signal();
+	}
+
+	template <class T>
+	T arg(unsigned int n) { return boost::any_cast<T>((*curArgs)[n]); }
+
+	void main_loop() {
+		Callback* callback;
+		do {
+			s.wait();
+			if(tasks.try_pop(callback)) {
+				curArgs = &callback->args;
+				(*callback->sig)();
+				delete callback;
+			}
+		} while(running);
+	}
+
+	void quit() { running = false; }
+private:
+	struct Callback {
+		events::EventSig* sig;
+		AnyList args;
+	};
+
+	std::map<string, events::EventSig*> events;
+	concurrent_queue<Callback*> tasks;
+	AnyList* curArgs = nullptr;
+	bool running = true;
+	Semaphore s;
+};
+
+const string EVENT_NAME = "window updated";
+
+/** The listeners read both arguments and stop the main loop after the last event */
+class AnyBench {
+public:
+	void start(int aEvents) {
+		manager.reset(new AnyManager());
+		manager->add_listener(EVENT_NAME, [this, aEvents] {
+			sum += manager->arg<string>(0).size() + manager->arg<int>(1);
+			if(++handled == aEvents)
+				manager->quit();
+		});
+		handled = 0;
+	}
+
+	void emit(const string& aWindow, int aValue) { manager->emit(EVENT_NAME, aWindow, aValue); }
+	void dispatch() { manager->main_loop(); }
+
+	int64_t sum = 0;
+private:
+	unique_ptr<AnyManager> manager;
+	int handled = 0;
+};
+
+class IdBench {
+public:
+	void start(int aEvents) {
+		// the main loop handles one more event after quit() so the manager is created for each run
+		events::Manager::destroy();
+		events::add_listener(events::WINDOW_UPDATED, [this, aEvents] {
+			sum += events::arg<string>(0).size() + events::arg<int>(1);
+			if(++handled == aEvents)
+				events::Manager::get()->quit();
+		});
+		handled = 0;
+	}
+
+	void emit(const string& aWindow, int aValue) { events::emit(events::WINDOW_UPDATED, aWindow, aValue); }
+	void dispatch() { events::Manager::get()->main_loop(); }
+
+	int64_t sum = 0;
+private:
+	int handled = 0;
+};
+
+/** The string API on top of the ids */
+class NameBench : public IdBench {
+public:
+	void emit(const string& aWindow, int aValue) { events::emit(EVENT_NAME, aWindow, aValue); }
+};
+
+/** @return The best rate of the runs in events/s */
+template<class Bench>
+double run(int aEvents, int aRuns, int64_t& sum_) {
+	Bench bench;
+	double best = 0;
+	for(int i = 0; i < aRuns; ++i) {
+		bench.start(aEvents);
+		string window = "window " + Util::toString(i);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for(int j = 0; j < aEvents; ++j)
+			bench.emit(window, j);
+		bench.dispatch();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = max(best, aEvents / elapsed.count());
+	}
+	sum_ = bench.sum;
+	return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 1000000;
+	int runs = argc > 2 ? atoi(argv[2]) : 10;
+	if(count <= 0 || runs <= 0) {
+		printf("Usage: %s [events per run] [runs]\n", argv[0]);
+		return 1;
+	}
+
+	int64_t anySum, nameSum, idSum;
+	auto anyRate = run<AnyBench>(count, runs, anySum);
+	auto nameRate = run<NameBench>(count, runs, nameSum);
+	auto idRate = run<IdBench>(count, runs, idSum);
+	events::Manager::destroy();
+
+	printf("%d events with a string and an int argument, best of %d runs\n", count, runs);
+	printf("by name with boost::any: %.0f events/s\n", anyRate);
+	printf("by name: %.0f events/s (%.2fx)\n", nameRate, nameRate / anyRate);
+	printf("by id: %.0f events/s (%.2fx)\n", idRate, idRate / anyRate);
+	if(anySum != nameSum || anySum != idSum) {
+		printf("the listeners received different arguments!\n");
+		return 1;
+	}
+	return 0;
+}
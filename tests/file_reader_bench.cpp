@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Measures the rate of hashing files with FileReader using the direct read-ahead reader compared
+ * to the mapped reader that was used before. The files are grouped by the device that they are on.
+ * The files are dropped from the page cache before each read, which requires them to be
+ * readable and not dirty.
+ *
+ * Usage: file_reader_bench runs file [file...]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/File.h>
+#include <client/FileReader.h>
+#include <client/MerkleTree.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+using namespace dcpp;
+
+namespace {
+
+/** Drops the file from the page cache so that it's read from the device */
+void dropCache(const string& aFile) {
+	int fd = open(aFile.c_str(), O_RDONLY);
+	if(fd != -1) {
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+bool supportsDirect(const string& aFile) {
+	int fd = open(aFile.c_str(), O_RDONLY | O_DIRECT);
+	if(fd == -1)
+		return false;
+	close(fd);
+	return true;
+}
+
+/** Hashes the files like the hashers do
+ * @return The best rate of the runs in MB/s */
+double run(const StringList& aFiles, bool aDirect, int aRuns, string& roots_) {
+	double best = 0;
+	for(int i = 0; i < aRuns; ++i) {
+		for(const auto& f: aFiles)
+			dropCache(f);
+
+		int64_t bytes = 0;
+		roots_.clear();
+
+		auto start = std::chrono::steady_clock::now();
+		for(const auto& f: aFiles) {
+			TigerTree tree(TigerTree::calcBlockSize(File::getSize(f), 10));
+			FileReader fr(aDirect);
+			bytes += fr.read(f, [&](const void* buf, size_t n) -> bool {
+				tree.update(buf, n);
+				return true;
+			});
+			tree.finalize();
+			roots_ += tree.getRoot().toBase32();
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = max(best, bytes / elapsed.count() / 1e6);
+	}
+	return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+	int runs = argc > 2 ? atoi(argv[1]) : 0;
+	if(runs <= 0) {
+		printf("Usage: %s runs file [file...]\n", argv[0]);
+		return 1;
+	}
+
+	map<dev_t, StringList> devices;
+	for(int i = 2; i < argc; ++i) {
+		struct stat st;
+		if(stat(argv[i], &st) == -1 || !S_ISREG(st.st_mode)) {
+			printf("%s isn't a file\n", argv[i]);
+			return 1;
+		}
+		devices[st.st_dev].push_back(argv[i]);
+	}
+
+	bool same = true;
+	for(const auto& d: devices) {
+		int64_t size = 0;
+		for(const auto& f: d.second)
+			size += File::getSize(f);
+
+		printf("device %u:%u, %d files, %.1f MB, best of %d runs\n", major(d.first), minor(d.first),
+			static_cast<int>(d.second.size()), size / 1e6, runs);
+		if(!supportsDirect(d.second.front()))
+			printf("the file system doesn't support O_DIRECT, the direct reader falls back to the mapped one\n");
+
+		string mappedRoots, directRoots;
+		auto mapped = run(d.second, false, runs, mappedRoots);
+		auto direct = run(d.second, true, runs, directRoots);
+
+		printf("mapped: %.1f MB/s\n", mapped);
+		printf("direct with read-ahead: %.1f MB/s (%.2fx)\n", direct, direct / mapped);
+		if(mappedRoots != directRoots) {
+			printf("the hashes differ!\n");
+			same = false;
+		}
+	}
+
+	return same ? 0 : 1;
+}
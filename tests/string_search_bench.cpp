@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Measures the rate of matching generated file names against sets of patterns with StringSearch
+ * compared to searching for each pattern separately, and checks that the results are the same.
+ *
+ * Usage: string_search_bench [names] [pattern sets per count] [runs]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/StringSearch.h>
+#include <client/Text.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace dcpp;
+
+namespace {
+
+const int MAX_PATTERNS = 8;
+
+/** The matching functions that search for each pattern separately */
+class PerPatternSearch {
+public:
+	PerPatternSearch(const StringSearch& aSearch) : patterns(aSearch.getPatterns()) { }
+
+	bool match_any_lower(const string& aText) const {
+		for(const auto& p: patterns) {
+			if(p.matchLower(aText) != string::npos) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	int matchLower(const string& aText, bool aResumeOnNoMatch, StringSearch::ResultList* results_) const {
+		int matches = 0, listPos = 0;
+		for(const auto& p: patterns) {
+			size_t addPos = string::npos;
+			for(;;) {
+				size_t curPos = p.matchLower(aText, addPos == string::npos ? 0 : addPos + 1);
+				if(curPos != string::npos) {
+					if(results_ && listPos > 0) {
+						// prefer sequential match order if this isn't the first pattern
+						if((*results_)[listPos - 1] != string::npos && (*results_)[listPos - 1] > curPos) {
+							addPos = curPos;
+							continue; // keep on searching
+						}
+					}
+
+					// use this match
+					addPos = curPos;
+				}
+
+				if(addPos != string::npos) {
+					matches++;
+					if(results_) {
+						(*results_)[listPos] = addPos;
+					}
+				} else if(!aResumeOnNoMatch) {
+					if(results_) {
+						fill_n((*results_).begin(), listPos, string::npos);
+					}
+					return 0;
+				}
+
+				break;
+			}
+			listPos++;
+		}
+
+		return matches;
+	}
+private:
+	const StringSearch::PatternList& patterns;
+};
+
+struct Result {
+	double anyRate = 0;
+	double resumeRate = 0;
+	int64_t anyMatches = 0;
+	int64_t positionSum = 0;
+};
+
+/** Matches all names against all pattern sets
+ * @return The best rates of the runs in names/s */
+template<class Search>
+Result run(const StringList& aNames, const vector<StringSearch>& aSearches, int aRuns) {
+	Result result;
+	for(int i = 0; i < aRuns; ++i) {
+		int64_t anyMatches = 0, positionSum = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for(const auto& s: aSearches) {
+			Search search(s);
+			for(const auto& name: aNames) {
+				if(search.match_any_lower(name))
+					anyMatches++;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		result.anyRate = max(result.anyRate, aNames.size() * aSearches.size() / elapsed.count());
+
+		start = std::chrono::steady_clock::now();
+		for(const auto& s: aSearches) {
+			Search search(s);
+			StringSearch::ResultList positions(s.count());
+			for(const auto& name: aNames) {
+				fill(positions.begin(), positions.end(), string::npos);
+				if(search.matchLower(name, true, &positions) > 0) {
+					for(auto p: positions)
+						positionSum += p == string::npos ? -1 : p;
+				}
+			}
+		}
+		elapsed = std::chrono::steady_clock::now() - start;
+		result.resumeRate = max(result.resumeRate, aNames.size() * aSearches.size() / elapsed.count());
+
+		result.anyMatches = anyMatches;
+		result.positionSum = positionSum;
+	}
+	return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+	int nameCount = argc > 1 ? atoi(argv[1]) : 100000;
+	int setCount = argc > 2 ? atoi(argv[2]) : 20;
+	int runs = argc > 3 ? atoi(argv[3]) : 5;
+	if(nameCount <= 0 || setCount <= 0 || runs <= 0) {
+		printf("Usage: %s [names] [pattern sets per count] [runs]\n", argv[0]);
+		return 1;
+	}
+
+	std::mt19937 rand(1);
+
+	// a vocabulary with a few common words so that some of the pattern sets match often
+	StringList words = { "the", "of", "and", "mp3", "flac", "720p", "1080p", "x264", "live", "remastered" };
+	std::uniform_int_distribution<int> letter('a', 'z'), wordLen(3, 9);
+	while(words.size() < 2000) {
+		string word;
+		for(int len = wordLen(rand); len > 0; --len)
+			word += static_cast<char>(letter(rand));
+		words.push_back(word);
+	}
+
+	// biased towards the beginning of the vocabulary
+	std::geometric_distribution<size_t> wordIndex(0.01);
+	auto randomWord = [&] { return words[wordIndex(rand) % words.size()]; };
+
+	const char separators[] = " ._-";
+	const char* extensions[] = { ".mp3", ".flac", ".mkv", ".nfo", ".jpg", ".sfv" };
+	std::uniform_int_distribution<int> nameWords(3, 10), separator(0, 3), extension(0, 5);
+
+	StringList names;
+	for(int i = 0; i < nameCount; ++i) {
+		string name;
+		for(int n = nameWords(rand); n > 0; --n) {
+			if(!name.empty())
+				name += separators[separator(rand)];
+			name += randomWord();
+		}
+		names.push_back(name + extensions[extension(rand)]);
+	}
+
+	printf("%d names, %d pattern sets per count, best of %d runs, million names/s\n", nameCount, setCount, runs);
+	printf("patterns  match_any_lower (old, new)       matchLower with resume (old, new)\n");
+
+	bool same = true;
+	for(int count = 1; count <= MAX_PATTERNS; ++count) {
+		vector<StringSearch> searches(setCount);
+		for(auto& s: searches) {
+			for(int i = 0; i < count; ++i)
+				s.addString(randomWord());
+		}
+
+		auto old = run<PerPatternSearch>(names, searches, runs);
+		auto cur = run<const StringSearch&>(names, searches, runs);
+
+		printf("%8d  %6.2f %6.2f (%.2fx)              %6.2f %6.2f (%.2fx)\n", count,
+			old.anyRate / 1e6, cur.anyRate / 1e6, cur.anyRate / old.anyRate,
+			old.resumeRate / 1e6, cur.resumeRate / 1e6, cur.resumeRate / old.resumeRate);
+
+		if(old.anyMatches != cur.anyMatches || old.positionSum != cur.positionSum) {
+			printf("the results differ with %d patterns!\n", count);
+			same = false;
+		}
+	}
+
+	return same ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Drives simulated upload sockets through ThrottleManager and reports the total throughput
+ * and how evenly it was shared between the sockets.
+ *
+ * Usage: throttle_bench [sockets] [seconds] [global KiB/s] [hub KiB/s] [user KiB/s]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/ClientManager.h>
+#include <client/DownloadManager.h>
+#include <client/ResourceManager.h>
+#include <client/SettingsManager.h>
+#include <client/ThrottleManager.h>
+#include <client/TimerManager.h>
+#include <client/UploadManager.h>
+#include <client/User.h>
+#include <client/atomic.h>
+
+#include <cstdio>
+#include <thread>
+
+using namespace dcpp;
+
+namespace {
+
+const int HUBS = 4;
+const size_t PACKET_SIZE = 32 * 1024;
+
+/** Socket that accepts all data immediately */
+class NullSocket : public Socket {
+public:
+	NullSocket() : Socket(Socket::TYPE_TCP) { }
+
+	int write(const void*, int aLen) { return aLen; }
+	int read(void*, int aBufLen) { return aBufLen; }
+};
+
+struct Result {
+	int64_t bytes = 0;
+	int64_t calls = 0;
+};
+
+void runSocket(const ThrottleManager::LimiterPtr& aLimiter, const atomic<bool>& aStop, Result& result_) {
+	NullSocket sock;
+	ByteVector buf(PACKET_SIZE);
+
+	while(!aStop) {
+		size_t len = buf.size();
+		auto n = ThrottleManager::getInstance()->write(&sock, aLimiter.get(), &buf[0], len);
+		if(n > 0)
+			result_.bytes += n;
+		result_.calls++;
+	}
+}
+
+}
+
+int main(int argc, char** argv) {
+	int sockets = argc > 1 ? atoi(argv[1]) : 200;
+	int seconds = argc > 2 ? atoi(argv[2]) : 5;
+	int globalLimit = argc > 3 ? atoi(argv[3]) : 10 * 1024;
+	int hubLimit = argc > 4 ? atoi(argv[4]) : 0;
+	int userLimit = argc > 5 ? atoi(argv[5]) : 0;
+
+	if(sockets <= 0 || seconds <= 0) {
+		printf("Usage: %s [sockets] [seconds] [global KiB/s] [hub KiB/s] [user KiB/s]\n", argv[0]);
+		return 1;
+	}
+
+	ResourceManager::newInstance();
+	SettingsManager::newInstance();
+	TimerManager::newInstance();
+	ClientManager::newInstance();
+	DownloadManager::newInstance();
+	UploadManager::newInstance();
+
+	// the limits are picked up when the manager is created
+	SettingsManager::getInstance()->set(SettingsManager::MAX_UPLOAD_SPEED_MAIN, globalLimit);
+	SettingsManager::getInstance()->set(SettingsManager::MAX_UPLOAD_SPEED_USER, userLimit);
+	ThrottleManager::newInstance();
+
+	vector<ThrottleManager::LimiterPtr> limiters;
+	for(int i = 0; i < sockets; ++i) {
+		auto hubUrl = "adc://hub" + Util::toString(i % HUBS);
+		if(i < HUBS)
+			ThrottleManager::getInstance()->setHubLimits(hubUrl, hubLimit, 0);
+
+		limiters.push_back(ThrottleManager::getInstance()->getLimiter(hubUrl, new User(CID::generate())));
+	}
+
+	atomic<bool> stop(false);
+	vector<Result> results(sockets);
+	vector<std::thread> threads;
+
+	auto start = GET_TICK();
+	for(int i = 0; i < sockets; ++i) {
+		threads.emplace_back(runSocket, std::cref(limiters[i]), std::cref(stop), std::ref(results[i]));
+	}
+
+	Thread::sleep(seconds * 1000);
+	stop = true;
+	for(auto& t: threads)
+		t.join();
+
+	auto elapsed = static_cast<double>(GET_TICK() - start) / 1000.0;
+
+	int64_t total = 0, calls = 0;
+	int64_t minBytes = numeric_limits<int64_t>::max(), maxBytes = 0;
+	for(const auto& r: results) {
+		total += r.bytes;
+		calls += r.calls;
+		minBytes = min(minBytes, r.bytes);
+		maxBytes = max(maxBytes, r.bytes);
+	}
+
+	auto mean = static_cast<double>(total) / sockets;
+	printf("%d sockets, %d hubs, %.2f s\n", sockets, HUBS, elapsed);
+	printf("limits (KiB/s): global %d, hub %d, user %d\n", globalLimit, hubLimit, userLimit);
+	printf("throughput: %.2f MiB/s\n", static_cast<double>(total) / elapsed / (1024 * 1024));
+	printf("calls: %.0f/s\n", static_cast<double>(calls) / elapsed);
+	printf("per socket: min %.2f, max %.2f of the mean\n", mean > 0 ? minBytes / mean : 0.0, mean > 0 ? maxBytes / mean : 0.0);
+
+	limiters.clear();
+	ThrottleManager::deleteInstance();
+	UploadManager::deleteInstance();
+	DownloadManager::deleteInstance();
+	ClientManager::deleteInstance();
+	TimerManager::deleteInstance();
+	SettingsManager::deleteInstance();
+	ResourceManager::deleteInstance();
+	return 0;
+}
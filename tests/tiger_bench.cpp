@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Measures the rate of hashing Tiger trees with TigerHash::hashLanes compared to hashing the
+ * leaves one at a time.
+ *
+ * Usage: tiger_bench [MiB per run] [runs]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/MerkleTree.h>
+
+#include "SerialTiger.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace dcpp;
+
+namespace {
+
+const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+/** @return The best rate of the runs in GB/s */
+template<class Tree>
+double run(const ByteVector& aData, int aRuns, string& root_) {
+	double best = 0;
+	for(int i = 0; i < aRuns; ++i) {
+		auto start = std::chrono::steady_clock::now();
+
+		Tree tree(Tree::calcBlockSize(aData.size(), 10));
+		for(size_t pos = 0; pos < aData.size(); pos += CHUNK_SIZE)
+			tree.update(&aData[pos], min(CHUNK_SIZE, aData.size() - pos));
+		tree.finalize();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = max(best, aData.size() / elapsed.count() / 1e9);
+		root_ = tree.getRoot().toBase32();
+	}
+	return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+	int mib = argc > 1 ? atoi(argv[1]) : 256;
+	int runs = argc > 2 ? atoi(argv[2]) : 15;
+	if(mib <= 0 || runs <= 0) {
+		printf("Usage: %s [MiB per run] [runs]\n", argv[0]);
+		return 1;
+	}
+
+	ByteVector data(static_cast<size_t>(mib) * 1024 * 1024);
+	uint64_t x = 88172645463325252ULL;
+	for(auto& b: data) {
+		// xorshift
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		b = static_cast<uint8_t>(x);
+	}
+
+	string serialRoot, lanesRoot;
+	auto serial = run<SerialTigerTree>(data, runs, serialRoot);
+	auto lanes = run<TigerTree>(data, runs, lanesRoot);
+
+	printf("%d MiB, best of %d runs\n", mib, runs);
+	printf("one leaf at a time: %.3f GB/s\n", serial);
+	printf("%d leaves at a time: %.3f GB/s (%.2fx)\n", static_cast<int>(TigerHash::LANES), lanes, lanes / serial);
+	if(serialRoot != lanesRoot) {
+		printf("the roots differ!\n");
+		return 1;
+	}
+	return 0;
+}
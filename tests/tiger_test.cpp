@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks that TigerHash::hashLanes and the trees hashed with it give the same hashes as
+ * the plain TigerHash for various message lengths, file sizes and read chunkings.
+ *
+ * Usage: tiger_test [files] [seed]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/MerkleTree.h>
+#include <client/TigerHash.h>
+
+#include "SerialTiger.h"
+
+#include <cstdio>
+#include <random>
+
+using namespace dcpp;
+
+namespace {
+
+int failures = 0;
+
+void check(bool aResult, const char* aWhat, int64_t aSize) {
+	if(!aResult) {
+		printf("FAILED: %s (size %lld)\n", aWhat, (long long)aSize);
+		failures++;
+	}
+}
+
+/** Messages of all lengths around the padding boundaries, every prefix byte is tried with a few */
+void testLanes(std::mt19937& aRand) {
+	ByteVector data(4 * 1024);
+	for(auto& b: data)
+		b = static_cast<uint8_t>(aRand());
+
+	for(size_t len = 0; len <= 3 * 1024; ++len) {
+		uint8_t prefix = static_cast<uint8_t>(len < 256 ? len : aRand());
+		const uint8_t* lanes[TigerHash::LANES];
+		for(size_t l = 0; l < TigerHash::LANES; ++l)
+			lanes[l] = &data[(len * 7 + l * 131) % (data.size() - len)];
+
+		uint8_t results[TigerHash::LANES * TigerHash::BYTES];
+		TigerHash::hashLanes(prefix, lanes, len, results);
+
+		for(size_t l = 0; l < TigerHash::LANES; ++l) {
+			uint8_t expected[TigerHash::BYTES];
+			SerialTiger::hashLanes(prefix, &lanes[l], len, expected);
+			check(memcmp(results + l * TigerHash::BYTES, expected, TigerHash::BYTES) == 0, "hashLanes", len);
+		}
+	}
+}
+
+/** Hashes the same data with both trees using random chunk sizes (full leaves except for the last one) */
+void testTree(std::mt19937& aRand, const ByteVector& aData, int64_t aSize) {
+	auto blockSize = TigerTree::calcBlockSize(aSize, 10);
+	TigerTree tree(blockSize);
+	SerialTigerTree expected(blockSize);
+
+	// an empty update adds an empty leaf when nothing has been added yet
+	std::uniform_int_distribution<size_t> leaves(1, 64);
+	size_t pos = 0;
+	do {
+		size_t len = min(leaves(aRand) * TigerTree::BASE_BLOCK_SIZE, static_cast<size_t>(aSize) - pos);
+		tree.update(&aData[0] + pos, len);
+		pos += len;
+	} while(pos < static_cast<size_t>(aSize));
+
+	// the reference is fed in one go
+	expected.update(&aData[0], static_cast<size_t>(aSize));
+
+	tree.finalize();
+	expected.finalize();
+
+	check(memcmp(tree.getRoot().data, expected.getRoot().data, TigerTree::BYTES) == 0, "root", aSize);
+	check(tree.getLeafData() == expected.getLeafData(), "leaves", aSize);
+}
+
+}
+
+int main(int argc, char** argv) {
+	int files = argc > 1 ? atoi(argv[1]) : 500;
+	unsigned seed = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 1;
+
+	std::mt19937 rand(seed);
+	testLanes(rand);
+
+	const int64_t MAX_SIZE = 8 * 1024 * 1024;
+	ByteVector data(MAX_SIZE);
+	for(auto& b: data)
+		b = static_cast<uint8_t>(rand());
+
+	// the edges of the leaves and blocks first, random sizes after them
+	vector<int64_t> sizes = { 0, 1, 1023, 1024, 1025, 2047, 2048, 2049, 3072, 4095, 4096, 4097, 512 * 1024, 1024 * 1024 + 1, MAX_SIZE };
+	std::uniform_int_distribution<int64_t> sizeDist(0, MAX_SIZE);
+	while(static_cast<int>(sizes.size()) < files)
+		sizes.push_back(sizeDist(rand) >> (rand() % 12));
+
+	for(auto size: sizes)
+		testTree(rand, data, size);
+
+	printf("%d files: %s\n", static_cast<int>(sizes.size()), failures == 0 ? "OK" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
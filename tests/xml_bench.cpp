@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Measures the rate of loading a generated XML file list with ListLoader, which reads the file
+ * attributes directly from the parser's buffer, compared to receiving copies of the attributes.
+ *
+ * Usage: xml_bench [directories] [files per directory] [runs]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/ClientManager.h>
+#include <client/DirectoryListing.h>
+#include <client/Encoder.h>
+#include <client/ResourceManager.h>
+#include <client/SettingsManager.h>
+#include <client/SimpleXMLReader.h>
+#include <client/Streams.h>
+#include <client/TimerManager.h>
+#include <client/User.h>
+
+#include <chrono>
+#include <cstdio>
+
+using namespace dcpp;
+
+namespace {
+
+/** Forwards the tags to ListLoader through the default startTagRefs, which copies the attributes */
+class CopyingLoader : public SimpleXMLReader::CallBack {
+public:
+	CopyingLoader(ListLoader& aLoader) : loader(aLoader) { }
+
+	void startTag(const string& name, StringPairList& attribs, bool simple) { loader.startTag(name, attribs, simple); }
+	void endTag(const string& name) { loader.endTag(name); }
+private:
+	ListLoader& loader;
+};
+
+string generateList(int aDirs, int aFiles) {
+	string xml = "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\r\n"
+		"<FileListing Version=\"1\" CID=\"" + CID::generate().toBase32() + "\" Base=\"/\" Generator=\"xml_bench\">\r\n";
+
+	uint64_t x = 88172645463325252ULL;
+	for(int d = 0; d < aDirs; ++d) {
+		xml += "<Directory Name=\"Some Artist &amp; Another - Album Title " + Util::toString(d) + "\" Date=\"1400000000\">\r\n";
+		for(int f = 0; f < aFiles; ++f) {
+			uint8_t tth[TTHValue::BYTES];
+			for(auto& b: tth) {
+				// xorshift
+				x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+				b = static_cast<uint8_t>(x);
+			}
+
+			xml += "<File Name=\"" + Util::toString(f) + " - Track Title of Moderate Length.flac\" Size=\"" + Util::toString(x >> 36) +
+				"\" TTH=\"" + Encoder::toBase32(tth, sizeof(tth)) + "\" Date=\"1400000000\"/>\r\n";
+		}
+		xml += "</Directory>\r\n";
+	}
+
+	xml += "</FileListing>\r\n";
+	return xml;
+}
+
+size_t countFiles(const DirectoryListing::Directory* aDir) {
+	auto files = aDir->files.size();
+	for(const auto& d: aDir->directories)
+		files += countFiles(d.get());
+	return files;
+}
+
+/** @return The best rate of the runs in MB/s */
+template<bool copyAttribs>
+double run(DirectoryListing* aList, const string& aXml, int aRuns, size_t& files_) {
+	double best = 0;
+	for(int i = 0; i < aRuns; ++i) {
+		DirectoryListing::Directory::Ptr root(new DirectoryListing::Directory(nullptr, Util::emptyString, DirectoryListing::Directory::TYPE_INCOMPLETE_NOCHILD, 0));
+		ListLoader loader(aList, root.get(), "/", false, aList->getUser(), false, false, 0);
+		CopyingLoader copying(loader);
+
+		auto start = std::chrono::steady_clock::now();
+
+		MemoryInputStream mis(aXml);
+		if(copyAttribs) {
+			SimpleXMLReader(&copying).parse(mis);
+		} else {
+			SimpleXMLReader(&loader).parse(mis);
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best = max(best, aXml.size() / elapsed.count() / 1e6);
+		files_ = countFiles(root.get());
+	}
+	return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+	int dirs = argc > 1 ? atoi(argv[1]) : 2000;
+	int files = argc > 2 ? atoi(argv[2]) : 50;
+	int runs = argc > 3 ? atoi(argv[3]) : 10;
+	if(dirs <= 0 || files <= 0 || runs <= 0) {
+		printf("Usage: %s [directories] [files per directory] [runs]\n", argv[0]);
+		return 1;
+	}
+
+	ResourceManager::newInstance();
+	SettingsManager::newInstance();
+	TimerManager::newInstance();
+	ClientManager::newInstance();
+
+	// the list and ClientManager that it listens to aren't deleted, the destructor of the list would require ShareManager
+	auto list = new DirectoryListing(HintedUser(new User(CID::generate()), Util::emptyString), false, "xml_bench", false);
+
+	auto xml = generateList(dirs, files);
+
+	size_t copiedFiles = 0, refFiles = 0;
+	auto copied = run<true>(list, xml, runs, copiedFiles);
+	auto refs = run<false>(list, xml, runs, refFiles);
+
+	auto mb = xml.size() / 1e6;
+	printf("%d directories, %d files, %.1f MB, best of %d runs\n", dirs, dirs * files, mb, runs);
+	printf("copied attributes: %.1f MB/s, %.0f files/s\n", copied, copied / mb * copiedFiles);
+	printf("attribute slices: %.1f MB/s, %.0f files/s (%.2fx)\n", refs, refs / mb * refFiles, refs / copied);
+	if(copiedFiles != refFiles || refFiles != static_cast<size_t>(dirs) * files) {
+		printf("the number of loaded files differs: %d, %d\n", static_cast<int>(copiedFiles), static_cast<int>(refFiles));
+		return 1;
+	}
+
+	TimerManager::deleteInstance();
+	SettingsManager::deleteInstance();
+	ResourceManager::deleteInstance();
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2011-2014 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Feeds XML documents to SimpleXMLReader in small chunks that split the tags, attributes and entity
+ * references, and checks that the callbacks receive the same data as when parsing in one go.
+ *
+ * Usage: xml_test [random chunkings] [seed]
+ */
+
+#include <client/stdinc.h>
+
+#include <client/SimpleXML.h>
+#include <client/SimpleXMLReader.h>
+
+#include <cstdio>
+#include <random>
+
+using namespace dcpp;
+
+namespace {
+
+const char* const documents[] = {
+	"\xef\xbb\xbf<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\r\n"
+	"<!-- a comment with <tags> & \"quotes\" -->\r\n"
+	"<FileListing Version=\"1\" Base=\"/\" Generator=\"Test &amp; &lt;bench&gt;\">\r\n"
+	"<Directory Name=\"A &quot;quoted&quot; &apos;name&apos;\" Date=\"12345\">\r\n"
+	"<File Name=\"x&#65;&#x42;&#x00e4;.txt\" Size=\"100\" TTH=\"LWPNACQDBZRYXW3VHJVCJ64QBZNGHOHHHZWCLNQ\"/>\r\n"
+	"<File Name='single \"quotes\" &amp; more' Size=\"2\" />\r\n"
+	"<File   Name = \"spaces around =\"\tSize=\"3\"/>\r\n"
+	"<Text>plain &amp; text with &lt;entities&gt; and a long run of characters without any special ones</Text>\r\n"
+	"<Empty></Empty>\r\n"
+	"<Mixed>one<Inner attr=\"\">two</Inner>three</Mixed>\r\n"
+	"<![CDATA[ raw <data> & ]]>\r\n"
+	"</Directory>\r\n"
+	"</FileListing>\r\n",
+
+	// attribute values and text longer than the vectorized search step, entities at the edges
+	"<?xml version='1.0' encoding='UTF-8'?><Root a=\"&amp;0123456789abcdef0123456789abcdef&amp;\" "
+	"b=\"0123456789abcdef0123456789abcdef0123456789abcdef\" c=\"&lt;&gt;&amp;&quot;&apos;\">"
+	"&amp;0123456789abcdef0123456789abcdef0123456789abcdef&gt;<Leaf/></Root>",
+
+	// converted from another encoding
+	"<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><Root Name=\"caf\xe9 &amp; cr\xe8me\">br\xfbl\xe9" "e</Root>"
+};
+
+/** Records the callbacks, the attributes are read from the slices */
+class RefRecorder : public SimpleXMLReader::CallBack {
+public:
+	void startTagRefs(const string& name, const SimpleXMLReader::AttribRefList& attribs, bool simple) {
+		string ev = "start " + name;
+		for(const auto& a: attribs)
+			ev += " " + a.name.str() + "=[" + a.value.str() + "]";
+		add(ev + (simple ? " simple" : ""));
+	}
+
+	void data(const string& aData) {
+		// the contents may be reported in several parts
+		if(!events.empty() && events.back().compare(0, 5, "data ") == 0) {
+			events.back() += aData;
+		} else {
+			add("data " + aData);
+		}
+	}
+
+	void endTag(const string& name) {
+		add("end " + name);
+	}
+
+	void add(const string& aEvent) {
+		events.push_back(aEvent);
+	}
+
+	StringList events;
+};
+
+/** Receives the attributes as copies through the default startTagRefs */
+class CopyRecorder : public RefRecorder {
+public:
+	void startTagRefs(const string& name, const SimpleXMLReader::AttribRefList& attribs, bool simple) {
+		SimpleXMLReader::CallBack::startTagRefs(name, attribs, simple);
+	}
+
+	void startTag(const string& name, StringPairList& attribs, bool simple) {
+		string ev = "start " + name;
+		for(const auto& a: attribs)
+			ev += " " + a.first + "=[" + a.second + "]";
+		add(ev + (simple ? " simple" : ""));
+	}
+};
+
+int failures = 0;
+
+template<class Recorder>
+StringList parse(const string& aXml, const vector<size_t>& aChunks) {
+	Recorder rec;
+	SimpleXMLReader reader(&rec);
+
+	size_t pos = 0;
+	for(auto len: aChunks) {
+		reader.parse(aXml.data() + pos, len);
+		pos += len;
+	}
+
+	return rec.events;
+}
+
+template<class Recorder>
+void compare(const string& aXml, const StringList& aExpected, const vector<size_t>& aChunks, const char* aWhat) {
+	StringList events;
+	try {
+		events = parse<Recorder>(aXml, aChunks);
+	} catch(const SimpleXMLException& e) {
+		events.push_back("exception " + e.getError());
+	}
+
+	if(events != aExpected) {
+		printf("FAILED: %s, first chunk %d bytes\n", aWhat, static_cast<int>(aChunks.front()));
+		for(size_t i = 0; i < max(events.size(), aExpected.size()); ++i) {
+			auto& a = i < aExpected.size() ? aExpected[i] : Util::emptyString;
+			auto& b = i < events.size() ? events[i] : Util::emptyString;
+			if(a != b) {
+				printf("  expected: %s\n  got:      %s\n", a.c_str(), b.c_str());
+				break;
+			}
+		}
+		failures++;
+	}
+}
+
+void expect(const StringList& aEvents, const string& aEvent) {
+	if(find(aEvents.begin(), aEvents.end(), aEvent) == aEvents.end()) {
+		printf("FAILED: missing event %s\n", aEvent.c_str());
+		failures++;
+	}
+}
+
+}
+
+int main(int argc, char** argv) {
+	int randomRuns = argc > 1 ? atoi(argv[1]) : 200;
+	unsigned seed = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 1;
+	std::mt19937 rand(seed);
+
+	int runs = 0;
+	for(auto doc: documents) {
+		string xml(doc);
+		auto expected = parse<RefRecorder>(xml, { xml.size() });
+		compare<CopyRecorder>(xml, expected, { xml.size() }, "copied attributes");
+
+		// the same chunk size through the whole document
+		for(size_t chunk = 1; chunk <= xml.size(); ++chunk) {
+			vector<size_t> chunks;
+			for(size_t pos = 0; pos < xml.size(); pos += chunk)
+				chunks.push_back(min(chunk, xml.size() - pos));
+
+			compare<RefRecorder>(xml, expected, chunks, "fixed chunks");
+			compare<CopyRecorder>(xml, expected, chunks, "fixed chunks, copied attributes");
+			runs++;
+		}
+
+		// and random ones
+		std::uniform_int_distribution<size_t> chunkDist(1, 16);
+		for(int i = 0; i < randomRuns; ++i) {
+			vector<size_t> chunks;
+			for(size_t pos = 0; pos < xml.size(); pos += chunks.back())
+				chunks.push_back(min(chunkDist(rand), xml.size() - pos));
+
+			compare<RefRecorder>(xml, expected, chunks, "random chunks");
+			runs++;
+		}
+	}
+
+	// the decoded values themselves
+	auto events = parse<RefRecorder>(documents[0], { strlen(documents[0]) });
+	expect(events, "start FileListing Version=[1] Base=[/] Generator=[Test & <bench>]");
+	expect(events, "start Directory Name=[A \"quoted\" 'name'] Date=[12345]");
+	expect(events, "start File Name=[x.txt] Size=[100] TTH=[LWPNACQDBZRYXW3VHJVCJ64QBZNGHOHHHZWCLNQ] simple");
+	expect(events, "start File Name=[single \"quotes\" & more] Size=[2] simple");
+	expect(events, "start File Name=[spaces around =] Size=[3] simple");
+	expect(events, "data plain & text with <entities> and a long run of characters without any special ones");
+
+	events = parse<RefRecorder>(documents[2], { strlen(documents[2]) });
+	expect(events, "start Root Name=[caf\xc3\xa9 & cr\xc3\xa8me]");
+	expect(events, "data br\xc3\xbbl\xc3\xa9" "e");
+
+	printf("%d chunkings: %s\n", runs, failures == 0 ? "OK" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
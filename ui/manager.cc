@@ -62,10 +62,10 @@ Manager::Manager():
     events::add_listener("timer started",
             std::bind(&Manager::init_statusbar, this));
 
-    events::add_listener_first("window updated",
+    events::add_listener_first(events::WINDOW_UPDATED,
         std::bind(&Manager::redraw_screen, this));
 
-    events::add_listener_first("statusbar updated",
+    events::add_listener_first(events::STATUSBAR_UPDATED,
         std::bind(&Manager::redraw_screen, this));
 }
 
@@ -166,7 +166,7 @@ void Manager::on(TimerManagerListener::Second, uint64_t aTick) noexcept{
 	int64_t updiff = totalUp - lastUp;
 	int64_t downdiff = totalDown - lastDown;
 
-	events::emit("bytes transferred", static_cast<int64_t>(downdiff * 1000LL / diff), static_cast<int64_t>(updiff * 1000LL / diff));
+	events::emit(events::BYTES_TRANSFERRED, static_cast<int64_t>(downdiff * 1000LL / diff), static_cast<int64_t>(updiff * 1000LL / diff));
 
 	SettingsManager::getInstance()->set(SettingsManager::TOTAL_UPLOAD, SETTING(TOTAL_UPLOAD) + updiff);
 	SettingsManager::getInstance()->set(SettingsManager::TOTAL_DOWNLOAD, SETTING(TOTAL_DOWNLOAD) + downdiff);
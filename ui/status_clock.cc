@@ -45,7 +45,7 @@ void StatusClock::on(TimerManagerListener::Second, uint64_t)
     noexcept
 {
     update();
-    events::emit("statusbar updated");
+    events::emit(events::STATUSBAR_UPDATED);
 }
 
 void StatusClock::update()
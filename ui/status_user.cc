@@ -29,7 +29,7 @@ namespace ui {
 
 StatusUser::StatusUser() : StatusItem("user")
 {
-    events::add_listener("window changed",
+    events::add_listener(events::WINDOW_CHANGED,
             std::bind(&StatusUser::update, this));
 	events::add_listener("nick changed",
 		std::bind(&StatusUser::update, this));
@@ -31,7 +31,7 @@ namespace ui {
 
 StatusWindowInfo::StatusWindowInfo() : StatusItem("window")
 {
-    events::add_listener("window changed",
+    events::add_listener(events::WINDOW_CHANGED,
         std::bind(&StatusWindowInfo::update, this));
 
     update();
@@ -43,7 +43,7 @@ void StatusWindowInfo::update()
     display::Window *window = dm->get_current_window();
     unsigned int number = std::distance(dm->begin(), dm->get_current()) + 1;
     m_text = dcpp::Util::toString(number) + ":" + window->get_name();
-    events::emit("statusbar updated");
+    events::emit(events::STATUSBAR_UPDATED);
 }
 
 } // namespace ui
@@ -32,10 +32,10 @@ namespace ui {
 
 StatusWindowList::StatusWindowList() : StatusItem("windows")
 {
-    events::add_listener("window status updated",
+    events::add_listener(events::WINDOW_STATUS_UPDATED,
             std::bind(&StatusWindowList::window_status_updated, this));
 
-    events::add_listener("window closed",
+    events::add_listener(events::WINDOW_CLOSED,
             std::bind(&StatusWindowList::window_closed, this));
 }
 
@@ -61,7 +61,7 @@ void StatusWindowList::window_status_updated()
         m_list[window] = state;
     }
     update();
-    events::emit("statusbar updated");
+    events::emit(events::STATUSBAR_UPDATED);
 }
 
 void StatusWindowList::update()
@@ -179,8 +179,8 @@ void WindowPrivateMessage::onOnlineStateChanged() {
 	m_nick = ClientManager::getInstance()->getMyNick(m_user.hint);
 
 	if (m_state == display::STATE_IS_ACTIVE) {
-		events::emit("window changed");
-		events::emit("window updated", this);
+		events::emit(events::WINDOW_CHANGED);
+		events::emit(events::WINDOW_UPDATED, this);
 	}
 }
 
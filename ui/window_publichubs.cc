@@ -122,7 +122,7 @@ void WindowHubs::set_property(Property property)
     m_prompt = properties[m_property];
 	setInsertMode(true);
 
-    events::emit("window updated", static_cast<display::Window*>(this));
+    events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 }
 
 void WindowHubs::handle_line(const std::string &line)
@@ -191,7 +191,7 @@ void WindowHubs::show_entries()
     set_title("Public hubs: Showing " + utils::to_string(get_size()) + " of " + utils::to_string(m_hubs.size()) + " hubs" + 
 		(!m_cachedDate.empty() ? " (updated on " + m_cachedDate + ")" : ""));
 
-    events::emit("window updated", static_cast<display::Window*>(this));
+    events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 }
 
 bool WindowHubs::matches(const HubEntry &entry)
@@ -224,14 +224,14 @@ void WindowHubs::on(DownloadStarting, const std::string &list) noexcept {
 			<< FavoriteManager::getInstance()->getPublicHubs().size()
 			<< " - " << list;
 		set_title(oss.str());
-		events::emit("window updated", static_cast<display::Window*>(this));
+		events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 	});
 }
 
 void WindowHubs::on(DownloadFailed, const std::string &list) noexcept {
 	callAsync([=] {
 		set_title("Public hubs: Failed " + list);
-		events::emit("window updated", static_cast<display::Window*>(this));
+		events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 	});
 }
 
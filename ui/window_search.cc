@@ -42,6 +42,7 @@ WindowSearch::WindowSearch(const std::string &aStr):
 	ListView(display::TYPE_SEARCHWINDOW, aStr)
 {
     SearchManager::getInstance()->addListener(this);
+    TimerManager::getInstance()->addListener(this);
 
     set_title("Search");
 
@@ -301,8 +302,24 @@ void WindowSearch::on(SearchManagerListener::SR, const SearchResultPtr& aSR)
 
 	callAsync([=] {
 		m_results.push_back(aSR);
+
+		// the rows trigger a redraw when they are visible, the title is updated on the next second
 		add_result(aSR);
+		m_resultsAdded = true;
+	});
+}
+
+void WindowSearch::on(TimerManagerListener::Second, uint64_t)
+    noexcept
+{
+	callAsync([this] {
+		if (!m_resultsAdded)
+			return;
+
+		m_resultsAdded = false;
 		updateTitle();
+		if (get_state() == display::STATE_IS_ACTIVE)
+			events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 	});
 }
 
@@ -452,6 +469,7 @@ std::string WindowSearch::get_infobox_line(unsigned int n)
 
 WindowSearch::~WindowSearch()
 {
+    TimerManager::getInstance()->removeListener(this);
     SearchManager::getInstance()->removeListener(this);
 }
 
@@ -30,6 +30,7 @@
 #include <client/HintedUser.h>
 #include <client/SearchQuery.h>
 #include <client/SearchResult.h>
+#include <client/TimerManager.h>
 
 #include <display/listview.h>
 
@@ -41,7 +42,8 @@ const unsigned int MIN_SEARCH = 2;
 
 class WindowSearch:
     public display::ListView,
-    public SearchManagerListener
+    public SearchManagerListener,
+    public TimerManagerListener
 {
 public:
     WindowSearch(const std::string &str);
@@ -88,6 +90,9 @@ public:
 
     /** Called when a search result is received. */
     void on(SearchManagerListener::SR, const SearchResultPtr& result) noexcept;
+
+    /** Updates the title and redraws once per second if results have been added. */
+    void on(TimerManagerListener::Second, uint64_t) noexcept;
 	void complete(const std::vector<std::string>& aArgs, int pos, std::vector<std::string>& suggest_, bool& appendSpace_);
 	void handleEscape();
 private:
@@ -98,6 +103,9 @@ private:
     std::string m_searchStr;
 	SearchResultList m_results;
 
+	// results have been added since the last update, only accessed from the main loop
+	bool m_resultsAdded = false;
+
     /** Returns true if search result matches current filters. */
     bool matches(const SearchResultPtr& result);
 	void add_result(const SearchResultPtr& result);
@@ -30,6 +30,7 @@
 #include <client/GeoManager.h>
 #include <client/QueueManager.h>
 #include <client/Socket.h>
+#include <client/UploadCache.h>
 #include <client/UploadManager.h>
 #include <client/Util.h>
 
@@ -54,7 +55,7 @@ static string getFile(const Transfer::Type& type, const string& fileName) {
 }
 
 
-WindowTransfers::WindowTransfers() : ListView(display::TYPE_TRANSFERS, "transfers"), bytesConn(events::add_listener("bytes transferred", bind(&WindowTransfers::handleBytes, this)))
+WindowTransfers::WindowTransfers() : ListView(display::TYPE_TRANSFERS, "transfers"), bytesConn(events::add_listener(events::BYTES_TRANSFERRED, bind(&WindowTransfers::handleBytes, this)))
 {
     DownloadManager::getInstance()->addListener(this);
     ConnectionManager::getInstance()->addListener(this);
@@ -251,11 +252,17 @@ void WindowTransfers::updateTitle(int64_t down, int64_t up) {
 		title += Util::formatBytes(up) + "/s)";
 	}
 
+	auto cache = UploadCache::getInstance()->getStats();
+	if (cache.hits > 0) {
+		title += " (upload cache: " + Util::toString(cache.hits * 100 / (cache.hits + cache.misses)) + "% hits, ";
+		title += Util::formatBytes(cache.bytesSaved) + " saved)";
+	}
+
 	set_title(title);
 }
 
 void WindowTransfers::handleBytes() noexcept {
-    events::emit("window updated", static_cast<display::Window*>(this));
+    events::emit(events::WINDOW_UPDATED, static_cast<display::Window*>(this));
 	updateTitle(events::arg<int64_t>(0), events::arg<int64_t>(1));
 }
 